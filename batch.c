@@ -0,0 +1,440 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Batch functions histogram many data files in one run, sharing one
+ * thread pool between all of them.
+ */
+
+#define _DEFAULT_SOURCE /* for strdup and _SC_NPROCESSORS_ONLN */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "histogram.h"
+#include "memory.h"
+#include "output.h"
+#include "parallel_helpers.h"
+#include "pool.h"
+#include "status.h"
+#include "vector.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* memory a worker reuses from file to file */
+typedef struct{
+	vector* data; /* data of the small file being binned */
+	unsigned long capacity; /* size data->array can hold */
+	histogram* graph; /* histogram of the small file being binned */
+	unsigned long* counts; /* local bin counts for large file chunks */
+}batch_scratch;
+
+/* a whole batch run */
+typedef struct{
+	thread_pool* pool; /* the shared workers */
+	unsigned long bin_count; /* bins for every file */
+	OUTPUT_FORMAT format; /* output format for every file */
+	batch_scratch* scratch; /* one per worker */
+	unsigned long failed; /* number of files that failed (atomic) */
+}batch_run;
+
+/* a file of the batch */
+typedef struct{
+	batch_run* run; /* the run it belongs to */
+	char* filename; /* the data file */
+}batch_file;
+
+/* a large file being binned in chunks */
+typedef struct split_file{
+	batch_file* file; /* the file */
+	struct split_chunk* chunks; /* its chunk tasks */
+	histogram* graph; /* its histogram (and data) */
+	unsigned long chunk_count; /* number of chunks */
+	unsigned long remaining; /* chunks not binned yet */
+	pthread_mutex_t lock; /* guards graph->bin_counts and remaining */
+}split_file;
+
+/* a chunk of a large file */
+typedef struct split_chunk{
+	split_file* split; /* the file being binned */
+	unsigned long chunk_id; /* which chunk this is */
+}split_chunk;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Adds the given filename to the list, doubling it when needed
+ */
+static void add_filename(char*** filenames, unsigned long* count, unsigned long* capacity, char* filename);
+
+/**
+ * Task that bins one chunk of a large file (split_chunk)
+ * The last chunk to finish writes the result
+ */
+static void bin_chunk(void* arg, unsigned long worker_id);
+
+/**
+ * Task that histograms a file, or splits it into chunks if it is large
+ * (batch_file)
+ */
+static void bin_file(void* arg, unsigned long worker_id);
+
+/**
+ * Lists the files of a directory, or the lines of a list file
+ *
+ * @returns the list of filenames (NULL if path could not be read)
+ */
+static char** collect_filenames(const char* path, unsigned long* count);
+
+/**
+ * @returns true if name ends with suffix
+ */
+static bool ends_with(const char* name, const char* suffix);
+
+/**
+ * Counts a file as failed and says so
+ */
+static void fail_file(batch_file* file);
+
+/**
+ * Writes the histogram of a file to FILENAME.hist
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the result was written
+ * 	ERROR if it was not
+ */
+static int write_result(batch_file* file, histogram* graph);
+
+/*	FUNCTIONS	======================================================*/
+
+static void add_filename(char*** filenames, unsigned long* count, unsigned long* capacity, char* filename){
+	if(*count == *capacity){
+		*capacity = (*capacity > 0) ? *capacity*2 : BATCH_LIST_SIZE;
+		*filenames = realloc(*filenames, *capacity*sizeof(char*));
+	}
+	(*filenames)[(*count)++] = filename;
+}
+
+static void bin_chunk(void* arg, unsigned long worker_id){
+	split_chunk* chunk;
+	split_file* split;
+	batch_scratch* scratch;
+	vector* data;
+	unsigned long start_index, end_index, t;
+	bool last;
+
+	chunk = (split_chunk*) arg;
+	split = chunk->split;
+	scratch = &split->file->run->scratch[worker_id];
+	data = split->graph->data;
+
+	/* same split as the parallel binning threads use */
+	start_index = calculate_start_index(chunk->chunk_id, split->chunk_count, data->size);
+	end_index = calculate_end_index(chunk->chunk_id, split->chunk_count, data->size) + 1;
+
+	memset(scratch->counts, 0, (split->graph->bin_count + REJECT_COUNT)*sizeof(unsigned long));
+	count_bins(split->graph, data->array + start_index, end_index - start_index, scratch->counts);
+
+	/* add our counts in, and find out if we were the last chunk */
+	pthread_mutex_lock(&split->lock);
+	for(t=0; t < split->graph->bin_count + REJECT_COUNT; t++){
+		split->graph->bin_counts[t] += scratch->counts[t];
+	}
+	split->remaining -= 1;
+	last = (split->remaining == 0);
+	pthread_mutex_unlock(&split->lock);
+
+	/* the last chunk finishes the file (the pool is done with arg) */
+	if(last){
+		if(write_result(split->file, split->graph)){
+			fail_file(split->file);
+		}
+
+		delete_histogram(split->graph);
+		pthread_mutex_destroy(&split->lock);
+		free(split->chunks);
+		free(split);
+	}
+}
+
+static void bin_file(void* arg, unsigned long worker_id){
+	batch_file* file;
+	batch_scratch* scratch;
+	split_file* split;
+	split_chunk* chunks;
+	histogram* graph;
+	vector* data;
+	FILE* input;
+	unsigned long size, count, t;
+	double min, max;
+	bool has_range;
+	int rc;
+
+	file = (batch_file*) arg;
+	scratch = &file->run->scratch[worker_id];
+
+	input = fopen(file->filename, READ_ONLY);
+	rc = input ? read_vector_header(input, &size, &min, &max) : ERROR;
+	if(rc == ERROR){
+		if(input){
+			fclose(input);
+		}
+		fail_file(file);
+		return;
+	}
+
+	/* a range in the file header works like the range flag (see main.c) */
+	has_range = rc == SUCCESS;
+
+	/* small files use this worker's memory from start to end */
+	if(size < BATCH_SPLIT_MIN){
+
+		/* only grow the data when a file does not fit */
+		if(size > scratch->capacity){
+			free_block(scratch->data->array);
+			scratch->data->array = alloc_block(size*sizeof(double));
+			scratch->capacity = size;
+		}
+		data = scratch->data;
+		graph = scratch->graph;
+
+		if(read_vector_values(input, data->array, size, &count)){
+			fclose(input);
+			fail_file(file);
+			return;
+		}
+		fclose(input);
+		data->size = count;
+
+		memset(graph->bin_counts, 0, (graph->bin_count + REJECT_COUNT)*sizeof(unsigned long));
+		if(has_range ? process_stats_range(graph, min, max) : process_stats(graph)){
+			fail_file(file);
+			return;
+		}
+		count_bins(graph, data->array, data->size, graph->bin_counts);
+
+		if(write_result(file, graph)){
+			fail_file(file);
+		}
+		return;
+	}
+
+	/* large files get their own memory and are split up */
+	graph = init_histogram(file->run->bin_count);
+	graph->data = init_vector(size);
+
+	if(read_vector_values(input, graph->data->array, size, &count)){
+		fclose(input);
+		delete_histogram(graph);
+		fail_file(file);
+		return;
+	}
+	fclose(input);
+	graph->data->size = count;
+
+	/* cut short before the first chunk, nothing to split */
+	if((has_range ? process_stats_range(graph, min, max) : process_stats(graph)) || count == 0){
+		delete_histogram(graph);
+		fail_file(file);
+		return;
+	}
+
+	split = malloc(sizeof(split_file));
+	split->file = file;
+	split->graph = graph;
+	split->chunk_count = (count + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+	split->remaining = split->chunk_count;
+	pthread_mutex_init(&split->lock, NULL);
+
+	/* fill in every chunk before any of them can finish */
+	split->chunks = malloc(split->chunk_count*sizeof(split_chunk));
+	for(t=0; t < split->chunk_count; t++){
+		split->chunks[t].split = split;
+		split->chunks[t].chunk_id = t;
+	}
+
+	chunks = split->chunks;
+	for(t=0; t < split->chunk_count; t++){
+		pool_submit(file->run->pool, bin_chunk, (void*)&chunks[t]);
+	}
+}
+
+static char** collect_filenames(const char* path, unsigned long* count){
+	char line[BATCH_LINE_SIZE];
+	char** filenames;
+	char* filename;
+	struct stat path_stat, entry_stat;
+	struct dirent* entry;
+	unsigned long capacity;
+	size_t length;
+	DIR* directory;
+	FILE* list;
+
+	filenames = NULL;
+	*count = 0;
+	capacity = 0;
+
+	if(stat(path, &path_stat)){
+		return NULL;
+	}
+
+	/* a directory: every regular file in it, except our own results */
+	if(S_ISDIR(path_stat.st_mode)){
+		directory = opendir(path);
+		if(!directory){
+			return NULL;
+		}
+
+		while((entry = readdir(directory)) != NULL){
+			if(entry->d_name[0] == '.' || ends_with(entry->d_name, BATCH_SUFFIX) || ends_with(entry->d_name, SKETCH_SUFFIX) || ends_with(entry->d_name, INDEX_SUFFIX)){
+				continue;
+			}
+
+			filename = malloc(strlen(path) + strlen(entry->d_name) + 2);
+			sprintf(filename, "%s/%s", path, entry->d_name);
+
+			if(stat(filename, &entry_stat) || !S_ISREG(entry_stat.st_mode)){
+				free(filename);
+				continue;
+			}
+			add_filename(&filenames, count, &capacity, filename);
+		}
+		closedir(directory);
+	}
+
+	/* a list file: one filename per line */
+	else{
+		list = fopen(path, READ_ONLY);
+		if(!list){
+			return NULL;
+		}
+
+		while(fgets(line, BATCH_LINE_SIZE, list)){
+			length = strcspn(line, "\r\n");
+			line[length] = '\0';
+
+			if(length > 0){
+				add_filename(&filenames, count, &capacity, strdup(line));
+			}
+		}
+		fclose(list);
+	}
+
+	/* an empty list is still a list */
+	if(!filenames){
+		filenames = malloc(sizeof(char*));
+	}
+	return filenames;
+}
+
+static bool ends_with(const char* name, const char* suffix){
+	size_t name_length, suffix_length;
+
+	name_length = strlen(name);
+	suffix_length = strlen(suffix);
+
+	return name_length >= suffix_length && strcmp(name + name_length - suffix_length, suffix) == 0;
+}
+
+static void fail_file(batch_file* file){
+	__atomic_fetch_add(&file->run->failed, 1, __ATOMIC_RELAXED);
+	printf(BATCH_FAIL_MSG, file->filename);
+}
+
+int process_batch(const char* path, unsigned long bin_count, unsigned long thread_count, OUTPUT_FORMAT format){
+	batch_run run;
+	batch_file* files;
+	char** filenames;
+	unsigned long file_count, t;
+	bool quiet;
+
+	filenames = collect_filenames(path, &file_count);
+	if(!filenames){
+		printf(ERROR_FILENAME, path);
+		return ERROR;
+	}
+
+	/* default to one worker per cpu */
+	if(thread_count < 1){
+		thread_count = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+	}
+
+	print_status(BATCH_MSG, file_count, thread_count);
+
+	/* thousands of files would mean thousands of status messages */
+	quiet = is_quiet_mode();
+	set_quiet_mode(true);
+
+	run.bin_count = bin_count;
+	run.format = format;
+	run.failed = 0;
+
+	/* every worker gets its own reusable memory */
+	run.scratch = malloc(thread_count*sizeof(batch_scratch));
+	for(t=0; t < thread_count; t++){
+		run.scratch[t].data = init_vector(0);
+		run.scratch[t].capacity = 0;
+		run.scratch[t].graph = init_histogram(bin_count);
+		run.scratch[t].graph->data = run.scratch[t].data;
+		run.scratch[t].counts = alloc_bin_counts(bin_count);
+	}
+
+	files = malloc(file_count*sizeof(batch_file));
+	run.pool = init_pool(thread_count);
+
+	for(t=0; t < file_count; t++){
+		files[t].run = &run;
+		files[t].filename = filenames[t];
+		pool_submit(run.pool, bin_file, (void*)&files[t]);
+	}
+
+	/* wait for every file (and all of their chunks) */
+	delete_pool(run.pool);
+	set_quiet_mode(quiet);
+
+	print_status(BATCH_DONE_MSG, file_count - run.failed, run.failed);
+
+	/* Delete what we dont need anymore (scratch graphs own their data) */
+	for(t=0; t < thread_count; t++){
+		delete_histogram(run.scratch[t].graph);
+		free_block(run.scratch[t].counts);
+	}
+	for(t=0; t < file_count; t++){
+		free(filenames[t]);
+	}
+	free(run.scratch);
+	free(filenames);
+	free(files);
+
+	return run.failed > 0 ? FAIL : SUCCESS;
+}
+
+static int write_result(batch_file* file, histogram* graph){
+	char* filename;
+	int fd, rc;
+
+	filename = malloc(strlen(file->filename) + strlen(BATCH_SUFFIX) + 1);
+	strcpy(filename, file->filename);
+	strcat(filename, BATCH_SUFFIX);
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	free(filename);
+	if(fd < 0){
+		return ERROR;
+	}
+
+	rc = write_histogram(graph, file->run->format, fd, 1);
+
+	if(close(fd)){
+		rc = ERROR;
+	}
+	return rc;
+}
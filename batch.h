@@ -0,0 +1,37 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Batch functions histogram many data files in one run, sharing one
+ * thread pool between all of them.
+ *
+ * The files come from a directory (every regular file in it) or from
+ * a list file (one filename per line). Each file gets its own result,
+ * written next to it as FILENAME.hist in the chosen output format.
+ *
+ * Small files (less than BATCH_SPLIT_MIN data) are read, binned and
+ * written whole by one worker, reusing that worker's data and histogram
+ * memory from file to file. Large files are read by one worker and then
+ * binned as BATCH_CHUNK_SIZE chunks by every worker; the worker that
+ * bins the last chunk writes the result.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "output.h"
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Histograms every file in the given directory or list file using
+ * bin_count bins and thread_count workers (0 for one per online cpu)
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if every file was histogrammed
+ * 	FAIL if some files could not be histogrammed
+ * 	ERROR if the directory or list file could not be read
+ */
+int process_batch(const char* path, unsigned long bin_count, unsigned long thread_count, OUTPUT_FORMAT format);
+
+#endif
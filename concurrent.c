@@ -0,0 +1,145 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Concurrent histogram functions let many producers record at once
+ *
+ * A shard pointer is published with a release store once its counters
+ * are zeroed, and read with an acquire load, so readers never see a
+ * shard before its counters. Counters are only ever written by their
+ * own producer, so a relaxed load and store (no locked instruction) is
+ * enough to count, and readers load them relaxed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "concurrent.h"
+#include "histogram.h"
+#include "kernels.h"
+#include "memory.h"
+#include "return_code.h"
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Gets the counters of the given producer, allocating (and publishing)
+ * them if it has not recorded before
+ */
+static unsigned long* get_shard(concurrent_histogram* ch, unsigned long producer);
+
+/*	FUNCTIONS	======================================================*/
+
+void delete_concurrent_histogram(concurrent_histogram* ch){
+	unsigned long t;
+
+	if(ch){
+		for(t=0; t < ch->producer_count; t++){
+			free_block(ch->shards[t]);
+		}
+		free(ch->shards);
+		delete_histogram(ch->graph);
+		free(ch);
+	}
+}
+
+static unsigned long* get_shard(concurrent_histogram* ch, unsigned long producer){
+	unsigned long* counts;
+
+	counts = ch->shards[producer];
+
+	/* first sample of this producer, readers may look at it from now on */
+	if(!counts){
+		counts = alloc_bin_counts(ch->graph->bin_count);
+		__atomic_store_n(&ch->shards[producer], counts, __ATOMIC_RELEASE);
+	}
+
+	return counts;
+}
+
+concurrent_histogram* init_concurrent_histogram(double min, double max, unsigned long bin_count, unsigned long producer_count){
+	concurrent_histogram* ch;
+
+	if(!(min < max) || bin_count < 1 || producer_count < 1){
+		return NULL;
+	}
+
+	ch = malloc(sizeof(concurrent_histogram));
+	ch->graph = init_histogram(bin_count);
+	process_stats_range(ch->graph, min, max);
+	ch->shards = calloc(producer_count, sizeof(unsigned long*));
+	ch->producer_count = producer_count;
+	ch->registered = 0;
+	ch->scale = 1.0 / ch->graph->bin_width;
+
+	return ch;
+}
+
+void record_sample(concurrent_histogram* ch, unsigned long producer, double value){
+	unsigned long* counts;
+	unsigned long bin;
+
+	counts = get_shard(ch, producer);
+	bin = find_bin_scaled(ch->graph, value, ch->scale);
+
+	/* data outside the bins lands in its reject counter */
+	__atomic_store_n(&counts[bin], counts[bin] + 1, __ATOMIC_RELAXED);
+}
+
+void record_samples(concurrent_histogram* ch, unsigned long producer, double* values, unsigned long count){
+	unsigned long* counts;
+	unsigned long t, bin;
+
+	/* every counter is stored whole, like record_sample, since a
+	 * snapshot may be reading them (so not count_bins) */
+	counts = get_shard(ch, producer);
+	for(t=0; t < count; t++){
+		bin = find_bin_scaled(ch->graph, values[t], ch->scale);
+		__atomic_store_n(&counts[bin], counts[bin] + 1, __ATOMIC_RELAXED);
+	}
+}
+
+int register_producer(concurrent_histogram* ch, unsigned long* producer){
+	unsigned long id;
+
+	id = __atomic_fetch_add(&ch->registered, 1, __ATOMIC_RELAXED);
+	if(id >= ch->producer_count){
+		return FAIL;
+	}
+
+	*producer = id;
+	return SUCCESS;
+}
+
+histogram* snapshot_concurrent_histogram(concurrent_histogram* ch){
+	histogram* snapshot;
+
+	snapshot = init_histogram(ch->graph->bin_count);
+	snapshot->min = ch->graph->min;
+	snapshot->max = ch->graph->max;
+	snapshot->bin_width = ch->graph->bin_width;
+	memcpy(snapshot->bin_maxes, ch->graph->bin_maxes, ch->graph->bin_count*sizeof(double));
+	sum_concurrent_histogram(ch, snapshot->bin_counts);
+
+	return snapshot;
+}
+
+unsigned long sum_concurrent_histogram(concurrent_histogram* ch, unsigned long* counts){
+	unsigned long* shard;
+	unsigned long t, bin, total;
+
+	for(t=0; t < ch->producer_count; t++){
+		shard = __atomic_load_n(&ch->shards[t], __ATOMIC_ACQUIRE);
+
+		if(shard){
+			for(bin=0; bin < ch->graph->bin_count + REJECT_COUNT; bin++){
+				counts[bin] += __atomic_load_n(&shard[bin], __ATOMIC_RELAXED);
+			}
+		}
+	}
+
+	total = 0;
+	for(bin=0; bin < ch->graph->bin_count; bin++){
+		total += counts[bin];
+	}
+	return total;
+}
@@ -0,0 +1,94 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Concurrent histograms take samples from many threads at once.
+ *
+ * Every producer (a thread recording samples) counts into its own
+ * shard of counters, allocated by that producer the first time it
+ * records (so it sits on that producer's NUMA node) and padded to whole
+ * cache lines, so producers never share a cache line or take a lock.
+ * Recording one sample is finding its bin and a plain load and store of
+ * one counter that no other thread writes.
+ *
+ * Readers sum the shards (like sum_bin_counts) while producers keep
+ * recording. Every counter is read whole and only ever goes up, so a
+ * snapshot holds every sample recorded before it started, some of the
+ * ones recorded while it ran, and its total is always the sum of its
+ * bins.
+ *
+ * Producer ids go from 0 to producer_count-1, either handed out by
+ * register_producer or fixed by the caller (like pool worker ids), as
+ * long as no two threads record with the same id at the same time.
+ */
+
+#ifndef CONCURRENT_H
+#define CONCURRENT_H
+
+#include "histogram.h"
+
+/*	TYPES	==========================================================*/
+
+/* a histogram many producers record into at once */
+typedef struct{
+	histogram* graph; /* the bins (its bin_counts stay empty) */
+	unsigned long** shards; /* counters of each producer, NULL until it records */
+	unsigned long producer_count; /* number of shards */
+	unsigned long registered; /* ids handed out by register_producer */
+	double scale; /* 1 / bin_width, for finding bins */
+}concurrent_histogram;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Deletes the given concurrent histogram
+ * Assumes no producer is still recording
+ */
+void delete_concurrent_histogram(concurrent_histogram* ch);
+
+/**
+ * Creates a concurrent histogram of bin_count bins from min to max,
+ * for up to producer_count producers
+ *
+ * @returns the histogram, NULL if min is not less than max (or
+ * 	bin_count or producer_count is 0)
+ */
+concurrent_histogram* init_concurrent_histogram(double min, double max, unsigned long bin_count, unsigned long producer_count);
+
+/**
+ * Records one sample for the given producer (values outside of min to
+ * max are counted in the reject counters, see histogram.h)
+ */
+void record_sample(concurrent_histogram* ch, unsigned long producer, double value);
+
+/**
+ * Records count samples for the given producer, like calling
+ * record_sample for each (safe to snapshot while it runs)
+ */
+void record_samples(concurrent_histogram* ch, unsigned long producer, double* values, unsigned long count);
+
+/**
+ * Hands out the next unused producer id
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if an id was handed out
+ * 	FAIL if every id is taken
+ */
+int register_producer(concurrent_histogram* ch, unsigned long* producer);
+
+/**
+ * Creates a histogram with the bins of ch and the counts of every
+ * producer summed (see top), to be printed or written out.
+ * Producers do not need to stop.
+ */
+histogram* snapshot_concurrent_histogram(concurrent_histogram* ch);
+
+/**
+ * Adds the counts of every producer into counts (from alloc_bin_counts)
+ * Producers do not need to stop.
+ *
+ * @returns the sum of the bins of counts afterwards (without rejects)
+ */
+unsigned long sum_concurrent_histogram(concurrent_histogram* ch, unsigned long* counts);
+
+#endif
@@ -12,24 +12,233 @@
 /* read only flag for fopen */
 #define READ_ONLY "r"
 
+/* write only flag for fopen */
+#define WRITE_ONLY "w"
+
 /* the base number of threads is 2 */
 #define BASE_THD 2
 
+/* random integers (-R in integer mode) go from 0 to this */
+#define RAND_INT_MAX 1000
+
+/* memory layout (see memory.h) */
+#define CACHE_LINE_SIZE 64 /* alignment and padding of every block */
+#define HUGE_PAGE_SIZE (2UL*1024*1024) /* alignment of big blocks */
+#define HUGE_PAGE_MIN (4UL*1024*1024) /* blocks this big use huge pages */
+
+/* pipelined ingest (see pipeline.h) */
+#define PIPE_RING_SIZE 16 /* number of blocks between reader and binners */
+#define PIPE_BLOCK_SIZE 65536 /* values per block */
+#define PIPE_READ_SIZE (1024*1024) /* bytes read from the file at a time */
+
+/* out of core mode (see outcore.h) */
+#define OUTCORE_CHUNK 65536 /* values parsed at a time */
+#define OUTCORE_MAX_NUMBER 4096 /* bytes mapped past a window to finish its last number */
+#define OUTCORE_MIN_WINDOW (1UL << 20) /* smallest window per thread in bytes */
+#define OUTCORE_RESERVE (4UL << 20) /* bytes of the budget left for the program itself */
+
+/* moments of the data (see moments.h) */
+#define MOMENTS_BLOCK 65536 /* values binned before their moments are added */
+
+/* read ahead of data files (see reader.h) */
+#define READER_DEPTH 8 /* reads kept in flight */
+#define READER_BUFFER_SIZE (1UL << 20) /* bytes per read */
+#define READER_ALIGN 4096 /* alignment of reads and buffers (for O_DIRECT) */
+
+/* cached sketches (see sketch.h) */
+#define SKETCH_BINS (1UL << 20) /* number of sub-bins in a sketch */
+#define SKETCH_SUFFIX ".sketch" /* added to the data filename */
+#define SKETCH_MAGIC "HSKT"
+#define SKETCH_VERSION 3
+
+/* sorted indexes (see index.h) */
+#define INDEX_SUFFIX ".index" /* added to the data filename */
+#define INDEX_MAGIC "HIDX"
+#define INDEX_VERSION 2
+#define INDEX_RADIX_BITS 8 /* bits per digit of the radix sort */
+#define INDEX_RADIX (1UL << INDEX_RADIX_BITS)
+
+/* grouped histograms (see group.h) */
+#define GROUP_LIST_SIZE 4096 /* starting records in an outbox */
+#define GROUP_TABLE_SIZE 1024 /* starting slots of a key table (a power of two) */
+#define GROUP_KEY_SIZE 16 /* starting keys of a key table (at most half its slots) */
+#define GROUP_MAX_NUMBER 64 /* longest value on a line */
+#define GROUP_HASH_BASIS 2166136261U /* FNV-1a */
+#define GROUP_HASH_PRIME 16777619U
+#define GROUP_WRITE_SIZE (1UL << 20) /* output bytes formatted before a write */
+
+/* sampled histograms (see sample.h) */
+#define SAMPLE_Z 1.96 /* standard errors in a 95% interval */
+#define SAMPLE_ZERO 3.0 /* 95% high end of a bin with nothing sampled, times p */
+#define SAMPLE_SEED 0x853C49E6748FEA9BUL /* generator seeds are made from this */
+#define SAMPLE_CHUNK 4096 /* sampled values gathered before binning */
+
+/* thread pool (see pool.h) */
+#define POOL_QUEUE_SIZE 64 /* starting size of the task ring */
+
+/* batch mode (see batch.h) */
+#define BATCH_SUFFIX ".hist" /* added to each data filename */
+#define BATCH_SPLIT_MIN (1UL << 22) /* files this big are split into chunks */
+#define BATCH_CHUNK_SIZE (1UL << 20) /* values per chunk of a split file */
+#define BATCH_LIST_SIZE 64 /* starting size of the filename list */
+#define BATCH_LINE_SIZE 4096 /* longest line of a list file */
+
+/* daemon mode (see daemon.h) */
+#define DAEMON_NAME_SIZE 256 /* longest histogram name (with the '\0') */
+#define DAEMON_MAX_PAYLOAD (64UL*1024*1024) /* biggest request payload in bytes */
+#define DAEMON_ENTRY_SIZE 64 /* starting size of the histogram list */
+#define DAEMON_BACKLOG 64 /* connections waiting to be accepted */
+
+/* small bin count kernels (see kernels.h) */
+#define KERNEL_MAX_BINS 256 /* most bins a kernel handles */
+#define KERNEL_FLUSH_SIZE 65535 /* values between flushes of the 16 bit counters */
+
+/* partitioned binning for many bins (see kernels.h) */
+#define PARTITION_MIN_BINS (1UL << 17) /* bin counts this big are partitioned */
+#define PARTITION_MIN_VALUES 4096 /* fewer values are not worth partitioning */
+#define PARTITION_SHIFT 15 /* a partition is 2^15 bins (256KB of counts) */
+#define PARTITION_BLOCK_SIZE (1UL << 20) /* values partitioned at a time */
+#define PARTITION_WC_SIZE 16 /* bins per write combining buffer (one cache line) */
+
+/* column files (see vector.h) */
+#define COLUMN_MAGIC "HCOL"
+#define COLUMN_VERSION 1
+#define COLUMN_BLOCK_SIZE 65536 /* values per block when saving */
+#define COLUMN_BLOCK_MAX (1UL << 24) /* biggest block size a file may have */
+#define COLUMN_MAX_DECIMALS 9 /* most decimals the decimal codec handles */
+#define COLUMN_INT_LIMIT 9007199254740992.0 /* 2^53, scaled values must stay below */
+
+/* dictionary data (see vector.h) */
+#define DICTIONARY_MAX_SIZE 4096 /* more distinct values are read as plain data */
+#define DICTIONARY_NARROW_SIZE 256 /* distinct values that fit 1 byte codes */
+#define DICTIONARY_TABLE_BITS 13 /* the lookup table has 2^13 slots (twice the max) */
+#define DICTIONARY_HASH 0x9E3779B97F4A7C15UL /* multiplier hashing the bits of a value */
+#define DICTIONARY_CHUNK 4096 /* values parsed before they are encoded */
+
+/* auto mode (see tuner.h) */
+#define TUNE_AUTO "auto" /* -p auto */
+#define TUNE_PROFILE_ENV "HISTO_PROFILE" /* env var with the profile file path */
+#define TUNE_PROFILE_NAME ".histo_profile" /* profile file in the home directory */
+#define TUNE_MAGIC "HTUN"
+#define TUNE_VERSION 1
+#define TUNE_SAMPLE_SIZE (1UL << 18) /* values per microbenchmark */
+#define TUNE_LARGE_SAMPLE_SIZE (1UL << 16) /* values for the (slow) big histogram ones */
+#define TUNE_SMALL_BINS 64 /* bins of the small (kernel) benchmark */
+#define TUNE_CACHED_BINS 4096 /* bins of the in cache benchmark */
+#define TUNE_LARGE_BINS (1UL << 20) /* bins of the direct vs partitioned benchmark */
+#define TUNE_SPAWN_COUNT 16 /* most threads started to time thread starts */
+
+/* automatic bin counts (see histogram.h and quantile.h) */
+#define BINS_AUTO "auto" /* B argument */
+#define AUTO_BINS_GUESS 1024 /* bins assumed before they are picked (for -p auto) */
+#define AUTO_MAX_BINS (1UL << 20) /* most bins picked */
+#define QUANTILE_K 1024 /* values kept per sketch level */
+#define QUANTILE_SAMPLE_SIZE (1UL << 20) /* most data sketched to pick bins */
+#define QUANTILE_MAX_LEVELS 64 /* sketch levels (enough for 2^64 data) */
+#define QUANTILE_RADIX_BITS 8 /* bits per digit when sorting a level */
+#define QUANTILE_RADIX (1UL << QUANTILE_RADIX_BITS)
+
+/* shard files (see shard.h) */
+#define SHARD_MAGIC "HSHD"
+#define SHARD_VERSION 2
+
+/* subcommands (must be the first argument) */
+#define MERGE_CMD "merge"
+#define RANGE_CMD "range"
+
 /* flags for cmd input */
 #define RAND_FLAG "-R"
 #define HELP_FLAG "-h"
 #define PARA_FLAG "-p"
 #define VERB_FLAG "-v"
+#define FORM_FLAG "-o"
+#define OUTF_FLAG "-O"
+#define NUMA_FLAG "-n"
+#define HUGE_FLAG "-H"
+#define DYNA_FLAG "-d"
+#define RANG_FLAG "-r"
+#define SKTC_FLAG "-s"
+#define BTCH_FLAG "-b"
+#define QUIE_FLAG "-q"
+#define DMON_FLAG "-D"
+#define COLM_FLAG "-c"
+#define INTG_FLAG "-i"
+#define SHRD_FLAG "-S"
+#define DRCT_FLAG "-I"
+#define OUTC_FLAG "-m"
+#define STAT_FLAG "-M"
+#define INDX_FLAG "-x"
+#define GRUP_FLAG "-g"
+#define SMPL_FLAG "-a"
+#define SERR_FLAG "-e"
 
 /* The help message, in python-like style */
-#define HELP_MESSAGE "usage: histo_program.out [-h] [-v] [-p N] (-R N B or FILENAME B)\n\nApply histogram data sorting to given (or random) data\n\nRequired arguments:\n -R N B\t\t Randomly generate data of size N and apply the histogram data sorting to the data using bin size B.\n\t\t(CANNOT be used with (FILENAME B))\n FILENAME B\t load data to sort from a file using bin size B. (CANNOT be used with (-R N B))\n\nOptional arguments:\n -h \t\t show this help message and exit\n -p N\t\t Use parallel binning process with N number of threads.\n\t\t(Default mode is serial)\n -v \t\t Be verbose (must be first flag to activate)\n\t\t(only affects parallel mode)\n"
+#define HELP_MESSAGE "usage: histo_program.out [-h] [-v] [-p N] [-o FORMAT] [-O FILE] [-n] [-H] [-d CHUNK] [-r MIN MAX] [-s] [-q] [-c FILE] [-i] [-S FILE] [-I] [-m MB] [-M] [-x] [-g] [-a FRACTION] [-e ERROR] (-R N B or FILENAME B or -b PATH B or -D SOCKET)\n"\
+	"       histo_program.out merge [-p N] [-o FORMAT] [-O FILE] [-S FILE] [-q] SHARD...\n"\
+	"       histo_program.out range [-O FILE] FILENAME...\n\n"\
+	"Apply histogram data sorting to given (or random) data\n\n"\
+	"Required arguments:\n"\
+	" -R N B\t\t Randomly generate data of size N and apply the histogram data sorting to the data using bin size B.\n"\
+	"\t\t(CANNOT be used with (FILENAME B))\n"\
+	" FILENAME B\t load data to sort from a file using bin size B. (CANNOT be used with (-R N B))\n"\
+	" B = auto\t With -R or FILENAME, pick the number of bins from the data (Freedman-Diaconis)\n"\
+	"\t\t(CANNOT be used with -s)\n"\
+	" -b PATH B\t Batch mode: histogram every file in directory PATH (or listed in file PATH)\n"\
+	"\t\tusing bin size B, writing each result to FILENAME.hist. (CANNOT be used with the others)\n"\
+	" -D SOCKET\t Daemon mode: keep named histograms and serve them on Unix socket SOCKET\n"\
+	"\t\t(CANNOT be used with the others)\n\n"\
+	"Optional arguments:\n"\
+	" -h \t\t show this help message and exit\n"\
+	" -p N\t\t Use parallel binning process with N number of threads.\n"\
+	"\t\t(Default mode is serial, -p auto picks serial or N from a machine profile)\n"\
+	" -v \t\t Be verbose (must be first flag to activate)\n"\
+	"\t\t(only affects parallel mode)\n"\
+	" -o FORMAT\t Output format: text, csv, json or binary (Default is text)\n"\
+	" -O FILE\t Write the output to FILE instead of the screen\n"\
+	" -n \t\t NUMA mode: pin threads to cpus and place each thread's data on its node\n"\
+	"\t\t(only affects parallel mode)\n"\
+	" -H \t\t Use explicit huge pages for big arrays (Default is transparent huge pages)\n"\
+	" -d CHUNK\t Dynamic mode: threads take CHUNK data at a time instead of one fixed slice each\n"\
+	"\t\t(only affects parallel mode)\n"\
+	" -r MIN MAX\t Use the range MIN to MAX instead of finding the min and max of the data.\n"\
+	"\t\tFiles with a known range (from -r or their header) are binned while being read\n"\
+	" -s \t\t Answer from (and build if needed) a fine grained sketch saved as FILENAME.sketch\n"\
+	"\t\t(only with FILENAME B, CANNOT be used with -r)\n"\
+	" -q \t\t Be quiet: do not print status messages\n"\
+	" -c FILE\t Also save the data as a compressed column file FILE (FILENAME B also reads them)\n"\
+	" -i \t\t Integer mode: load (or generate) whole numbers and bin them with exact integer bins\n"\
+	"\t\t(CANNOT be used with -s, -c, -b or -D)\n"\
+	" -S FILE\t Also save the histogram as a shard file FILE that can be merged with others\n"\
+	" -I \t\t Direct I/O: read data files with O_DIRECT, skipping the page cache\n"\
+	" -m MB\t\t Out of core mode: bin a text data file in mapped windows, using at most MB MB of memory\n"\
+	"\t\t(only with FILENAME B, CANNOT be used with -s, -c, -i or B = auto)\n"\
+	" -M \t\t Moments: also find the count, mean, variance, skewness, min and max of the data\n"\
+	"\t\twhile binning it (only with -R or FILENAME B, CANNOT be used with -s or -i)\n"\
+	" -x \t\t Answer from (and build if needed) the data sorted once and saved as FILENAME.index,\n"\
+	"\t\tfor any range and bins (only with FILENAME B, CANNOT be used with -s, -m, -i, -M or B = auto)\n"\
+	" -g \t\t Group mode: FILENAME has key value lines, output one histogram per key with the same bins\n"\
+	"\t\t(only with FILENAME B, CANNOT be used with -s, -x, -m, -i, -M, -c, -S, -o binary or B = auto)\n"\
+	" -a FRACTION\t Approximate: bin a random FRACTION (0 to 1) of the data, with 95%% intervals of the counts\n"\
+	"\t\t(only with -R or FILENAME B, CANNOT be used with -s, -x, -g, -m, -i, -M or -S)\n"\
+	" -e ERROR\t Approximate like -a, picking the fraction for a relative ERROR (like 0.01) on an average bin\n"\
+	"\t\t(CANNOT be used with -a)\n\n"\
+	"Subcommands:\n"\
+	" merge SHARD...\t Add up shard files that have the same bins and output the result\n"\
+	"\t\t(-S saves the result as a shard again)\n"\
+	" range FILENAME...\t Find the range of all the given data files (or range files) together\n"\
+	"\t\tand write it as a range file: 0 MIN MAX\n"
 
 /* Thread status messages for verbose mode */
 #define THREAD_SP_MSG "Thread %lu is spawning: %d\n"
 #define THREAD_CR_MSG "In thread %lu: creating thread %lu\n"
+#define THREAD_PN_MSG "Thread %lu pinned to a cpu: %s\n"
+#define THREAD_PN_OK "yes"
+#define THREAD_PN_FAIL "no"
 
 /* vector status message */
 #define VEC_MSG "Creating vector of size %lu...\n"
+#define VEC_COL_MSG "Decoding %lu column blocks with %lu threads...\n"
+#define VEC_DICT_MSG "Dictionary encoded %lu distinct values...\n"
 
 /* mode names for status message */
 #define METH_SER "Serial"
@@ -39,29 +248,152 @@
 #define H_MM_MSG "Finding min and max values...\n"
 #define H_BM_MSG "Calculting upper bounds for bins...\n"
 #define H_BD_MSG "Binning data in %s...\n"
+#define H_PL_MSG "Binning data in Pipeline with %lu binning threads...\n"
+#define H_SK_MSG "Building sketch %s...\n"
+#define H_RB_MSG "Rebinning from sketch %s...\n"
+#define H_IX_MSG "Sorting data into index %s...\n"
+#define H_IB_MSG "Binning from index %s...\n"
+#define H_OC_MSG "Binning data out of core in %lu MB windows with %lu threads...\n"
+#define H_DC_MSG "Binning %lu distinct values of dictionary data...\n"
+#define H_GR_MSG "Binning data by key with %lu threads...\n"
+#define H_SA_MSG "Binning a %g%% sample of the data with %lu threads...\n"
+#define H_AB_MSG "Picked %lu bins (Freedman-Diaconis, IQR %g)...\n"
+
+/* batch status messages */
+#define BATCH_MSG "Histogramming %lu files with %lu threads...\n"
+#define BATCH_DONE_MSG "Done: %lu files histogrammed, %lu failed\n"
+#define BATCH_FAIL_MSG "Could not histogram %s\n"
+
+/* auto mode status messages */
+#define TUNE_MSG "Measuring this machine for auto mode (saved to %s)...\n"
+#define TUNE_PICK_MSG "Auto mode: binning with %lu threads\n"
+
+/* shard status message */
+#define MERGE_MSG "Merging %lu shards with %lu threads...\n"
+
+/* range file line (an empty data file with a header range) */
+#define RANGE_FORMAT "0 %.17g %.17g\n"
+
+/* daemon status message */
+#define DAEMON_MSG "Serving histograms on %s with %lu threads...\n"
 
 /* bin printing and formatting strings */
 #define BINS_MESSAGE "%10s|%10s|%10s\n"
 #define BINS_MSG_BIN "Bin number"
 #define BINS_MSG_COT "Count"
 #define BINS_MSG_MAX "Upper bound"
+#define BINS_MSG_LOW "Count low"
+#define BINS_MSG_HIGH "Count high"
+#define SAMPLE_BINS_MESSAGE "%10s|%10s|%10s|%10s|%10s\n"
 #define BINS_DATA_MSG "%9lu |%9lu |%9lf\n"
 
+/* output formats names (for the -o flag) */
+#define FORM_TEXT "text"
+#define FORM_CSV "csv"
+#define FORM_JSON "json"
+#define FORM_BINARY "binary"
+
+/* output formatting settings */
+#define FLOAT_BUFFER_SIZE 336 /* max chars written by format_double (%.12f of the largest double is 323) */
+#define BIN_LINE_SIZE 512 /* max chars a single formatted bin can use */
+#define TEXT_COLUMN_WIDTH 9 /* min width for text table columns */
+#define TEXT_PRECISION 6 /* decimals in the text table (same as %lf) */
+#define EXACT_FORMAT "%.17g" /* csv/json numbers, read back as the same double */
+#define JSON_NULL "null" /* json numbers that are nan or inf */
+#define FIXED_POINT_LIMIT 1e15 /* larger values are formatted by printf */
+#define ROUNDING_MARGIN 1e-3 /* fractions this close to a half are rounded by printf */
+#define OUTPUT_BUFFER_SIZE 65536 /* starting size of an output buffer */
+#define PARALLEL_FORMAT_MIN 65536 /* min bins per thread for parallel output */
+
+/* output format strings */
+#define CSV_HEADER "bin,count,lower_bound,upper_bound\n"
+#define JSON_HEAD_BINS "{\"bin_count\":"
+#define JSON_HEAD_MIN ",\"min\":"
+#define JSON_HEAD_MAX ",\"max\":"
+#define JSON_HEAD_WIDTH ",\"bin_width\":"
+#define JSON_HEAD_UNDER ",\"underflow\":"
+#define JSON_HEAD_OVER ",\"overflow\":"
+#define JSON_HEAD_NAN ",\"nan\":"
+#define JSON_HEAD_LIST ",\"bins\":["
+#define JSON_BIN_NUM "{\"bin\":"
+#define JSON_BIN_COT ",\"count\":"
+#define JSON_BIN_LOW ",\"lower_bound\":"
+#define JSON_BIN_MAX ",\"upper_bound\":"
+#define JSON_FOOTER "]}\n"
+
+/* sampled output strings (see output.h) */
+#define SAMPLE_CSV_HEADER "bin,count,lower_bound,upper_bound,count_low,count_high\n"
+#define SAMPLE_CSV "sample_fraction,%.17g,,\n"
+#define SAMPLE_TEXT "Sampled: %.9g of the data, counts are estimates with 95%% intervals\n"
+#define JSON_HEAD_SAMPLE ",\"sample_fraction\":"
+#define JSON_BIN_LOW_COT ",\"count_low\":"
+#define JSON_BIN_HIGH_COT ",\"count_high\":"
+
+/* grouped output strings (see output.h) */
+#define GROUP_CSV_HEADER "key,bin,count,lower_bound,upper_bound\n"
+#define GROUP_REJECT_CSV ",%s,%lu,,\n"
+#define GROUP_UNDER "underflow"
+#define GROUP_OVER "overflow"
+#define GROUP_NAN "nan"
+#define GROUP_TEXT_KEY "Key: "
+#define JSON_HEAD_GROUPS ",\"groups\":["
+#define JSON_GROUP_KEY "{\"key\":"
+#define JSON_CONTROL "\\u%04x"
+
+/* rejected data after the bins (only when there is any) */
+#define REJECT_TEXT "Rejected: %lu underflow, %lu overflow, %lu NaN\n"
+#define REJECT_CSV "underflow,%lu,,\noverflow,%lu,,\nnan,%lu,,\n"
+
+/* moments of the data (only when asked for) */
+#define MOMENTS_TEXT "Moments: count %lu, mean %.9g, variance %.9g, skewness %.9g, min %.9g, max %.9g\n"
+#define MOMENTS_CSV "count,%lu,,\nmean,%.17g,,\nvariance,%.17g,,\nskewness,%.17g,,\nmin,%.17g,,\nmax,%.17g,,\n"
+#define JSON_MOMENTS ",\"moments\":{\"count\":%lu,\"mean\":%s,\"variance\":%s,\"skewness\":%s,\"min\":%s,\"max\":%s}"
+
+/* binary output header */
+#define BIN_MAGIC "HBIN"
+#define BIN_VERSION 4
+
 /* cmd argument error messages */
 #define BAD_ARGS_MESSAGE "Missing number arguments to %s\n"
 #define BAD_ARG_MESSAGE "Missing number argument N to %s\n"
 #define BAD_BIN_MESSAGE "Missing number argument B to %s\n"
 #define BAD_NUM_MESSAGE "Number argument to %s is NaN\n"
+#define BAD_FRAC_MESSAGE "Number argument to %s must be above 0 and at most 1\n"
+#define BAD_ERR_MESSAGE "Number argument to %s must be above 0 and finite\n"
 #define BAD_NIN_MESSAGE "Bin number argument to %s is NaN\n"
 #define BAD_ARGS "Missing arguments\n"
+#define BAD_FORM_MESSAGE "Unknown output format %s (use text, csv, json or binary)\n"
+#define BAD_OUTF_MESSAGE "Missing filename argument to %s\n"
+#define BAD_FLAG_MESSAGE "Unknown argument %s\n"
+#define BAD_RANGE_MESSAGE "Range arguments to %s must be numbers MIN MAX with MIN < MAX\n"
 
 /* general error messages */
 #define ERROR_FILENAME "File %s not found\n"
 #define ERROR_UNKNOWN "Unknown error occured\n"
 #define ERROR_NO_DATA "No data was found\n"
+#define ERROR_BAD_DATA "Data file is not in the right format\n"
 #define ERROR_THREAD_CR "ERROR; return code from pthread_create() is %d\n"
 #define ERROR_THREAD_JN "ERROR; return code from pthread_join() is %d\n"
 #define ERROR_TOO_MANY_THREADS "ERROR: Max thread:data ratio is 1:1. Given: %lu:%lu\n"
 #define ERROR_SINGLE_THREAD "ERROR: parallel mode requires more than 1 thread\n"
+#define ERROR_OUTPUT_FILE "ERROR: could not open output file %s\n"
+#define ERROR_OUTPUT "ERROR: could not write the histogram output\n"
+#define ERROR_SKETCH_RANGE "ERROR: %s cannot be used with %s\n"
+#define ERROR_SKETCH_SAVE "Could not save sketch %s\n"
+#define ERROR_INDEX_SAVE "Could not save index %s\n"
+#define ERROR_BATCH_MODE "ERROR: %s cannot be used with -R or FILENAME\n"
+#define ERROR_DAEMON_MODE "ERROR: %s cannot be used with -R, FILENAME or -b\n"
+#define ERROR_COLUMN_SAVE "Could not save column file %s\n"
+#define ERROR_TUNE_SAVE "Could not save machine profile %s\n"
+#define ERROR_SHARD_LOAD "ERROR: could not load shard %s\n"
+#define ERROR_SHARD_BINS "ERROR: shard %s does not have the same bins as shard %s\n"
+#define ERROR_SHARD_SAVE "Could not save shard %s\n"
+#define ERROR_NO_SHARDS "ERROR: %s needs at least one file\n"
+#define ERROR_OUTCORE_MAP "ERROR: %s could not map the data file (it must be a regular text data file)\n"
+#define ERROR_GROUP_MAP "ERROR: %s could not map the data file (it must be a regular key value data file)\n"
+#define ERROR_OUTCORE_BUDGET "ERROR: a memory budget of %lu MB is too small for %lu threads with %lu bins\n"
+#define ERROR_DAEMON_SOCKET "ERROR: could not serve on socket %s\n"
+#define ERROR_INTEGER_WIDTH "ERROR: integers from %ld to %ld do not fit in %lu bin (use more bins)\n"
+#define ERROR_INTEGER_COLUMNS "ERROR: %s cannot be used with a column data file\n"
 
 #endif
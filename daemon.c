@@ -0,0 +1,463 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Daemon functions serve named histograms over a Unix domain socket.
+ *
+ * Named histograms are never removed while the daemon runs, so a
+ * connection can keep using an entry after looking it up once.
+ */
+
+#define _DEFAULT_SOURCE /* for sockets and _SC_NPROCESSORS_ONLN */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "concurrent.h"
+#include "daemon.h"
+#include "histogram.h"
+#include "memory.h"
+#include "output.h"
+#include "pool.h"
+#include "status.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* a named histogram */
+typedef struct{
+	char name[DAEMON_NAME_SIZE]; /* its name */
+	concurrent_histogram* counts; /* its bins, with one producer per worker */
+}daemon_entry;
+
+/* the whole daemon */
+typedef struct{
+	unsigned long thread_count; /* number of workers */
+	daemon_entry** entries; /* every named histogram */
+	unsigned long entry_count; /* number of named histograms */
+	unsigned long entry_capacity; /* size of entries */
+	pthread_mutex_t lock; /* guards entries */
+}daemon_state;
+
+/* an accepted connection */
+typedef struct{
+	daemon_state* state; /* the daemon it belongs to */
+	int fd; /* its socket */
+}daemon_connection;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Creates the named histogram with the given shape
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if it was created (or already had that shape)
+ * 	FAIL if it already exists with another shape
+ * 	ERROR if the shape is not valid
+ */
+static int create_entry(daemon_state* state, const char* name, daemon_shape* shape);
+
+/**
+ * @returns the named histogram, NULL if there is none
+ */
+static daemon_entry* find_entry(daemon_state* state, const char* name);
+
+/**
+ * Finds the given quantiles (0 to 1) of the summed counts
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if every quantile was in 0 to 1
+ * 	FAIL if one was not
+ */
+static int find_quantiles(histogram* graph, unsigned long* counts, double* quantiles, unsigned long count, double* values);
+
+/**
+ * Reads exactly length bytes from fd
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if everything was read
+ * 	FAIL if the other side closed first
+ * 	ERROR if the read failed
+ */
+static int read_fully(int fd, void* buffer, size_t length);
+
+/**
+ * Task that answers the requests of one connection until it closes
+ * (daemon_connection)
+ */
+static void serve_connection(void* arg, unsigned long worker_id);
+
+/**
+ * Writes exactly length bytes to fd
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if everything was written
+ * 	ERROR if the write failed
+ */
+static int write_fully(int fd, const void* buffer, size_t length);
+
+/**
+ * Writes a reply header and its payload
+ *
+ * USES RETURN_CODE
+ * @returns same codes as write_fully
+ */
+static int write_reply(int fd, int status, const void* payload, size_t length);
+
+/*	FUNCTIONS	======================================================*/
+
+static int create_entry(daemon_state* state, const char* name, daemon_shape* shape){
+	daemon_entry* entry;
+	int rc;
+
+	if(shape->bin_count < 1 || !(shape->min < shape->max)){
+		return ERROR;
+	}
+
+	pthread_mutex_lock(&state->lock);
+
+	entry = find_entry(state, name);
+
+	/* creating it again is fine, as long as it has the same shape */
+	if(entry){
+		rc = (entry->counts->graph->bin_count == shape->bin_count && entry->counts->graph->min == shape->min
+			&& entry->counts->graph->max == shape->max) ? SUCCESS : FAIL;
+		pthread_mutex_unlock(&state->lock);
+		return rc;
+	}
+
+	entry = malloc(sizeof(daemon_entry));
+	strcpy(entry->name, name);
+	entry->counts = init_concurrent_histogram(shape->min, shape->max, shape->bin_count, state->thread_count);
+
+	if(state->entry_count == state->entry_capacity){
+		state->entry_capacity = (state->entry_capacity > 0) ? state->entry_capacity*2 : DAEMON_ENTRY_SIZE;
+		state->entries = realloc(state->entries, state->entry_capacity*sizeof(daemon_entry*));
+	}
+	state->entries[state->entry_count++] = entry;
+
+	pthread_mutex_unlock(&state->lock);
+	return SUCCESS;
+}
+
+static daemon_entry* find_entry(daemon_state* state, const char* name){
+	unsigned long t;
+
+	for(t=0; t < state->entry_count; t++){
+		if(strcmp(state->entries[t]->name, name) == 0){
+			return state->entries[t];
+		}
+	}
+	return NULL;
+}
+
+static int find_quantiles(histogram* graph, unsigned long* counts, double* quantiles, unsigned long count, double* values){
+	unsigned long t, bin, total, seen;
+	double target, lower;
+
+	total = 0;
+	for(bin=0; bin < graph->bin_count; bin++){
+		total += counts[bin];
+	}
+
+	for(t=0; t < count; t++){
+		if(!(quantiles[t] >= 0 && quantiles[t] <= 1)){
+			return FAIL;
+		}
+
+		/* nothing binned yet */
+		if(total == 0){
+			values[t] = NAN;
+			continue;
+		}
+
+		/* find the bin holding the target, then go that far into it */
+		target = quantiles[t]*total;
+		seen = 0;
+		for(bin=0; bin < graph->bin_count-1; bin++){
+			if(counts[bin] > 0 && seen + counts[bin] >= target){
+				break;
+			}
+			seen += counts[bin];
+		}
+
+		lower = (bin == 0) ? graph->min : graph->bin_maxes[bin-1];
+		if(counts[bin] > 0){
+			values[t] = lower + (graph->bin_maxes[bin] - lower)*((target - seen)/counts[bin]);
+		}else{
+			values[t] = lower;
+		}
+	}
+
+	return SUCCESS;
+}
+
+static int read_fully(int fd, void* buffer, size_t length){
+	ssize_t read_size;
+	size_t done;
+
+	done = 0;
+	while(done < length){
+		read_size = read(fd, (char*)buffer + done, length - done);
+
+		if(read_size == 0){
+			return FAIL;
+		}
+		if(read_size < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			return ERROR;
+		}
+		done += read_size;
+	}
+	return SUCCESS;
+}
+
+int run_daemon(const char* path, unsigned long thread_count){
+	daemon_state state;
+	daemon_connection* connection;
+	struct sockaddr_un address;
+	thread_pool* pool;
+	unsigned long t;
+	int listen_fd, fd;
+
+	/* clients going away must not kill the daemon */
+	signal(SIGPIPE, SIG_IGN);
+
+	if(strlen(path) >= sizeof(address.sun_path)){
+		printf(ERROR_DAEMON_SOCKET, path);
+		return ERROR;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	/* replace any socket left over from an old daemon */
+	unlink(path);
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&address, sizeof(address))
+		|| listen(listen_fd, DAEMON_BACKLOG)){
+		printf(ERROR_DAEMON_SOCKET, path);
+		if(listen_fd >= 0){
+			close(listen_fd);
+		}
+		return ERROR;
+	}
+
+	/* default to one worker per cpu */
+	if(thread_count < 1){
+		thread_count = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+	}
+
+	state.thread_count = thread_count;
+	state.entries = NULL;
+	state.entry_count = 0;
+	state.entry_capacity = 0;
+	pthread_mutex_init(&state.lock, NULL);
+
+	pool = init_pool(thread_count);
+
+	print_status(DAEMON_MSG, path, thread_count);
+
+	/* the workers would print a status message for every histogram */
+	set_quiet_mode(true);
+
+	while(true){
+		fd = accept(listen_fd, NULL, NULL);
+
+		if(fd < 0){
+			if(errno == EINTR || errno == ECONNABORTED){
+				continue;
+			}
+			break;
+		}
+
+		/* the task frees this when the connection closes */
+		connection = malloc(sizeof(daemon_connection));
+		connection->state = &state;
+		connection->fd = fd;
+		pool_submit(pool, serve_connection, (void*)connection);
+	}
+
+	printf(ERROR_DAEMON_SOCKET, path);
+	close(listen_fd);
+	unlink(path);
+
+	/* Delete what we dont need anymore */
+	delete_pool(pool);
+	for(t=0; t < state.entry_count; t++){
+		delete_concurrent_histogram(state.entries[t]->counts);
+		free(state.entries[t]);
+	}
+	free(state.entries);
+	pthread_mutex_destroy(&state.lock);
+
+	return ERROR;
+}
+
+static void serve_connection(void* arg, unsigned long worker_id){
+	daemon_connection* connection;
+	daemon_state* state;
+	daemon_request request;
+	daemon_entry* entry;
+	histogram* snapshot;
+	char name[DAEMON_NAME_SIZE];
+	char* payload;
+	unsigned long* counts;
+	double* values;
+	unsigned long capacity, total, count;
+	int rc;
+
+	connection = (daemon_connection*) arg;
+	state = connection->state;
+	payload = NULL;
+	capacity = 0;
+	entry = NULL;
+
+	while(read_fully(connection->fd, &request, sizeof(daemon_request)) == SUCCESS){
+
+		/* the rest of the stream cannot be trusted after a bad header */
+		if(request.name_length >= DAEMON_NAME_SIZE || request.payload_length > DAEMON_MAX_PAYLOAD){
+			write_reply(connection->fd, ERROR, NULL, 0);
+			break;
+		}
+
+		/* the payload goes straight into the buffer it is binned from */
+		if(request.payload_length > capacity){
+			free_block(payload);
+			payload = alloc_block(request.payload_length);
+			capacity = request.payload_length;
+		}
+
+		if(read_fully(connection->fd, name, request.name_length)
+			|| read_fully(connection->fd, payload, request.payload_length)){
+			break;
+		}
+		name[request.name_length] = '\0';
+
+		/* look up the histogram once per name, not once per request */
+		if(request.op != DAEMON_CREATE && (!entry || strcmp(entry->name, name) != 0)){
+			pthread_mutex_lock(&state->lock);
+			entry = find_entry(state, name);
+			pthread_mutex_unlock(&state->lock);
+		}
+
+		if(request.op != DAEMON_CREATE && !entry){
+			rc = write_reply(connection->fd, FAIL, NULL, 0);
+		}
+
+		else if(request.op == DAEMON_CREATE){
+			if(request.payload_length != sizeof(daemon_shape)){
+				rc = write_reply(connection->fd, ERROR, NULL, 0);
+			}else{
+				rc = write_reply(connection->fd, create_entry(state, name, (daemon_shape*)payload), NULL, 0);
+			}
+		}
+
+		else if(request.op == DAEMON_INGEST){
+			if(request.payload_length % sizeof(double) != 0){
+				rc = write_reply(connection->fd, ERROR, NULL, 0);
+			}else{
+				record_samples(entry->counts, worker_id, (double*)payload, request.payload_length/sizeof(double));
+				rc = write_reply(connection->fd, SUCCESS, NULL, 0);
+			}
+		}
+
+		else if(request.op == DAEMON_COUNT){
+			counts = alloc_bin_counts(entry->counts->graph->bin_count);
+			total = sum_concurrent_histogram(entry->counts, counts);
+			free_block(counts);
+
+			rc = write_reply(connection->fd, SUCCESS, &total, sizeof(unsigned long));
+		}
+
+		else if(request.op == DAEMON_QUANTILE){
+			count = request.payload_length/sizeof(double);
+			counts = alloc_bin_counts(entry->counts->graph->bin_count);
+			values = malloc((count > 0 ? count : 1)*sizeof(double));
+			sum_concurrent_histogram(entry->counts, counts);
+
+			if(find_quantiles(entry->counts->graph, counts, (double*)payload, count, values)){
+				rc = write_reply(connection->fd, FAIL, NULL, 0);
+			}else{
+				rc = write_reply(connection->fd, SUCCESS, values, count*sizeof(double));
+			}
+			free_block(counts);
+			free(values);
+		}
+
+		else if(request.op == DAEMON_SNAPSHOT){
+
+			/* the entry's shape with the summed counts */
+			snapshot = snapshot_concurrent_histogram(entry->counts);
+
+			rc = write_reply(connection->fd, SUCCESS, NULL, sizeof(binary_header) + snapshot->bin_count*(sizeof(unsigned long) + sizeof(double)));
+			if(rc == SUCCESS){
+				rc = write_histogram(snapshot, FORMAT_BINARY, connection->fd, 1);
+			}
+			delete_histogram(snapshot);
+		}
+
+		/* we dont know what this is */
+		else{
+			rc = write_reply(connection->fd, ERROR, NULL, 0);
+		}
+
+		/* the client is gone */
+		if(rc){
+			break;
+		}
+	}
+
+	close(connection->fd);
+	free_block(payload);
+	free(connection);
+}
+
+static int write_fully(int fd, const void* buffer, size_t length){
+	ssize_t write_size;
+	size_t done;
+
+	done = 0;
+	while(done < length){
+		write_size = write(fd, (const char*)buffer + done, length - done);
+
+		if(write_size < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			return ERROR;
+		}
+		done += write_size;
+	}
+	return SUCCESS;
+}
+
+static int write_reply(int fd, int status, const void* payload, size_t length){
+	daemon_reply reply;
+
+	memset(&reply, 0, sizeof(daemon_reply));
+	reply.status = status;
+	reply.payload_length = length;
+
+	if(write_fully(fd, &reply, sizeof(daemon_reply))){
+		return ERROR;
+	}
+
+	/* snapshots write their own payload */
+	if(payload && write_fully(fd, payload, length)){
+		return ERROR;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,81 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Daemon functions keep named histograms resident in a long running
+ * process that takes samples and queries over a Unix domain socket,
+ * so many small jobs do not each pay for startup, allocation and
+ * thread creation.
+ *
+ * Every message is a fixed header, then the histogram name (no '\0'),
+ * then the payload. Every request gets one reply: a fixed header, then
+ * its payload. Everything is in native byte order.
+ *
+ * Requests:
+ * DAEMON_CREATE	payload daemon_shape. Creates the named histogram
+ * 			(or does nothing if it already exists with that shape)
+ * DAEMON_INGEST	payload double values[n]. Bins the values (values
+ * 			outside of min to max are counted as rejects)
+ * DAEMON_COUNT		no payload. Replies uint64 number of binned values
+ * 			(without rejects)
+ * DAEMON_QUANTILE	payload double q[k] (0 to 1). Replies double[k],
+ * 			interpolated inside the bin holding each quantile
+ * DAEMON_SNAPSHOT	no payload. Replies the binary output format
+ * 			(see output.h)
+ *
+ * Connections are served by a thread pool, one connection per worker
+ * at a time, so at most thread_count clients are served at once.
+ * Ingested payloads are read straight into a per-connection buffer and
+ * binned from there into that worker's own shard of a concurrent
+ * histogram (see concurrent.h), so ingest takes no locks. Queries add
+ * up the shards of every worker while ingest goes on.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+/*	TYPES	==========================================================*/
+
+/* the request types */
+typedef enum{
+	DAEMON_CREATE = 1,
+	DAEMON_INGEST = 2,
+	DAEMON_COUNT = 3,
+	DAEMON_QUANTILE = 4,
+	DAEMON_SNAPSHOT = 5
+}DAEMON_OP;
+
+/* header of a request */
+typedef struct{
+	unsigned int op; /* a DAEMON_OP */
+	unsigned int name_length; /* chars of name that follow */
+	unsigned long payload_length; /* bytes of payload after the name */
+}daemon_request;
+
+/* header of a reply */
+typedef struct{
+	int status; /* a RETURN_CODE (FAIL for unknown histograms) */
+	unsigned int padding;
+	unsigned long payload_length; /* bytes of payload that follow */
+}daemon_reply;
+
+/* payload of DAEMON_CREATE */
+typedef struct{
+	double min;
+	double max;
+	unsigned long bin_count;
+}daemon_shape;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Serves requests on a Unix domain socket at the given path (replacing
+ * any old socket there) with thread_count workers (0 for one per
+ * online cpu). Only returns if the socket cannot be served.
+ *
+ * USES RETURN_CODE
+ * @returns ERROR if the socket could not be created or accepted on
+ */
+int run_daemon(const char* path, unsigned long thread_count);
+
+#endif
@@ -0,0 +1,578 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Group functions bin key value data files into one histogram per key.
+ *
+ * Records point at their keys in the mapped file, so keys are only
+ * copied once, for the keys of the result. A thread's records for each
+ * owner are kept apart (its outboxes), so the owners read them without
+ * locks once every thread is done parsing.
+ */
+
+#define _DEFAULT_SOURCE /* for fileno and mmap */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "group.h"
+#include "histogram.h"
+#include "kernels.h"
+#include "parallel_helpers.h"
+#include "status.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* one key value line */
+typedef struct{
+	const char* key; /* the key (in the mapped file) */
+	unsigned int length; /* chars in the key */
+	unsigned int hash; /* hash of the key (see hash_key) */
+	double value; /* the value */
+}group_record;
+
+/* a growing list of records */
+typedef struct{
+	group_record* records; /* the records */
+	unsigned long size; /* number of records */
+	unsigned long capacity; /* number of records allocated */
+}record_list;
+
+/* the lines of the file one thread parses */
+typedef struct{
+	const char* map; /* the mapped file (shared) */
+	size_t data_start; /* first byte after the header line */
+	size_t file_size; /* bytes in the file */
+	size_t start; /* first byte of the region */
+	size_t end; /* one past the last byte of the region */
+	unsigned long limit; /* most lines to take */
+	unsigned long thread_count; /* number of owners */
+	record_list* outboxes; /* the records for each owner */
+	unsigned long count; /* lines taken */
+	double min; /* min of the values taken */
+	double max; /* max of the values taken */
+	int rc; /* RETURN_CODE of the region */
+}group_region;
+
+/* the keys one thread owns */
+typedef struct{
+	histogram* graph; /* the bins (shared) */
+	group_region* regions; /* every region (shared) */
+	unsigned long thread_count; /* number of regions (and owners) */
+	unsigned long id; /* the owner this table is for */
+	unsigned long* slots; /* hash table of keys, 1 + their index (0 is empty) */
+	unsigned long slot_count; /* a power of two */
+	group_record* keys; /* the first record of every key */
+	unsigned long* counts; /* the counts of every key, one after the other */
+	unsigned long group_count; /* number of keys */
+	unsigned long capacity; /* number of keys allocated */
+}group_table;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Adds a copy of record to the list (growing it if needed)
+ */
+static void add_record(record_list* list, group_record* record);
+
+/**
+ * Bins the records a group_table owns, from every region
+ * (thread function)
+ */
+static void* bin_records(void* data);
+
+/**
+ * Orders group_entrys by key (for qsort)
+ */
+static int compare_entries(const void* a, const void* b);
+
+/**
+ * @returns the bin (or reject counter) of value, like count_bins
+ * 	(scale is 1 / bin_width)
+ */
+static unsigned long find_group_bin(histogram* graph, double value, double scale);
+
+/**
+ * Finds the key of record in the table, adding it if it is new
+ *
+ * @returns the index of the key
+ */
+static unsigned long find_key(group_table* table, group_record* record);
+
+/**
+ * Doubles the slots of the table and puts every key back in them
+ */
+static void grow_table(group_table* table);
+
+/**
+ * @returns the FNV-1a hash of the given key
+ */
+static unsigned int hash_key(const char* key, unsigned long length);
+
+/**
+ * @returns true if c is a space between keys and values
+ */
+static bool is_blank(char c);
+
+/**
+ * Parses the lines of a group_region into its outboxes
+ * (thread function)
+ */
+static void* parse_region(void* data);
+
+/**
+ * Runs function on each of count items (item_size bytes apart), one
+ * thread each (or on this thread, for one item)
+ */
+static void run_threads(void* (*function)(void*), void* items, size_t item_size, unsigned long count);
+
+/**
+ * Drops the lines past size (refer to top of group.h), parsing the
+ * region size ends in again up to it
+ */
+static void trim_regions(group_region* regions, unsigned long thread_count, unsigned long size);
+
+/*	FUNCTIONS	======================================================*/
+
+static void add_record(record_list* list, group_record* record){
+	if(list->size == list->capacity){
+		list->capacity = list->capacity ? list->capacity*2 : GROUP_LIST_SIZE;
+		list->records = realloc(list->records, list->capacity*sizeof(group_record));
+	}
+
+	list->records[list->size++] = *record;
+}
+
+static void* bin_records(void* data){
+	group_table* table;
+	record_list* list;
+	unsigned long region, t, key, stride;
+	double scale;
+
+	table = (group_table*) data;
+	stride = table->graph->bin_count + REJECT_COUNT;
+	scale = (table->graph->bin_width > 0) ? 1.0/table->graph->bin_width : 0;
+
+	/* the regions in order, so keys are found in the order of the file */
+	for(region=0; region < table->thread_count; region++){
+		list = &table->regions[region].outboxes[table->id];
+		for(t=0; t < list->size; t++){
+			key = find_key(table, &list->records[t]);
+			table->counts[key*stride + find_group_bin(table->graph, list->records[t].value, scale)] += 1;
+		}
+	}
+
+	return NULL;
+}
+
+static int compare_entries(const void* a, const void* b){
+	return strcmp(((const group_entry*)a)->key, ((const group_entry*)b)->key);
+}
+
+void delete_group_set(group_set* groups){
+	unsigned long t;
+
+	if(groups){
+		for(t=0; t < groups->block_count; t++){
+			free(groups->blocks[t]);
+		}
+		free(groups->blocks);
+		free(groups->entries);
+		free(groups->key_text);
+		free(groups);
+	}
+}
+
+static unsigned long find_group_bin(histogram* graph, double value, double scale){
+	unsigned long bin;
+
+	if(scale > 0){
+		return find_bin_scaled(graph, value, scale);
+	}
+
+	/* all data is the same value */
+	bin = find_bin(value, graph);
+	if(bin == graph->bin_count){
+		bin += (value > graph->max)*REJECT_OVERFLOW + (value != value)*REJECT_NAN;
+	}
+	return bin;
+}
+
+static unsigned long find_key(group_table* table, group_record* record){
+	unsigned long slot, key, stride;
+	group_record* found;
+
+	/* the owner is picked by the hash modulo the threads, so the slot
+	 * uses what is left of it */
+	slot = (record->hash / table->thread_count) & (table->slot_count-1);
+	while(table->slots[slot]){
+		found = &table->keys[table->slots[slot]-1];
+		if(found->hash == record->hash && found->length == record->length
+			&& memcmp(found->key, record->key, record->length) == 0){
+			return table->slots[slot]-1;
+		}
+		slot = (slot+1) & (table->slot_count-1);
+	}
+
+	/* a new key, with counts at the end of the block */
+	stride = table->graph->bin_count + REJECT_COUNT;
+	if(table->group_count == table->capacity){
+		table->capacity *= 2;
+		table->keys = realloc(table->keys, table->capacity*sizeof(group_record));
+		table->counts = realloc(table->counts, table->capacity*stride*sizeof(unsigned long));
+		memset(table->counts + table->group_count*stride, 0, (table->capacity - table->group_count)*stride*sizeof(unsigned long));
+	}
+	key = table->group_count++;
+	table->keys[key] = *record;
+	table->slots[slot] = key+1;
+
+	/* keep the table at most half full */
+	if(2*table->group_count > table->slot_count){
+		grow_table(table);
+	}
+
+	return key;
+}
+
+static void grow_table(group_table* table){
+	unsigned long key, slot;
+
+	free(table->slots);
+	table->slot_count *= 2;
+	table->slots = calloc(table->slot_count, sizeof(unsigned long));
+
+	for(key=0; key < table->group_count; key++){
+		slot = (table->keys[key].hash / table->thread_count) & (table->slot_count-1);
+		while(table->slots[slot]){
+			slot = (slot+1) & (table->slot_count-1);
+		}
+		table->slots[slot] = key+1;
+	}
+}
+
+static unsigned int hash_key(const char* key, unsigned long length){
+	unsigned long t;
+	unsigned int hash;
+
+	hash = GROUP_HASH_BASIS;
+	for(t=0; t < length; t++){
+		hash ^= (unsigned char)key[t];
+		hash *= GROUP_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+group_set* init_group_set(histogram* graph){
+	group_set* groups;
+
+	groups = calloc(1, sizeof(group_set));
+	groups->graph = graph;
+
+	return groups;
+}
+
+static bool is_blank(char c){
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void* parse_region(void* data){
+	group_region* region;
+	group_record record;
+	const char* map;
+	const char* line_end;
+	char number[GROUP_MAX_NUMBER+1];
+	char* number_end;
+	size_t position, end, key_start, value_start;
+
+	region = (group_region*) data;
+	region->rc = SUCCESS;
+	region->count = 0;
+	region->min = HUGE_VAL;
+	region->max = -HUGE_VAL;
+	map = region->map;
+
+	/* the line we start in belongs to the region before */
+	position = region->start;
+	if(position > region->data_start){
+		while(position < region->end && map[position-1] != '\n'){
+			position += 1;
+		}
+	}
+
+	while(position < region->end && region->count < region->limit){
+
+		/* the line is up to the next newline (or the end of the file) */
+		line_end = memchr(map + position, '\n', region->file_size - position);
+		end = line_end ? (size_t)(line_end - map) : region->file_size;
+
+		while(position < end && is_blank(map[position])){
+			position += 1;
+		}
+
+		/* an empty line */
+		if(position == end){
+			position = end+1;
+			continue;
+		}
+
+		/* the key, then its value */
+		key_start = position;
+		while(position < end && !is_blank(map[position])){
+			position += 1;
+		}
+		record.key = map + key_start;
+		record.length = position - key_start;
+
+		while(position < end && is_blank(map[position])){
+			position += 1;
+		}
+		value_start = position;
+		while(position < end && !is_blank(map[position])){
+			position += 1;
+		}
+
+		/* the value is copied out, strtod could run off the mapping */
+		if(position == value_start || position - value_start > GROUP_MAX_NUMBER){
+			region->rc = FAIL;
+			return NULL;
+		}
+		memcpy(number, map + value_start, position - value_start);
+		number[position - value_start] = '\0';
+		record.value = strtod(number, &number_end);
+
+		/* not a number, or more after it */
+		while(position < end && is_blank(map[position])){
+			position += 1;
+		}
+		if(*number_end != '\0' || position != end){
+			region->rc = FAIL;
+			return NULL;
+		}
+
+		record.hash = hash_key(record.key, record.length);
+		add_record(&region->outboxes[record.hash % region->thread_count], &record);
+
+		region->count += 1;
+		region->min = (record.value < region->min) ? record.value : region->min;
+		region->max = (record.value > region->max) ? record.value : region->max;
+		position = end+1;
+	}
+
+	return NULL;
+}
+
+int process_file_grouped(group_set* groups, FILE* file, unsigned long size, bool has_range, unsigned long thread_count){
+	group_region* regions;
+	group_table* tables;
+	struct stat info;
+	const char* map;
+	char* key_text;
+	unsigned long t, key, entry, stride, key_bytes;
+	double min, max;
+	size_t data_size;
+	long position;
+	int fd, rc;
+
+	/* only a regular file can be mapped */
+	fd = fileno(file);
+	position = ftell(file);
+	if(fstat(fd, &info) || !S_ISREG(info.st_mode) || position < 0){
+		printf(ERROR_GROUP_MAP, GRUP_FLAG);
+		return ERROR;
+	}
+
+	/* an empty file has nothing to map */
+	map = NULL;
+	if(info.st_size > position){
+		map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(map == MAP_FAILED){
+			printf(ERROR_GROUP_MAP, GRUP_FLAG);
+			return ERROR;
+		}
+	}
+
+	print_status(H_GR_MSG, thread_count);
+
+	/* one region of the lines per thread */
+	data_size = map ? info.st_size - position : 0;
+	regions = calloc(thread_count, sizeof(group_region));
+	for(t=0; t < thread_count; t++){
+		regions[t].map = map;
+		regions[t].data_start = position;
+		regions[t].file_size = info.st_size;
+		regions[t].start = position + calculate_start_index(t, thread_count, data_size);
+		regions[t].end = position + calculate_start_index(t+1, thread_count, data_size);
+		regions[t].limit = size;
+		regions[t].thread_count = thread_count;
+		regions[t].outboxes = calloc(thread_count, sizeof(record_list));
+	}
+
+	/* parse (and partition) every region, then keep size lines */
+	run_threads(parse_region, regions, sizeof(group_region), thread_count);
+	trim_regions(regions, thread_count, size);
+
+	rc = SUCCESS;
+	min = HUGE_VAL;
+	max = -HUGE_VAL;
+	for(t=0; t < thread_count; t++){
+		if(regions[t].rc){
+			rc = FAIL;
+		}
+		min = (regions[t].min < min) ? regions[t].min : min;
+		max = (regions[t].max > max) ? regions[t].max : max;
+	}
+
+	/* bins from the values, if we need them */
+	if(rc == SUCCESS && !has_range){
+		if(!(min <= max)){
+			printf(ERROR_NO_DATA);
+			rc = ERROR;
+		}else{
+			process_stats_range(groups->graph, min, max);
+		}
+	}
+
+	/* every owner bins its keys */
+	stride = groups->graph->bin_count + REJECT_COUNT;
+	tables = calloc(thread_count, sizeof(group_table));
+	if(rc == SUCCESS){
+		for(t=0; t < thread_count; t++){
+			tables[t].graph = groups->graph;
+			tables[t].regions = regions;
+			tables[t].thread_count = thread_count;
+			tables[t].id = t;
+			tables[t].slot_count = GROUP_TABLE_SIZE;
+			tables[t].slots = calloc(GROUP_TABLE_SIZE, sizeof(unsigned long));
+			tables[t].capacity = GROUP_KEY_SIZE;
+			tables[t].keys = malloc(tables[t].capacity*sizeof(group_record));
+			tables[t].counts = calloc(tables[t].capacity*stride, sizeof(unsigned long));
+		}
+		run_threads(bin_records, tables, sizeof(group_table), thread_count);
+	}
+
+	/* copy out the keys (the map is going away) and sort them */
+	if(rc == SUCCESS){
+		groups->group_count = 0;
+		key_bytes = 0;
+		for(t=0; t < thread_count; t++){
+			groups->group_count += tables[t].group_count;
+			for(key=0; key < tables[t].group_count; key++){
+				key_bytes += tables[t].keys[key].length + 1;
+			}
+		}
+
+		groups->entries = malloc((groups->group_count ? groups->group_count : 1)*sizeof(group_entry));
+		groups->key_text = malloc(key_bytes ? key_bytes : 1);
+		groups->blocks = malloc(thread_count*sizeof(unsigned long*));
+		groups->block_count = thread_count;
+
+		key_text = groups->key_text;
+		entry = 0;
+		for(t=0; t < thread_count; t++){
+			for(key=0; key < tables[t].group_count; key++){
+				memcpy(key_text, tables[t].keys[key].key, tables[t].keys[key].length);
+				key_text[tables[t].keys[key].length] = '\0';
+				groups->entries[entry].key = key_text;
+				groups->entries[entry].counts = tables[t].counts + key*stride;
+				key_text += tables[t].keys[key].length + 1;
+				entry += 1;
+			}
+
+			/* the counts now belong to the group set */
+			groups->blocks[t] = tables[t].counts;
+			tables[t].counts = NULL;
+		}
+
+		qsort(groups->entries, groups->group_count, sizeof(group_entry), compare_entries);
+	}
+
+	for(t=0; t < thread_count; t++){
+		for(key=0; key < thread_count; key++){
+			free(regions[t].outboxes[key].records);
+		}
+		free(regions[t].outboxes);
+		free(tables[t].slots);
+		free(tables[t].keys);
+		free(tables[t].counts);
+	}
+	free(regions);
+	free(tables);
+	if(map){
+		munmap((void*)map, info.st_size);
+	}
+
+	return rc;
+}
+
+static void run_threads(void* (*function)(void*), void* items, size_t item_size, unsigned long count){
+	pthread_t* threads;
+	unsigned long t;
+	int rc;
+
+	if(count == 1){
+		function(items);
+		return;
+	}
+
+	threads = malloc(count*sizeof(pthread_t));
+	for(t=0; t < count; t++){
+		rc = pthread_create(&threads[t], NULL, function, (char*)items + t*item_size);
+
+		/* problem creating thread */
+		if(rc){
+			printf(ERROR_THREAD_CR, rc);
+			exit(ERROR);
+		}
+	}
+	for(t=0; t < count; t++){
+		rc = pthread_join(threads[t], NULL);
+
+		/* error joining thread */
+		if(rc){
+			printf(ERROR_THREAD_JN, rc);
+			exit(ERROR);
+		}
+	}
+
+	free(threads);
+}
+
+static void trim_regions(group_region* regions, unsigned long thread_count, unsigned long size){
+	unsigned long t, owner, total;
+
+	total = 0;
+	for(t=0; t < thread_count; t++){
+
+		/* a bad line right after the end is not ours to take */
+		if(regions[t].rc == FAIL && total + regions[t].count == size){
+			regions[t].rc = SUCCESS;
+		}
+
+		/* past the end, or the end is in this region */
+		if(total >= size || total + regions[t].count > size){
+			for(owner=0; owner < thread_count; owner++){
+				regions[t].outboxes[owner].size = 0;
+			}
+			regions[t].limit = size - total;
+			if(regions[t].limit > 0){
+				parse_region(&regions[t]);
+			}else{
+				regions[t].count = 0;
+				regions[t].min = HUGE_VAL;
+				regions[t].max = -HUGE_VAL;
+				regions[t].rc = SUCCESS;
+			}
+		}
+
+		total += regions[t].count;
+	}
+}
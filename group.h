@@ -0,0 +1,82 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Group functions bin key value data files into one histogram per key,
+ * all with the same bins.
+ *
+ * Group file format (like a data file, see vector.h):
+ * <number of lines (n)> [<min> <max>]
+ * <key 1> <value 1>
+ * ...
+ * <key n> <value n>
+ * A key is any run of chars without spaces. Like other data files,
+ * lines past the count in the header are ignored.
+ *
+ * Hash partitioning:
+ * The file is mapped and split into one region of lines per thread. A
+ * line belongs to the region its first char is in. Every thread parses
+ * its region into records (key, hash of the key, value) and hands each
+ * record to the thread that owns its key (hash modulo the threads), so
+ * no two threads ever count the same key. Then every thread bins the
+ * records it owns into its own hash table of keys, where the counts of
+ * each key sit in one growing block of counts (so a new key costs no
+ * allocation, and no thread or lock).
+ *
+ * Without a known range (from -r or the header), the min and max of
+ * all the values are found while parsing, before any binning.
+ */
+
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "histogram.h"
+
+/*	TYPES	==========================================================*/
+
+/* the histogram of one key */
+typedef struct{
+	char* key; /* the key ('\0' ended) */
+	unsigned long* counts; /* its bin counts (and rejects, see histogram.h) */
+}group_entry;
+
+/* one histogram per key, with the same bins */
+typedef struct{
+	histogram* graph; /* the bins of every key (its bin_counts are not used) */
+	unsigned long group_count; /* number of keys */
+	group_entry* entries; /* the keys and their counts, in key order */
+	char* key_text; /* where the keys are */
+	unsigned long** blocks; /* where the counts are (one block per thread) */
+	unsigned long block_count; /* number of blocks */
+}group_set;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Deletes the given group set (but not its graph)
+ */
+void delete_group_set(group_set* groups);
+
+/**
+ * Creates an empty group set with the bins of graph
+ */
+group_set* init_group_set(histogram* graph);
+
+/**
+ * Bins up to size lines of file (after the header line) into groups,
+ * with thread_count threads (see top).
+ * If has_range, assumes the bins of groups->graph were already set up
+ * (process_stats_range), otherwise they are set up from the min and
+ * max of the values.
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the file was binned
+ * 	FAIL if a line was not a key and a number
+ * 	ERROR if the file could not be mapped or it had no data
+ * 		(messages will have already been printed out)
+ */
+int process_file_grouped(group_set* groups, FILE* file, unsigned long size, bool has_range, unsigned long thread_count);
+
+#endif
@@ -16,15 +16,41 @@
  * the tree sum process.
  */
 
+#define _DEFAULT_SOURCE /* for rand_r */
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <pthread.h> /* for parallel output */
+#include <unistd.h>
 #include "vector.h"
 #include "histogram.h"
+#include "kernels.h"
+#include "memory.h"
+#include "moments.h"
+#include "output.h"
 #include "parallel_helpers.h"
+#include "quantile.h"
+#include "status.h"
 #include "config.h"
 #include "return_code.h"
 
+/*	TYPES	==========================================================*/
+
+/* one thread's slice of process_stats_auto */
+typedef struct{
+	histogram* graph;
+	unsigned long start; /* first data of the slice */
+	unsigned long end; /* one past the last data of the slice */
+	double min; /* min and max of the slice (double data) */
+	double max;
+	long int_min; /* min and max of the slice (integer data) */
+	long int_max;
+	unsigned long stride; /* data per sketched data (a window) */
+	double* sample; /* the data picked from each window (shared) */
+}stats_slice;
+
 /*	PRIVATE VARIABLE	==============================================*/
 
 /* makes threads joinable */
@@ -33,6 +59,9 @@ static pthread_attr_t join;
 /* false if not verbose, true if we are */
 static bool mode;
 
+/* true if threads pin themselves to cpus (NUMA mode) */
+static bool pin_mode;
+
 /*	PRIVATE FUNCTION PROTOTYPES	======================================*/
 
 /**
@@ -43,6 +72,12 @@ static bool mode;
  */
 static unsigned long binary_find_bin(double data, double* bin_maxes, unsigned long start, unsigned long end);
 
+/**
+ * Bins dictionary data (see vector.h), adding the count of every
+ * distinct value to its bin (or reject counter)
+ */
+static void bin_dictionary(histogram* graph);
+
 /**
  * Calculatse and sets the bin_maxes of the given graph
  * Assumes bin_width is already set
@@ -66,18 +101,41 @@ static void calculate_bin_width(histogram* graph);
  */
 static int find_min_max(histogram* graph);
 
+/**
+ * Finds the min and max of a stats_slice and picks the data of every
+ * window in it (thread function for process_stats_auto)
+ */
+static void* find_slice_stats(void* data);
+
+/**
+ * Replaces the bin_maxes and bin_counts of graph with ones for
+ * bin_count bins
+ */
+static void resize_bins(histogram* graph, unsigned long bin_count);
+
+/**
+ * Sets up the integer bins of graph for integer data from min to max
+ * and sets the min and max of graph to match (exits if one bin would
+ * have to hold all 2^64 integers, more than int_width can count)
+ */
+static void set_integer_range(histogram* graph, long min, long max);
+
 /**
  * Debug method lets us see the bin_cts of a p_graph
  */
 /*static void print_bin_cts(p_histogram* p_graph);*/
 
 /**
- * Transfers the bin counts from p_graph to the graph
+ * Transfers the bin counts (and moments) from p_graph to the graph
  */
 static void transfer_bin_counts(histogram* graph, p_histogram* p_graph);
 
 /*	FUNCTIONS	======================================================*/
 
+unsigned long* alloc_bin_counts(unsigned long bin_count){
+	return alloc_counters(bin_count + REJECT_COUNT);
+}
+
 static unsigned long binary_find_bin(double data, double* bin_maxes, unsigned long start, unsigned long end){
 	if(end-start > 0){
 		unsigned long pivot = (start+end)/2;
@@ -93,13 +151,33 @@ static unsigned long binary_find_bin(double data, double* bin_maxes, unsigned lo
 		}
 		
 		/* we belong to larger bin */
-		else if(data > bin_maxes[pivot]){
+		else if(data >= bin_maxes[pivot]){
 			return binary_find_bin(data, bin_maxes, pivot, end);
 		}
 	}
 	return start;
 }
 
+static void bin_dictionary(histogram* graph){
+	vector* data;
+	unsigned long t, bin;
+	double value;
+	
+	data = graph->data;
+	print_status(H_DC_MSG,data->dictionary_size);
+	
+	for(t=0; t < data->dictionary_size; t++){
+		value = data->dictionary[t];
+		bin = find_bin(value, graph);
+		
+		/* data outside the bins goes to its reject counter */
+		if(bin == graph->bin_count){
+			bin += (value > graph->max)*REJECT_OVERFLOW + (value != value)*REJECT_NAN;
+		}
+		graph->bin_counts[bin] += data->dictionary_counts[t];
+	}
+}
+
 void* bin_data(void* data){
 	p_histogram* p_graph;
 	p_histogram** p_graphs;
@@ -111,6 +189,21 @@ void* bin_data(void* data){
 	
 	p_graph = (p_histogram*) data;
 	
+	/* NUMA mode: stay on the cpu (and node) our data slice was placed on */
+	if(pin_mode){
+		rc = pin_thread(p_graph->thread_id);
+		
+		/* verbose mode */
+		if(mode){
+			printf(THREAD_PN_MSG, p_graph->thread_id, rc == SUCCESS ? THREAD_PN_OK : THREAD_PN_FAIL);
+		}
+	}
+	
+	/* allocate the local bin counts here, so they are first touched
+	 * (and placed) by the thread that uses them
+	 */
+	p_graph->loc_bin_counts = alloc_bin_counts(p_graph->graph->bin_count);
+	
 	/* edge threads require a smaller divisor than p_graphs divisor */
 	if(p_graph->is_edge){
 		divisor = find_larger_power_of_two(p_graph->thread_count - p_graph->thread_id);
@@ -146,6 +239,8 @@ void* bin_data(void* data){
 			/* create the p_histogram for the thread to spawn */
 			p_graphs[index] = init_p_histogram(p_graph->graph, t, p_graph->thread_count);
 			p_graphs[index]->divisor = divisor/2;
+			p_graphs[index]->cursor = p_graph->cursor;
+			p_graphs[index]->chunk_size = p_graph->chunk_size;
 			
 			/* The first thread spawned from an edge thread is also an edge thread */
 			if(p_graph->is_edge && index == 0){
@@ -208,21 +303,35 @@ void* bin_data(void* data){
 }
 
 void bin_data_values(p_histogram* p_graph){
-	unsigned long start_index, end_index, t, bin;
+	unsigned long start_index, end_index;
+	vector* data;
+	moments* stats;
+	
+	data = p_graph->graph->data;
+	stats = p_graph->graph->stats ? &p_graph->loc_stats : NULL;
+	
+	/* dynamic mode: keep taking chunks until the data runs out */
+	if(p_graph->chunk_size > 0){
+		while(claim_chunk(p_graph->cursor, p_graph->chunk_size, data->size, &start_index, &end_index)){
+			if(data->integers){
+				count_bins_integers(p_graph->graph, data->integers + start_index, end_index - start_index, p_graph->loc_bin_counts);
+			}else{
+				count_bins_moments(p_graph->graph, data->array + start_index, end_index - start_index, p_graph->loc_bin_counts, stats);
+			}
+		}
+		return;
+	}
 	
 	/* assign data range for this thread */
-	start_index = calculate_start_index(p_graph->thread_id, p_graph->thread_count, p_graph->graph->data->size);
-	end_index = calculate_end_index(p_graph->thread_id, p_graph->thread_count, p_graph->graph->data->size);
+	start_index = calculate_start_index(p_graph->thread_id, p_graph->thread_count, data->size);
+	end_index = calculate_end_index(p_graph->thread_id, p_graph->thread_count, data->size);
 	
 	/*printf("Thread %lu = %lu:%lu\n",p_graph->thread_id,start_index,end_index);*/
 	
-	for(t=start_index; t <= end_index; t++){
-		
-		/* find bin for this data */
-		bin = find_bin(p_graph->graph->data->array[t],p_graph->graph);
-		
-		/* increment the local bin counts */
-		p_graph->loc_bin_counts[bin] += 1;
+	if(data->integers){
+		count_bins_integers(p_graph->graph, data->integers + start_index, end_index - start_index + 1, p_graph->loc_bin_counts);
+	}else{
+		count_bins_moments(p_graph->graph, data->array + start_index, end_index - start_index + 1, p_graph->loc_bin_counts, stats);
 	}
 }
 
@@ -230,7 +339,7 @@ static void calculate_bin_maxes(histogram* graph){
 	unsigned long t;
 	
 	/* display status message */
-	printf(H_BM_MSG);
+	print_status(H_BM_MSG);
 	
 	for(t=0; t < graph->bin_count; t++){
 		
@@ -245,20 +354,59 @@ static void calculate_bin_width(histogram* graph){
 	graph->bin_width = (graph->max - graph->min)/graph->bin_count;
 }
 
+void count_bins(histogram* graph, double* values, unsigned long count, unsigned long* counts){
+	unsigned long t, bin;
+	
+	/* very few or very many bins have their own kernels */
+	if(count_bins_small(graph, values, count, counts) == SUCCESS
+		|| count_bins_partitioned(graph, values, count, counts) == SUCCESS){
+		return;
+	}
+	
+	for(t=0; t < count; t++){
+		
+		/* find bin for this data */
+		bin = find_bin(values[t], graph);
+		
+		/* data outside the bins goes to its reject counter */
+		if(bin == graph->bin_count){
+			bin += (values[t] > graph->max)*REJECT_OVERFLOW + (values[t] != values[t])*REJECT_NAN;
+		}
+		counts[bin] += 1;
+	}
+}
+
+void count_bins_moments(histogram* graph, double* values, unsigned long count, unsigned long* counts, moments* stats){
+	unsigned long start, size;
+	
+	if(!stats){
+		count_bins(graph, values, count, counts);
+		return;
+	}
+	
+	/* the moments read each block right after it was binned */
+	for(start=0; start < count; start += size){
+		size = (count - start > MOMENTS_BLOCK) ? MOMENTS_BLOCK : count - start;
+		count_bins(graph, values + start, size, counts);
+		add_moments(stats, values + start, size);
+	}
+}
+
 void delete_histogram(histogram* gram){
 	if(gram){
 		if(gram->bin_maxes){
-			free(gram->bin_maxes);
+			free_block(gram->bin_maxes);
 		}
 		
 		if(gram->bin_counts){
-			free(gram->bin_counts);
+			free_block(gram->bin_counts);
 		}
 		
 		if(gram->data){
 			delete_vector(gram->data);
 		}
 		
+		free(gram->stats);
 		free(gram);
 	}
 }
@@ -275,7 +423,7 @@ void delete_p_histogram(p_histogram* p_graph){
 		}*/
 		
 		if(p_graph->loc_bin_counts){
-			free(p_graph->loc_bin_counts);
+			free_block(p_graph->loc_bin_counts);
 		}
 		
 		free(p_graph);
@@ -298,8 +446,8 @@ void delete_p_histogram_list(p_histogram** p_graphs, int size){
 unsigned long find_bin(double data, histogram* graph){
 	/*unsigned long t;*/
 	
-	/* if the data is less than min or greater than max, throw it out */
-	if(data < graph->min || data > graph->max){
+	/* if the data is less than min or greater than max (or NaN), throw it out */
+	if(!(data >= graph->min && data <= graph->max)){
 		return graph->bin_count;
 	}
 	
@@ -329,10 +477,12 @@ unsigned long find_bin(double data, histogram* graph){
 
 static int find_min_max(histogram* graph){
 	double min, max;
-	unsigned long t;
+	double* values;
+	long int_min, int_max;
+	unsigned long t, count;
 	
 	/* print status message */
-	printf(H_MM_MSG);
+	print_status(H_MM_MSG);
 	
 	/* if the data doesnt exist */
 	if(!graph->data){
@@ -344,20 +494,53 @@ static int find_min_max(histogram* graph){
 		return FAIL;
 	}
 	
-	/* set min and max to first data */
-	min = graph->data->array[0];
-	max = graph->data->array[0];
+	/* integer data gets integer bins */
+	if(graph->data->integers){
+		int_min = graph->data->integers[0];
+		int_max = graph->data->integers[0];
+		for(t=1; t < graph->data->size; t++){
+			if(graph->data->integers[t] < int_min){
+				int_min = graph->data->integers[t];
+			}
+			if(graph->data->integers[t] > int_max){
+				int_max = graph->data->integers[t];
+			}
+		}
+		
+		set_integer_range(graph, int_min, int_max);
+		return SUCCESS;
+	}
+	
+	/* the data already knows its range (like from a column file footer) */
+	if(graph->data->has_range){
+		graph->min = graph->data->min;
+		graph->max = graph->data->max;
+		return SUCCESS;
+	}
 	
-	/* find the min and max of the data */
-	for(t=1; t < graph->data->size; t++){
-		if(graph->data->array[t] < min){
-			min = graph->data->array[t];
+	/* dictionary data only has to look at its distinct values */
+	values = graph->data->dictionary ? graph->data->dictionary : graph->data->array;
+	count = graph->data->dictionary ? graph->data->dictionary_size : graph->data->size;
+	
+	/* find the min and max of the data (NaNs never compare, so they
+	 * are skipped, they are counted on their own) */
+	min = INFINITY;
+	max = -INFINITY;
+	for(t=0; t < count; t++){
+		if(values[t] < min){
+			min = values[t];
 		}
-		if(graph->data->array[t] > max){
-			max = graph->data->array[t];
+		if(values[t] > max){
+			max = values[t];
 		}
 	}
 	
+	/* only NaNs */
+	if(min > max){
+		min = 0;
+		max = 0;
+	}
+	
 	/*graph->min = (unsigned long)min;
 	graph->max = (unsigned long)(max+1);*/
 	
@@ -369,22 +552,84 @@ static int find_min_max(histogram* graph){
 	return SUCCESS;
 }
 
+static void* find_slice_stats(void* data){
+	stats_slice* slice;
+	vector* values;
+	unsigned long t, window, mix, size;
+	
+	slice = (stats_slice*)data;
+	values = slice->graph->data;
+	size = values->size;
+	
+	/* integer data has integer min and max */
+	if(values->integers){
+		slice->int_min = values->integers[slice->start];
+		slice->int_max = values->integers[slice->start];
+		for(t=slice->start; t < slice->end; t++){
+			if(values->integers[t] < slice->int_min){
+				slice->int_min = values->integers[t];
+			}
+			if(values->integers[t] > slice->int_max){
+				slice->int_max = values->integers[t];
+			}
+		}
+	}else{
+		
+		/* NaNs never compare, so they are skipped (a slice of only
+		 * NaNs keeps min above max) */
+		slice->min = INFINITY;
+		slice->max = -INFINITY;
+		for(t=slice->start; t < slice->end; t++){
+			if(values->array[t] < slice->min){
+				slice->min = values->array[t];
+			}
+			if(values->array[t] > slice->max){
+				slice->max = values->array[t];
+			}
+		}
+	}
+	
+	/* one data from anywhere in each window is picked (refer to top),
+	 * by a hash of the window, so the picks do not depend on how the
+	 * data is sliced. A window can straddle slices, the slice holding
+	 * its pick fills it in. */
+	for(window=slice->start/slice->stride; window*slice->stride < slice->end; window++){
+		mix = (window + 1)*0x9E3779B97F4A7C15UL;
+		mix = (mix ^ (mix >> 30))*0xBF58476D1CE4E5B9UL;
+		mix = (mix ^ (mix >> 27))*0x94D049BB133111EBUL;
+		mix ^= mix >> 31;
+		
+		t = window*slice->stride + mix % slice->stride;
+		if(t >= size){
+			t = size - 1;
+		}
+		if(t >= slice->start && t < slice->end){
+			slice->sample[window] = values->integers ? (double)values->integers[t] : values->array[t];
+		}
+	}
+	return NULL;
+}
+
 histogram* init_histogram(unsigned long size){
 	histogram* graph;
 	unsigned long t;
 	
 	graph = malloc(sizeof(histogram));
-	graph->bin_maxes = malloc(size*sizeof(double));
-	graph->bin_counts = malloc(size*sizeof(unsigned long));
+	graph->bin_maxes = alloc_block(size*sizeof(double));
+	graph->bin_counts = alloc_bin_counts(size);
 	graph->bin_count = size;
 	graph->min = 0;
 	graph->max = 0;
 	graph->bin_width = 0;
+	graph->data = NULL;
+	graph->int_min = 0;
+	graph->int_width = 0;
+	graph->stats = NULL;
+	graph->sample_fraction = 0;
 	
-	/* initalize bin datas to 0 */
+	/* initalize bin datas to 0 (bin_counts already are) */
 	for(t=0; t < size; t++){
 		graph->bin_maxes[t] = 0;
-		graph->bin_counts[t] = 0;
 	}
 	
 	return graph;
@@ -392,20 +637,19 @@ histogram* init_histogram(unsigned long size){
 
 p_histogram* init_p_histogram(histogram* graph, unsigned long thread_id, unsigned long thread_count){
 	p_histogram* p_graph;
-	unsigned long t;
 	
 	p_graph = malloc(sizeof(p_histogram));
-	p_graph->loc_bin_counts = malloc(graph->bin_count*sizeof(unsigned long));
 	p_graph->graph = graph;
 	p_graph->thread_id = thread_id;
 	p_graph->thread_count = thread_count;
 	p_graph->divisor = 0;
 	p_graph->is_edge = false;
+	p_graph->cursor = NULL;
+	p_graph->chunk_size = 0;
+	memset(&p_graph->loc_stats, 0, sizeof(moments));
 	
-	/* initialize bin data to 0 */
-	for(t=0; t < graph->bin_count; t++){
-		p_graph->loc_bin_counts[t] = 0;
-	}
+	/* the thread running bin_data allocates these */
+	p_graph->loc_bin_counts = NULL;
 	
 	return p_graph;
 }
@@ -424,30 +668,42 @@ static void print_bin_cts(p_histogram* p_graph){
 }*/
 
 void print_bins(histogram* graph){
-	unsigned long t;
 	
-	/* print bin header */
-	printf(BINS_MESSAGE,BINS_MSG_BIN,BINS_MSG_COT,BINS_MSG_MAX);
-	
-	for(t=0; t < graph->bin_count; t++){
-		
-		/* print bin number, bin count, and bin upper bound */
-		printf(BINS_DATA_MSG,t,graph->bin_counts[t],graph->bin_maxes[t]);
-	}
+	/* print bin header, then bin number, bin count, and bin upper bound */
+	write_histogram(graph, FORMAT_TEXT, STDOUT_FILENO, 1);
 }
 
-int process_data_parallel(histogram* graph, unsigned long thread_count, bool verb_mode){
+int process_data_parallel(histogram* graph, unsigned long thread_count, bool verb_mode, bool numa_mode, unsigned long chunk_size){
 	pthread_t* threads;
 	p_histogram** p_data;
+	unsigned long* cursor;
 	int rc,t,second_thread_base;
 	void* status;
 	
+	/* moments need the plain values, otherwise dictionary data is
+	 * binned once per distinct value (no threads needed) */
+	if(graph->stats){
+		decode_vector_dictionary(graph->data);
+	}else if(graph->data->dictionary){
+		bin_dictionary(graph);
+		return SUCCESS;
+	}
+	
 	/* print status message */
-	printf(H_BD_MSG,METH_PAR);
+	print_status(H_BD_MSG,METH_PAR);
 	
 	threads = malloc(BASE_THD*sizeof(pthread_t));
 	p_data = malloc(BASE_THD*sizeof(p_histogram*));
 	mode = verb_mode;
+	pin_mode = numa_mode;
+	
+	/* the shared chunk cursor gets a cache line to itself */
+	cursor = alloc_counters(1);
+	
+	/* a chunk never needs to be bigger than the data */
+	if(chunk_size > graph->data->size){
+		chunk_size = graph->data->size;
+	}
 	
 	/* we use this value to create the second thread, which should
 	 * always be a power of two. This helps us out in the tree sum
@@ -464,6 +720,8 @@ int process_data_parallel(histogram* graph, unsigned long thread_count, bool ver
 	for(t=0; t < BASE_THD; t++){
 		p_data[t] = init_p_histogram(graph,t,thread_count);
 		p_data[t]->divisor = second_thread_base;
+		p_data[t]->cursor = cursor;
+		p_data[t]->chunk_size = chunk_size;
 	}
 	
 	/* the second thread is the edge thread */
@@ -514,29 +772,33 @@ int process_data_parallel(histogram* graph, unsigned long thread_count, bool ver
 	pthread_attr_destroy(&join);
 	delete_p_histogram_list(p_data,BASE_THD);
 	free(threads);
+	free_block(cursor);
 	
 	return SUCCESS;
 }
 
 void process_data_serial(histogram* graph){
-	unsigned long t, bin;
+	
+	/* moments need the plain values, otherwise dictionary data is
+	 * binned once per distinct value */
+	if(graph->stats){
+		decode_vector_dictionary(graph->data);
+	}else if(graph->data->dictionary){
+		bin_dictionary(graph);
+		return;
+	}
 	
 	/* print status message */
-	printf(H_BD_MSG,METH_SER);
+	print_status(H_BD_MSG,METH_SER);
 	
-	/* find the bins for this data */
-	for(t=0; t < graph->data->size; t++){
-		bin = find_bin(graph->data->array[t], graph);
-		
-		/*printf("%lu\n", bin);*/
-		
-		/* this part really wont happen ever */
-		if(bin == graph->bin_count){
-			printf("Bad data at index %lu\n", bin);
-		}else{
-			graph->bin_counts[bin] += 1;
-		}
+	/* integer data has its own kernel */
+	if(graph->data->integers){
+		count_bins_integers(graph, graph->data->integers, graph->data->size, graph->bin_counts);
+		return;
 	}
+	
+	/* find the bins for this data (data outside them is counted apart) */
+	count_bins_moments(graph, graph->data->array, graph->data->size, graph->bin_counts, graph->stats);
 }
 
 int process_stats(histogram* graph){
@@ -557,6 +819,206 @@ int process_stats(histogram* graph){
 	return SUCCESS;
 }
 
+int process_stats_auto(histogram* graph, unsigned long thread_count, bool keep_range){
+	pthread_t* threads;
+	stats_slice* slices;
+	quantile_sketch* qs;
+	unsigned long t, size, bin_count, stride, window_count;
+	double iqr, width, bins;
+	double* sample;
+	int rc;
+	
+	/* print status message */
+	print_status(H_MM_MSG);
+	
+	/* if the data doesnt exist */
+	if(!graph->data){
+		return ERROR;
+	}
+	
+	/* size of data is 0 */
+	size = graph->data->size;
+	if(size < 1){
+		return FAIL;
+	}
+	
+	/* the quartiles are sketched from the plain values */
+	decode_vector_dictionary(graph->data);
+	
+	/* every thread gets at least one data */
+	if(thread_count < 1){
+		thread_count = 1;
+	}else if(thread_count > size){
+		thread_count = size;
+	}
+	
+	/* one pick per window, filled in by the slices */
+	stride = (size + QUANTILE_SAMPLE_SIZE - 1)/QUANTILE_SAMPLE_SIZE;
+	window_count = (size + stride - 1)/stride;
+	sample = alloc_block(window_count*sizeof(double));
+	
+	slices = malloc(thread_count*sizeof(stats_slice));
+	threads = malloc(thread_count*sizeof(pthread_t));
+	for(t=0; t < thread_count; t++){
+		slices[t].graph = graph;
+		slices[t].start = calculate_start_index(t, thread_count, size);
+		slices[t].end = calculate_end_index(t, thread_count, size) + 1;
+		slices[t].stride = stride;
+		slices[t].sample = sample;
+	}
+	
+	/* this thread does the first slice */
+	for(t=1; t < thread_count; t++){
+		rc = pthread_create(&threads[t], NULL, find_slice_stats, (void*)&slices[t]);
+		
+		/* problem creating thread */
+		if(rc){
+			printf(ERROR_THREAD_CR, rc);
+			exit(ERROR);
+		}
+	}
+	find_slice_stats((void*)&slices[0]);
+	
+	/* merge the range of every slice into the first (only the pair
+	 * for the type of data was found) */
+	for(t=1; t < thread_count; t++){
+		rc = pthread_join(threads[t], NULL);
+		
+		/* error joining thread */
+		if(rc){
+			printf(ERROR_THREAD_JN, rc);
+			exit(ERROR);
+		}
+		
+		if(graph->data->integers){
+			if(slices[t].int_min < slices[0].int_min){
+				slices[0].int_min = slices[t].int_min;
+			}
+			if(slices[t].int_max > slices[0].int_max){
+				slices[0].int_max = slices[t].int_max;
+			}
+		}else{
+			if(slices[t].min < slices[0].min){
+				slices[0].min = slices[t].min;
+			}
+			if(slices[t].max > slices[0].max){
+				slices[0].max = slices[t].max;
+			}
+		}
+	}
+	
+	/* the picks are sketched in window order, the same for any number
+	 * of threads (NaNs are left out of the quartiles) */
+	qs = init_quantile_sketch(1);
+	for(t=0; t < window_count; t++){
+		if(!isnan(sample[t])){
+			add_quantile_value(qs, sample[t]);
+		}
+	}
+	free_block(sample);
+	
+	/* the range of the data, unless one was given */
+	if(!keep_range){
+		if(graph->data->integers){
+			graph->min = (double)slices[0].int_min;
+			graph->max = (double)slices[0].int_max;
+		}else if(slices[0].min <= slices[0].max){
+			graph->min = slices[0].min;
+			graph->max = slices[0].max;
+		}else{
+			
+			/* only NaNs */
+			graph->min = 0;
+			graph->max = 0;
+		}
+	}
+	
+	/* Freedman-Diaconis bin width (integer bins hold whole integers) */
+	iqr = find_quantile(qs, 0.75) - find_quantile(qs, 0.25);
+	width = 2*iqr/cbrt((double)size);
+	if(graph->data->integers){
+		width = (width < 1) ? 1 : ceil(width);
+		bins = ceil((floor(graph->max) - floor(graph->min) + 1)/width);
+	}else if(width > 0 && graph->max > graph->min){
+		bins = ceil((graph->max - graph->min)/width);
+	}else if(graph->max > graph->min){
+		
+		/* no spread in the middle of the data, Sturges rule instead */
+		bins = ceil(log2((double)size)) + 1;
+	}else{
+		bins = 1;
+	}
+	bin_count = (unsigned long)fmax(1, fmin(bins, AUTO_MAX_BINS));
+	
+	print_status(H_AB_MSG, bin_count, iqr);
+	resize_bins(graph, bin_count);
+	
+	delete_quantile_sketch(qs);
+	free(slices);
+	free(threads);
+	
+	/* integer data gets integer bins */
+	if(graph->data->integers){
+		set_integer_range(graph, (long)floor(graph->min), (long)floor(graph->max));
+	}
+	
+	/* calculate the bin width and upper bounds */
+	calculate_bin_width(graph);
+	calculate_bin_maxes(graph);
+	
+	return SUCCESS;
+}
+
+int process_stats_range(histogram* graph, double min, double max){
+	
+	/* a backwards (or NaN) range */
+	if(!(min <= max)){
+		return FAIL;
+	}
+	
+	/* integer data gets integer bins (the range is cut to integers) */
+	if(graph->data && graph->data->integers){
+		set_integer_range(graph, (long)floor(min), (long)floor(max));
+	}else{
+		graph->min = min;
+		graph->max = max;
+	}
+	
+	/* calculate the bin width and upper bounds */
+	calculate_bin_width(graph);
+	calculate_bin_maxes(graph);
+	
+	return SUCCESS;
+}
+
+static void resize_bins(histogram* graph, unsigned long bin_count){
+	free_block(graph->bin_maxes);
+	free_block(graph->bin_counts);
+	
+	graph->bin_maxes = alloc_block(bin_count*sizeof(double));
+	graph->bin_counts = alloc_bin_counts(bin_count);
+	graph->bin_count = bin_count;
+}
+
+static void set_integer_range(histogram* graph, long min, long max){
+	
+	unsigned long span;
+	
+	/* the fewest integers per bin that still covers min to max, which
+	 * only wraps for the whole range of longs in a single bin */
+	span = (unsigned long)max - (unsigned long)min;
+	if(span/graph->bin_count == ~0UL){
+		printf(ERROR_INTEGER_WIDTH, min, max, graph->bin_count);
+		exit(ERROR);
+	}
+	graph->int_min = min;
+	graph->int_width = span/graph->bin_count + 1;
+	
+	/* max is rounded up so every bin holds int_width integers */
+	graph->min = (double)min;
+	graph->max = (double)min + (double)graph->int_width*graph->bin_count;
+}
+
 void sum_bin_counts(p_histogram* p_graph_receive, p_histogram* p_graph_send){
 	unsigned long t;
 	
@@ -564,16 +1026,20 @@ void sum_bin_counts(p_histogram* p_graph_receive, p_histogram* p_graph_send){
 	print_bin_cts(p_graph_send);*/
 	
 	/* sum the bin counts and set them to the receiving p_histogram */
-	for(t=0; t < p_graph_receive->graph->bin_count; t++){
+	for(t=0; t < p_graph_receive->graph->bin_count + REJECT_COUNT; t++){
 		p_graph_receive->loc_bin_counts[t] += p_graph_send->loc_bin_counts[t];
 	}
+	merge_moments(&p_graph_receive->loc_stats, &p_graph_send->loc_stats);
 }
 
 static void transfer_bin_counts(histogram* graph, p_histogram* p_graph){
 	unsigned long t;
 	
 	/* set the histogram bins to the p_histogram bins */
-	for(t=0; t < graph->bin_count; t++){
+	for(t=0; t < graph->bin_count + REJECT_COUNT; t++){
 		graph->bin_counts[t] = p_graph->loc_bin_counts[t];
 	}
+	if(graph->stats){
+		*graph->stats = p_graph->loc_stats;
+	}
 }
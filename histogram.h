@@ -14,16 +14,68 @@
  * completely as expected. This is circumvented through the is_edge
  * property, which calculates the divisor in a different way during
  * the tree sum process.
+ * 
+ * Dynamic mode:
+ * With a chunk_size, threads do not bin one fixed slice each. They
+ * all take chunk_size pieces of the data from a shared cursor until it
+ * runs out, so faster (or less busy) cores simply bin more chunks.
+ * Local bin counts are still tree summed at the end.
+ * 
+ * Integer data:
+ * When the data vector holds integers, every bin holds the same whole
+ * number of integers (int_width), so max is rounded up to
+ * min + bin_count*int_width and bins are found with exact integer
+ * arithmetic instead of comparing against bin_maxes.
+ * 
+ * Rejected data:
+ * Every counts array (bin_counts, loc_bin_counts, and the counts given
+ * to count_bins) has REJECT_COUNT more counters after its bins, where
+ * data below the min, above the max, and NaNs are counted (see
+ * REJECT_KIND), so dirty data is counted exactly instead of dropped.
+ * Use alloc_bin_counts to allocate them.
+ * 
+ * Moments:
+ * When graph->stats is set, every binning path also keeps the moments
+ * of the data (see moments.h) with count_bins_moments, each thread in
+ * its own loc_stats, merged in sum_bin_counts like the counts.
+ * 
+ * Automatic bins:
+ * process_stats_auto picks the bin count itself with the
+ * Freedman-Diaconis rule (bins 2*IQR/cbrt(n) wide). Each thread finds
+ * the min and max of its slice, and in that same pass picks the data
+ * for the quartiles, so picking the bins costs one pass over the data
+ * before binning it. Past QUANTILE_SAMPLE_SIZE data, only one data from
+ * anywhere in each window of n/QUANTILE_SAMPLE_SIZE is picked (like the
+ * sampler at the bottom of a KLL sketch), which only adds about 0.05%
+ * of n to the rank error of the quartiles. Where in its window a data
+ * is picked comes from a hash of the window number, and the picks are
+ * sketched (see quantile.h) in window order afterwards, so the bins
+ * picked are the same for any number of threads.
+ * 
+ * Dictionary data:
+ * Dictionary data (see vector.h) is binned with one find_bin per
+ * distinct value, adding how many times it was seen, and its min and
+ * max come from the distinct values, so neither looks at every data.
+ * Paths that do need every data (moments, automatic bins) decode it.
  */
  
 #ifndef HISTOGRAM_H
 #define HISTOGRAM_H
 
 #include <stdbool.h>
+#include "moments.h"
 #include "vector.h"
 
 /*	TYPES	==========================================================*/
 
+/* where data outside the bins is counted, after the bins (refer to top) */
+typedef enum{
+	REJECT_UNDERFLOW = 0, /* less than the min */
+	REJECT_OVERFLOW = 1, /* more than the max */
+	REJECT_NAN = 2, /* not a number */
+	REJECT_COUNT = 3 /* number of reject counters */
+}REJECT_KIND;
+
 /* Basic histogram */
 typedef struct{
 	unsigned long bin_count; /* number of bins */
@@ -33,8 +85,12 @@ typedef struct{
 	double max; /* the max value in the data */
 	double bin_width; /* the width of a bin */
 	double* bin_maxes; /* array of the upper bounds of bins */
-	unsigned long* bin_counts; /* array of the number of data in each bin */
+	unsigned long* bin_counts; /* array of the number of data in each bin (and rejects) */
 	vector* data; /* The data that is/will be binned */
+	long int_min; /* integer data: the min as an integer */
+	unsigned long int_width; /* integer data: integers in each bin */
+	moments* stats; /* moments of the binned data if asked for, otherwise NULL (refer to top) */
+	double sample_fraction; /* the fraction of the data binned if sampled, otherwise 0 (see sample.h) */
 }histogram;
 
 /* a modified histogram for parallel usage */
@@ -45,10 +101,19 @@ typedef struct{
 	unsigned long thread_count;
 	unsigned long divisor; /* divisor, used for tree sum */
 	bool is_edge; /* edge threads have special spawn properties, refer to top */
+	unsigned long* cursor; /* next data index to claim (shared, dynamic mode) */
+	unsigned long chunk_size; /* data per claim, 0 for fixed slices */
+	moments loc_stats; /* local moments for this thread (if graph->stats) */
 }p_histogram;
 
 /*	FUNCTIONS	======================================================*/
 
+/**
+ * Allocates zeroed counts for bin_count bins and the reject counters
+ * after them (refer to top)
+ */
+unsigned long* alloc_bin_counts(unsigned long bin_count);
+
 /**
  * Parallelized data binning
  */
@@ -61,7 +126,22 @@ void* bin_data(void* data);
 void bin_data_values(p_histogram* p_graph);
 
 /**
- * Deletes the given histogram
+ * Adds the bins of count values to the given counts array
+ * (bin_count long, plus the reject counters). Values outside of the
+ * bins are counted in the reject counters (refer to top).
+ * Assumes bin_maxes and min and max stuff has already been done
+ */
+void count_bins(histogram* graph, double* values, unsigned long count, unsigned long* counts);
+
+/**
+ * Like count_bins, and also adds the values to stats (unless it is
+ * NULL), MOMENTS_BLOCK values at a time so each block is still in cache
+ * for the moments after it is binned
+ */
+void count_bins_moments(histogram* graph, double* values, unsigned long count, unsigned long* counts, moments* stats);
+
+/**
+ * Deletes the given histogram (and its stats)
  */
 void delete_histogram(histogram* gram);
 
@@ -80,7 +160,7 @@ void delete_p_histogram_list(p_histogram** p_graphs, int size);
  * finds the bin index where the given data belongs
  * 
  * @returns the index of the bin data belongs to
- * 	OR the bin_count if the data does not belong to any bin.
+ * 	OR the bin_count if the data does not belong to any bin (or is NaN).
  */
 unsigned long find_bin(double data, histogram* graph);
 
@@ -93,6 +173,8 @@ histogram* init_histogram(unsigned long size);
 /**
  * Creates a p_histogram struct with the given histogram and thread_id and thread_count
  * Assumes histogram data has already been initalized
+ * loc_bin_counts are left NULL, bin_data allocates them in the thread
+ * that uses them so they are placed on that thread's NUMA node
  */
 p_histogram* init_p_histogram(histogram* graph, unsigned long thread_id, unsigned long thread_count);
 
@@ -106,9 +188,15 @@ void print_bins(histogram* graph);
  * counts the data in graph according to bin in parallel
  * Assumes bin_maxes and min and max stuff has already been done
  * 
+ * In numa_mode, each thread pins itself to a cpu (see pin_thread)
+ * so it bins the slice that was placed for it by init_vector_parallel
+ * 
+ * With a chunk_size more than 0, threads take chunks dynamically
+ * (refer to top) instead of binning fixed slices
+ * 
  * @returns return codes from p_thread (messages will have already been printed out)
  */
-int process_data_parallel(histogram* graph, unsigned long thread_count, bool verb_mode);
+int process_data_parallel(histogram* graph, unsigned long thread_count, bool verb_mode, bool numa_mode, unsigned long chunk_size);
 
 /**
  * counts the data in graph according to bin seriall.
@@ -127,8 +215,33 @@ void process_data_serial(histogram* graph);
 int process_stats(histogram* graph);
 
 /**
- * Sums the loc_bin_cts between the given p_histograms and
- * sets the sums to p_graph_receive
+ * Like process_stats, but also picks the bin count (refer to top),
+ * replacing the bin_count, bin_maxes and bin_counts of the given graph.
+ * With keep_range, the min and max already set to the graph (like from
+ * -r) are kept instead of the min and max of the data.
+ * Uses thread_count threads (1 is serial).
+ * 
+ * USES RETURN_CODE
+ * @return SUCCESS if the vector of data has been processed successfully
+ * 	FAIL if the data vector is size 0
+ * 	ERROR if the vector of data has not been set yet
+ */
+int process_stats_auto(histogram* graph, unsigned long thread_count, bool keep_range);
+
+/**
+ * Sets the min, max, bin_width, and bin_maxes of the given graph from
+ * a known range, without looking at the data
+ * 
+ * USES RETURN_CODE
+ * @return SUCCESS if the range was set
+ * 	FAIL if min is more than max (or either is NaN)
+ */
+int process_stats_range(histogram* graph, double min, double max);
+
+/**
+ * Sums the loc_bin_cts (and reject counters) between the given
+ * p_histograms and sets the sums to p_graph_receive, merging their
+ * loc_stats too
  */
 void sum_bin_counts(p_histogram* p_graph_receive, p_histogram* p_graph_send);
 
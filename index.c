@@ -0,0 +1,473 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Index functions keep a data file sorted
+ *
+ * NaNs are sorted with the rest: their keys are below the key of -inf
+ * (negative NaNs) or above the key of +inf, so they end up at the ends
+ * of the sorted keys, where they are counted and cut off.
+ *
+ * Index file layout (native byte order):
+ * <magic "HIDX"> <uint32 version> <uint64 count> <uint64 nan_count>
+ * <double min> <double max>
+ * <file_stamp of the data file (uint64 size, int64 mtime sec, int64 nsec)>
+ * <double values[count]> (in order)
+ */
+
+#define _DEFAULT_SOURCE /* for madvise */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "histogram.h"
+#include "index.h"
+#include "memory.h"
+#include "parallel_helpers.h"
+#include "reader.h"
+#include "vector.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* header of an index file */
+typedef struct{
+	char magic[4]; /* always INDEX_MAGIC */
+	unsigned int version; /* INDEX_VERSION */
+	unsigned long count;
+	unsigned long nan_count;
+	double min;
+	double max;
+	file_stamp data_stamp; /* the data file the index was made from */
+}index_header;
+
+/* the keys one thread sorts in a pass */
+typedef struct{
+	double* values; /* the data (turned into keys, or out of them) */
+	unsigned long* from; /* the keys before the pass */
+	unsigned long* to; /* the keys after the pass */
+	unsigned long start; /* first index of the slice */
+	unsigned long end; /* one past the last index of the slice */
+	unsigned long shift; /* the digit of this pass */
+	unsigned long counts[INDEX_RADIX]; /* counts of each digit, then where they go */
+}sort_slice;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * @returns the first index from start to end-1 with a value of at
+ * 	least value (end if there is none), assuming the values are in order
+ */
+static unsigned long count_below(double* values, unsigned long start, unsigned long end, double value);
+
+/**
+ * Counts the digits of the keys of a sort_slice (thread function)
+ */
+static void* count_digits(void* data);
+
+/**
+ * @returns the first index from start to end-1 with a value more
+ * 	than value (end if there is none), assuming the values are in order
+ */
+static unsigned long count_not_above(double* values, unsigned long start, unsigned long end, double value);
+
+/**
+ * @returns the double of the given key (refer to to_key)
+ */
+static inline double from_key(unsigned long key);
+
+/**
+ * Turns the values of a sort_slice into keys (thread function)
+ */
+static void* make_keys(void* data);
+
+/**
+ * Turns the keys of a sort_slice back into values, in place
+ * (thread function)
+ */
+static void* make_values(void* data);
+
+/**
+ * Runs the given function on every slice, with one thread per slice
+ * (or on this thread, for one slice)
+ */
+static void run_slices(sort_slice* slices, unsigned long thread_count, void* (*function)(void*));
+
+/**
+ * Moves the keys of a sort_slice to where their digits go
+ * (thread function)
+ */
+static void* scatter_keys(void* data);
+
+/**
+ * Sorts the keys of size values with thread_count threads (refer to
+ * top of index.h)
+ *
+ * @returns the sorted values (a block of size values, where the keys
+ * 	were sorted)
+ */
+static unsigned long* sort_keys(double* values, unsigned long size, unsigned long thread_count);
+
+/**
+ * @returns the unsigned key of the given double, in the same order as
+ * 	the doubles (negatives flipped)
+ */
+static inline unsigned long to_key(double value);
+
+/*	FUNCTIONS	======================================================*/
+
+void bin_index(sorted_index* idx, histogram* graph){
+	unsigned long t, below, last, position, upper;
+	double edge;
+
+	/* values below a bin's upper bound, less the ones below its lower
+	 * bound (the max goes in the last bin, like find_bin) */
+	below = count_below(idx->values, 0, idx->count, graph->min);
+	last = below;
+	for(t=0; t+1 < graph->bin_count; t++){
+		edge = (graph->bin_maxes[t] < graph->max) ? graph->bin_maxes[t] : graph->max;
+		position = count_below(idx->values, last, idx->count, edge);
+		graph->bin_counts[t] = position - last;
+		last = position;
+	}
+	upper = count_not_above(idx->values, last, idx->count, graph->max);
+	graph->bin_counts[graph->bin_count-1] = upper - last;
+
+	graph->bin_counts[graph->bin_count + REJECT_UNDERFLOW] = below;
+	graph->bin_counts[graph->bin_count + REJECT_OVERFLOW] = idx->count - upper;
+	graph->bin_counts[graph->bin_count + REJECT_NAN] = idx->nan_count;
+}
+
+sorted_index* build_index(vector* data, unsigned long thread_count){
+	sorted_index* idx;
+	double* sorted;
+	unsigned long low, high;
+
+	/* the sort needs the plain values */
+	decode_vector_dictionary(data);
+	sorted = (double*)sort_keys(data->array, data->size, thread_count);
+
+	/* cut the NaNs off both ends */
+	low = 0;
+	while(low < data->size && isnan(sorted[low])){
+		low += 1;
+	}
+	high = data->size;
+	while(high > low && isnan(sorted[high-1])){
+		high -= 1;
+	}
+
+	idx = malloc(sizeof(sorted_index));
+	idx->block = sorted;
+	idx->map_size = 0;
+	idx->values = sorted + low;
+	idx->count = high - low;
+	idx->nan_count = data->size - idx->count;
+	idx->min = idx->count ? idx->values[0] : 0;
+	idx->max = idx->count ? idx->values[idx->count-1] : 0;
+
+	return idx;
+}
+
+static unsigned long count_below(double* values, unsigned long start, unsigned long end, double value){
+	unsigned long pivot;
+
+	while(start < end){
+		pivot = start + (end-start)/2;
+		if(values[pivot] < value){
+			start = pivot+1;
+		}else{
+			end = pivot;
+		}
+	}
+
+	return start;
+}
+
+static void* count_digits(void* data){
+	sort_slice* slice;
+	unsigned long t;
+
+	slice = (sort_slice*) data;
+	memset(slice->counts, 0, sizeof(slice->counts));
+	for(t=slice->start; t < slice->end; t++){
+		slice->counts[(slice->from[t] >> slice->shift) & (INDEX_RADIX-1)] += 1;
+	}
+
+	return NULL;
+}
+
+static unsigned long count_not_above(double* values, unsigned long start, unsigned long end, double value){
+	unsigned long pivot;
+
+	while(start < end){
+		pivot = start + (end-start)/2;
+		if(values[pivot] <= value){
+			start = pivot+1;
+		}else{
+			end = pivot;
+		}
+	}
+
+	return start;
+}
+
+void delete_index(sorted_index* idx){
+	if(idx){
+		if(idx->map_size){
+			munmap(idx->block, idx->map_size);
+		}else{
+			free_block(idx->block);
+		}
+		free(idx);
+	}
+}
+
+static inline double from_key(unsigned long key){
+	unsigned long bits;
+	double value;
+
+	bits = (key >> 63) ? key & ~(1UL << 63) : ~key;
+	memcpy(&value, &bits, sizeof(double));
+	return value;
+}
+
+sorted_index* load_index(const char* path, const char* data_path){
+	struct stat index_stat;
+	index_header* header;
+	sorted_index* idx;
+	void* map;
+	int fd;
+
+	if(stat(path, &index_stat) || (size_t)index_stat.st_size < sizeof(index_header)){
+		return NULL;
+	}
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0){
+		return NULL;
+	}
+	map = mmap(NULL, index_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		return NULL;
+	}
+
+	/* check the header is one we understand (and the values are all there) */
+	header = (index_header*) map;
+	if(memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != INDEX_VERSION
+		|| (size_t)index_stat.st_size != sizeof(index_header) + header->count*sizeof(double)){
+		munmap(map, index_stat.st_size);
+		return NULL;
+	}
+
+	/* the data changed after the index was made */
+	if(!is_cache_fresh(path, data_path, &header->data_stamp)){
+		munmap(map, index_stat.st_size);
+		return NULL;
+	}
+
+	/* the searches jump around, reading ahead would be wasted */
+	madvise(map, index_stat.st_size, MADV_RANDOM);
+
+	idx = malloc(sizeof(sorted_index));
+	idx->block = map;
+	idx->map_size = index_stat.st_size;
+	idx->values = (double*)((char*)map + sizeof(index_header));
+	idx->count = header->count;
+	idx->nan_count = header->nan_count;
+	idx->min = header->min;
+	idx->max = header->max;
+
+	return idx;
+}
+
+static void* make_keys(void* data){
+	sort_slice* slice;
+	unsigned long t;
+
+	slice = (sort_slice*) data;
+	for(t=slice->start; t < slice->end; t++){
+		slice->to[t] = to_key(slice->values[t]);
+	}
+
+	return NULL;
+}
+
+static void* make_values(void* data){
+	sort_slice* slice;
+	unsigned long t;
+	double value;
+
+	slice = (sort_slice*) data;
+	for(t=slice->start; t < slice->end; t++){
+		value = from_key(slice->from[t]);
+		memcpy(&slice->from[t], &value, sizeof(double));
+	}
+
+	return NULL;
+}
+
+static void run_slices(sort_slice* slices, unsigned long thread_count, void* (*function)(void*)){
+	pthread_t* threads;
+	unsigned long t;
+	int rc;
+
+	if(thread_count == 1){
+		function(&slices[0]);
+		return;
+	}
+
+	threads = malloc(thread_count*sizeof(pthread_t));
+	for(t=0; t < thread_count; t++){
+		rc = pthread_create(&threads[t], NULL, function, (void*)&slices[t]);
+
+		/* problem creating thread */
+		if(rc){
+			printf(ERROR_THREAD_CR, rc);
+			exit(ERROR);
+		}
+	}
+	for(t=0; t < thread_count; t++){
+		rc = pthread_join(threads[t], NULL);
+
+		/* error joining thread */
+		if(rc){
+			printf(ERROR_THREAD_JN, rc);
+			exit(ERROR);
+		}
+	}
+
+	free(threads);
+}
+
+int save_index(sorted_index* idx, const char* path, const file_stamp* data_stamp){
+	index_header header;
+	FILE* file;
+	int rc;
+
+	file = fopen(path, WRITE_ONLY);
+	if(!file){
+		return ERROR;
+	}
+
+	memset(&header, 0, sizeof(index_header));
+	memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+	header.version = INDEX_VERSION;
+	header.count = idx->count;
+	header.nan_count = idx->nan_count;
+	header.min = idx->min;
+	header.max = idx->max;
+	header.data_stamp = *data_stamp;
+
+	rc = SUCCESS;
+	if(fwrite(&header, sizeof(index_header), 1, file) != 1
+		|| fwrite(idx->values, sizeof(double), idx->count, file) != idx->count){
+		rc = ERROR;
+	}
+
+	if(fclose(file)){
+		rc = ERROR;
+	}
+
+	return rc;
+}
+
+static void* scatter_keys(void* data){
+	sort_slice* slice;
+	unsigned long t, key;
+
+	slice = (sort_slice*) data;
+	for(t=slice->start; t < slice->end; t++){
+		key = slice->from[t];
+		slice->to[slice->counts[(key >> slice->shift) & (INDEX_RADIX-1)]++] = key;
+	}
+
+	return NULL;
+}
+
+static unsigned long* sort_keys(double* values, unsigned long size, unsigned long thread_count){
+	sort_slice* slices;
+	unsigned long* keys;
+	unsigned long* sorted;
+	unsigned long* swap;
+	unsigned long t, shift, digit, total, count, keys_here;
+	bool same;
+
+	if(thread_count < 1 || thread_count > size){
+		thread_count = 1;
+	}
+
+	keys = alloc_block((size ? size : 1)*sizeof(unsigned long));
+	sorted = alloc_block((size ? size : 1)*sizeof(unsigned long));
+
+	slices = malloc(thread_count*sizeof(sort_slice));
+	for(t=0; t < thread_count; t++){
+		slices[t].values = values;
+		slices[t].start = size ? calculate_start_index(t, thread_count, size) : 0;
+		slices[t].end = size ? calculate_end_index(t, thread_count, size)+1 : 0;
+		slices[t].to = keys;
+	}
+	run_slices(slices, thread_count, make_keys);
+
+	/* one counting pass and one scatter per digit, from the lowest */
+	for(shift=0; shift < 64; shift += INDEX_RADIX_BITS){
+		for(t=0; t < thread_count; t++){
+			slices[t].from = keys;
+			slices[t].to = sorted;
+			slices[t].shift = shift;
+		}
+		run_slices(slices, thread_count, count_digits);
+
+		/* each thread's keys with a digit go after the smaller digits
+		 * and after the threads before it (which keeps the sort stable) */
+		same = false;
+		total = 0;
+		for(digit=0; digit < INDEX_RADIX; digit++){
+			count = total;
+			for(t=0; t < thread_count; t++){
+				keys_here = slices[t].counts[digit];
+				slices[t].counts[digit] = total;
+				total += keys_here;
+			}
+
+			/* every key has this digit */
+			same = same || total - count == size;
+		}
+		if(same){
+			continue;
+		}
+
+		run_slices(slices, thread_count, scatter_keys);
+
+		swap = keys;
+		keys = sorted;
+		sorted = swap;
+	}
+
+	free_block(sorted);
+
+	for(t=0; t < thread_count; t++){
+		slices[t].from = keys;
+	}
+	run_slices(slices, thread_count, make_values);
+
+	free(slices);
+	return keys;
+}
+
+static inline unsigned long to_key(double value){
+	unsigned long bits;
+
+	memcpy(&bits, &value, sizeof(double));
+	return (bits >> 63) ? ~bits : bits | (1UL << 63);
+}
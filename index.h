@@ -0,0 +1,89 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Index functions keep a data file sorted, so histograms with any
+ * range and any number of bins can be answered without reading the
+ * data again.
+ *
+ * A sorted index is every value of the data in order (NaNs are only
+ * counted). It is saved next to the data file (FILENAME.index) with a
+ * stamp of the file, and reused while the file still has that stamp
+ * (see reader.h). A saved index is mapped, not read, so answering only
+ * touches the pages the searches land on.
+ *
+ * Sorting:
+ * The values are sorted once with a parallel LSD radix sort on their
+ * bits (flipped so unsigned order is the order of the doubles), one
+ * INDEX_RADIX_BITS digit per pass. Every thread counts the digits of
+ * its slice, the counts of all threads give each thread where its keys
+ * go, and every thread scatters its slice there. Passes where every
+ * value has the same digit (like the exponent of close values) are
+ * skipped.
+ *
+ * Binning:
+ * The count of a bin is the number of values below its upper bound
+ * minus the number below its lower bound, so B bins cost B+1 binary
+ * searches, O(B log N), instead of a pass over the N data. The counts
+ * are exact, with the same bin edges as find_bin (see histogram.h).
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stddef.h>
+#include "histogram.h"
+#include "reader.h"
+#include "vector.h"
+
+/*	TYPES	==========================================================*/
+
+/* the data of a file, sorted */
+typedef struct{
+	unsigned long count; /* number of values (NaNs left out) */
+	unsigned long nan_count; /* number of NaNs in the data */
+	double min; /* the min value (if count > 0) */
+	double max; /* the max value (if count > 0) */
+	double* values; /* the values in order */
+	void* block; /* what values are in (a block, or the mapped file) */
+	size_t map_size; /* bytes mapped (0 if block is a block) */
+}sorted_index;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Sets the bin counts of graph (and its rejects) from the index.
+ * Assumes the bins of graph were already set up (process_stats_range)
+ */
+void bin_index(sorted_index* idx, histogram* graph);
+
+/**
+ * Builds a sorted index of the (double) data, sorting it with
+ * thread_count threads (refer to top)
+ */
+sorted_index* build_index(vector* data, unsigned long thread_count);
+
+/**
+ * Deletes the given index
+ */
+void delete_index(sorted_index* idx);
+
+/**
+ * Loads the index at the given path, if the data file at data_path
+ * has not changed since it was made
+ *
+ * @returns NULL if there is no usable index
+ */
+sorted_index* load_index(const char* path, const char* data_path);
+
+/**
+ * Saves the index to the given path, stamped with data_stamp (the data
+ * file as it was before the index was built)
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the index was saved
+ * 	ERROR if the file could not be written
+ */
+int save_index(sorted_index* idx, const char* path, const file_stamp* data_stamp);
+
+#endif
@@ -0,0 +1,284 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Kernel functions bin values faster than find_bin does, for
+ * histograms with very few or very many bins.
+ *
+ * count_small is written once and inlined into every kernel, so each
+ * kernel in the table is compiled with its bin count as a constant.
+ *
+ * Partitioned binning works a block of values at a time:
+ * 1) find every value's bin, and count how many fall in each partition
+ * 2) scatter the bins into partition order, staging each partition's
+ *    bins in its own cache line buffer (write combining) so the scatter
+ *    writes whole cache lines instead of one bin at a time
+ * 3) count the bins partition by partition, so only one partition's
+ *    counts (PARTITION_SHIFT bits of bins) are being touched at a time
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "histogram.h"
+#include "kernels.h"
+#include "memory.h"
+#include "config.h"
+#include "return_code.h"
+
+/* the bin counts that get their own kernel */
+#define KERNEL_SIZES(KERNEL) \
+	KERNEL(1) KERNEL(2) KERNEL(3) KERNEL(4) KERNEL(5) KERNEL(8) KERNEL(10) \
+	KERNEL(16) KERNEL(20) KERNEL(25) KERNEL(32) KERNEL(50) KERNEL(64) \
+	KERNEL(100) KERNEL(128) KERNEL(200) KERNEL(256)
+
+/*	TYPES	==========================================================*/
+
+/* a kernel for one bin count */
+typedef void (*small_kernel)(histogram* graph, double* values, unsigned long count, unsigned long* counts);
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Finds the bin of value like find_bin does, with one multiply by
+ * scale (1 / bin_width) and a fix up against bin_maxes
+ * Assumes bin_width > 0 and bin_count is graph->bin_count
+ *
+ * @returns the bin, or its reject counter if the value is outside the
+ * 	bins (see kernels.h)
+ */
+static inline unsigned long compute_bin(histogram* graph, double value, double scale, unsigned long bin_count);
+
+/**
+ * Bins the values with narrow counters (see kernels.h)
+ * Assumes bin_count <= KERNEL_MAX_BINS and bin_width > 0
+ */
+static inline void count_small(histogram* graph, double* values, unsigned long count, unsigned long* counts, unsigned long bin_count);
+
+/**
+ * Kernel for any small bin count without its own kernel
+ */
+static void count_small_any(histogram* graph, double* values, unsigned long count, unsigned long* counts);
+
+/* one kernel per bin count in KERNEL_SIZES */
+#define DECLARE_KERNEL(B) \
+	static void count_small_##B(histogram* graph, double* values, unsigned long count, unsigned long* counts);
+KERNEL_SIZES(DECLARE_KERNEL)
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* the kernels by bin count, NULL where count_small_any is used */
+#define KERNEL_ENTRY(B) [B] = count_small_##B,
+static const small_kernel kernels[KERNEL_MAX_BINS+1] = {
+	KERNEL_SIZES(KERNEL_ENTRY)
+};
+
+/* histograms with at least this many bins are partitioned (see set_partition_min_bins) */
+static unsigned long partition_min_bins = PARTITION_MIN_BINS;
+
+/*	FUNCTIONS	======================================================*/
+
+static inline unsigned long compute_bin(histogram* graph, double value, double scale, unsigned long bin_count){
+	unsigned long bin;
+
+	/* outside the bins (or NaN), its reject counter */
+	if(!(value >= graph->min && value <= graph->max)){
+		return bin_count + (value > graph->max)*REJECT_OVERFLOW + (value != value)*REJECT_NAN;
+	}
+
+	/* the multiply is at most one bin off from the bin_maxes */
+	bin = (unsigned long)((value - graph->min) * scale);
+	if(bin > bin_count-1){
+		bin = bin_count-1;
+	}
+	if(bin > 0 && value < graph->bin_maxes[bin-1]){
+		bin -= 1;
+	}else if(bin < bin_count-1 && value >= graph->bin_maxes[bin]){
+		bin += 1;
+	}
+
+	return bin;
+}
+
+void count_bins_integers(histogram* graph, long* values, unsigned long count, unsigned long* counts){
+	unsigned long t, offset, bin, width, shift, reciprocal, below, bin_count;
+	long min;
+
+	min = graph->int_min;
+	width = graph->int_width;
+	bin_count = graph->bin_count;
+
+	/* power of two widths are a shift */
+	if((width & (width - 1)) == 0){
+		shift = __builtin_ctzl(width);
+
+		for(t=0; t < count; t++){
+
+			/* below the min is an underflow, past the bins an overflow */
+			below = values[t] < min;
+			bin = ((unsigned long)values[t] - (unsigned long)min) >> shift;
+			bin = (bin < bin_count) ? bin : bin_count + REJECT_OVERFLOW;
+			counts[below ? bin_count + REJECT_UNDERFLOW : bin] += 1;
+		}
+		return;
+	}
+
+	/* ceil(2^64 / width), exact for 32 bit offsets and widths */
+	reciprocal = ~0UL / width + 1;
+
+	for(t=0; t < count; t++){
+		below = values[t] < min;
+		offset = below ? 0 : (unsigned long)values[t] - (unsigned long)min;
+
+		if(offset <= UINT_MAX && width <= UINT_MAX){
+			bin = (unsigned long)(((unsigned __int128)reciprocal * offset) >> 64);
+		}else{
+			bin = offset / width;
+		}
+
+		bin = (bin < bin_count) ? bin : bin_count + REJECT_OVERFLOW;
+		counts[below ? bin_count + REJECT_UNDERFLOW : bin] += 1;
+	}
+}
+
+int count_bins_partitioned(histogram* graph, double* values, unsigned long count, unsigned long* counts){
+	unsigned int* bins;
+	unsigned int* sorted;
+	unsigned int* staged;
+	unsigned int* staged_count;
+	unsigned long* offsets;
+	unsigned long* positions;
+	unsigned long partition_count, block_size, start, end, used, t, bin, partition;
+	double scale;
+
+	/* counts fit in cache, too few values to be worth it, or bins too big for 32 bits */
+	if(graph->bin_count < partition_min_bins || count < PARTITION_MIN_VALUES
+		|| graph->bin_count > UINT_MAX - REJECT_COUNT || !(graph->bin_width > 0)){
+		return FAIL;
+	}
+
+	partition_count = ((graph->bin_count-1) >> PARTITION_SHIFT) + 1;
+	block_size = (count < PARTITION_BLOCK_SIZE) ? count : PARTITION_BLOCK_SIZE;
+	scale = 1.0 / graph->bin_width;
+
+	bins = alloc_block(block_size*sizeof(unsigned int));
+	sorted = alloc_block(block_size*sizeof(unsigned int));
+	staged = alloc_block(partition_count*PARTITION_WC_SIZE*sizeof(unsigned int));
+	staged_count = alloc_block(partition_count*sizeof(unsigned int));
+	offsets = alloc_counters(partition_count+1);
+	positions = alloc_counters(partition_count);
+
+	for(start=0; start < count; start = end){
+		end = (count - start > block_size) ? start + block_size : count;
+
+		/* find the bins and the size of each partition */
+		memset(offsets, 0, (partition_count+1)*sizeof(unsigned long));
+		used = 0;
+		for(t=start; t < end; t++){
+			bin = compute_bin(graph, values[t], scale, graph->bin_count);
+
+			/* data outside the bins is only counted */
+			if(bin < graph->bin_count){
+				bins[used++] = bin;
+				offsets[(bin >> PARTITION_SHIFT) + 1] += 1;
+			}else{
+				counts[bin] += 1;
+			}
+		}
+
+		/* where each partition starts */
+		for(partition=0; partition < partition_count; partition++){
+			offsets[partition+1] += offsets[partition];
+			positions[partition] = offsets[partition];
+		}
+
+		/* scatter into partition order, a cache line at a time */
+		memset(staged_count, 0, partition_count*sizeof(unsigned int));
+		for(t=0; t < used; t++){
+			partition = bins[t] >> PARTITION_SHIFT;
+			staged[partition*PARTITION_WC_SIZE + staged_count[partition]] = bins[t];
+			staged_count[partition] += 1;
+
+			if(staged_count[partition] == PARTITION_WC_SIZE){
+				memcpy(sorted + positions[partition], staged + partition*PARTITION_WC_SIZE, PARTITION_WC_SIZE*sizeof(unsigned int));
+				positions[partition] += PARTITION_WC_SIZE;
+				staged_count[partition] = 0;
+			}
+		}
+		for(partition=0; partition < partition_count; partition++){
+			memcpy(sorted + positions[partition], staged + partition*PARTITION_WC_SIZE, staged_count[partition]*sizeof(unsigned int));
+		}
+
+		/* count one partition (a cache sized range of bins) at a time */
+		for(t=0; t < used; t++){
+			counts[sorted[t]] += 1;
+		}
+	}
+
+	/* Delete what we dont need anymore */
+	free_block(bins);
+	free_block(sorted);
+	free_block(staged);
+	free_block(staged_count);
+	free_block(offsets);
+	free_block(positions);
+
+	return SUCCESS;
+}
+
+int count_bins_small(histogram* graph, double* values, unsigned long count, unsigned long* counts){
+
+	/* too many bins, or all data is one value (no width to divide by) */
+	if(graph->bin_count > KERNEL_MAX_BINS || !(graph->bin_width > 0)){
+		return FAIL;
+	}
+
+	if(kernels[graph->bin_count]){
+		kernels[graph->bin_count](graph, values, count, counts);
+	}else{
+		count_small_any(graph, values, count, counts);
+	}
+	return SUCCESS;
+}
+
+static inline void count_small(histogram* graph, double* values, unsigned long count, unsigned long* counts, unsigned long bin_count){
+	unsigned short local[KERNEL_MAX_BINS + REJECT_COUNT];
+	double scale;
+	unsigned long t, start, end, bin;
+
+	scale = 1.0 / graph->bin_width;
+
+	for(start=0; start < count; start = end){
+
+		/* a 16 bit counter cannot overflow within one flush */
+		end = (count - start > KERNEL_FLUSH_SIZE) ? start + KERNEL_FLUSH_SIZE : count;
+		memset(local, 0, (bin_count + REJECT_COUNT)*sizeof(unsigned short));
+
+		/* data outside the bins lands in the reject counters, no branch */
+		for(t=start; t < end; t++){
+			local[compute_bin(graph, values[t], scale, bin_count)] += 1;
+		}
+
+		for(bin=0; bin < bin_count + REJECT_COUNT; bin++){
+			counts[bin] += local[bin];
+		}
+	}
+}
+
+static void count_small_any(histogram* graph, double* values, unsigned long count, unsigned long* counts){
+	count_small(graph, values, count, counts, graph->bin_count);
+}
+
+#define DEFINE_KERNEL(B) \
+	static void count_small_##B(histogram* graph, double* values, unsigned long count, unsigned long* counts){ \
+		count_small(graph, values, count, counts, B); \
+	}
+KERNEL_SIZES(DEFINE_KERNEL)
+
+unsigned long find_bin_scaled(histogram* graph, double value, double scale){
+	return compute_bin(graph, value, scale, graph->bin_count);
+}
+
+void set_partition_min_bins(unsigned long bins){
+	partition_min_bins = bins;
+}
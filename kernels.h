@@ -0,0 +1,89 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Kernel functions bin values faster than find_bin does, for
+ * histograms with few bins (KERNEL_MAX_BINS or less) or with more bins
+ * than fit in cache (PARTITION_MIN_BINS or more, see
+ * set_partition_min_bins).
+ *
+ * Small histograms:
+ * The bin is found with one multiply and fixed up against bin_maxes,
+ * so every value lands in the same bin find_bin would give it. Counts
+ * are kept in 16 bit counters (at most 512 bytes, a few cache lines)
+ * and added into the 64 bit counts every KERNEL_FLUSH_SIZE values.
+ *
+ * Common bin counts get their own kernel compiled for that exact count
+ * (see KERNEL_SIZES in kernels.c); other small counts share one kernel.
+ *
+ * Large histograms:
+ * Counting values straight into millions of bins misses cache on almost
+ * every value. Instead, the bins of a block of values are first
+ * scattered into partitions of 2^PARTITION_SHIFT bins (through cache
+ * line sized write combining buffers), then counted one partition at a
+ * time, so the counts being touched stay in cache.
+ *
+ * Rejected data:
+ * Values outside the bins (or NaN) are counted in the reject counters
+ * after the bins (see histogram.h), in the same pass. The range check
+ * stays a branch (it is almost always taken the same way on clean data),
+ * but after it the small kernel counts bins and rejects alike.
+ *
+ * Integer data:
+ * The bin is (value - int_min) / int_width, exactly. A power of two
+ * width is a shift; any other width is a multiply by its reciprocal
+ * (the high 64 bits of a 128 bit product), which is exact for offsets
+ * and widths below 2^32. Bigger offsets are simply divided.
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "histogram.h"
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Adds the bins of count integer values to the given counts array
+ * (bin_count long, plus the reject counters) like count_bins.
+ * Assumes the integer bins were set up (int_min and int_width)
+ */
+void count_bins_integers(histogram* graph, long* values, unsigned long count, unsigned long* counts);
+
+/**
+ * Adds the bins of count values to the given counts array like
+ * count_bins, if the histogram is big enough to be partitioned
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the values were counted
+ * 	FAIL if partitioning would not help (nothing was counted)
+ */
+int count_bins_partitioned(histogram* graph, double* values, unsigned long count, unsigned long* counts);
+
+/**
+ * Adds the bins of count values to the given counts array like
+ * count_bins, if the histogram is small enough for a kernel
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the values were counted
+ * 	FAIL if there is no kernel for this histogram (nothing was counted)
+ */
+int count_bins_small(histogram* graph, double* values, unsigned long count, unsigned long* counts);
+
+/**
+ * Finds the bin of one value like find_bin does, with one multiply by
+ * scale (1 / bin_width) instead of a binary search
+ * Assumes bin_width > 0
+ *
+ * @returns the bin, or its reject counter (bin_count + REJECT_KIND) if
+ * 	the value is outside the bins
+ */
+unsigned long find_bin_scaled(histogram* graph, double value, double scale);
+
+/**
+ * Sets the fewest bins a histogram needs to be partitioned
+ * (PARTITION_MIN_BINS by default, ULONG_MAX never partitions)
+ */
+void set_partition_min_bins(unsigned long bins);
+
+#endif
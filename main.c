@@ -8,41 +8,178 @@
  * This program can bin given double/float data in parallel (and serial)
  * 
  * When loading from file, please use the following format for the file:
- * <number of lines of data>
+ * <number of lines of data> [<min> <max>]
  * <data 1>
  * <data 2>
  * ...
  * <data n>
  * 
  * USAGE:
- * 	histo_program.out [-h] [-p N] (-R N B or FILENAME B)
+ * 	histo_program.out [-h] [-v] [-p N] [-o FORMAT] [-O FILE] [-n] [-H] [-d CHUNK] [-r MIN MAX] [-s] [-q] [-c FILE] [-i] [-S FILE] [-I] [-m MB] [-M] [-x] [-g] [-a FRACTION] [-e ERROR] (-R N B or FILENAME B or -b PATH B or -D SOCKET)
+ * 	histo_program.out merge [-p N] [-o FORMAT] [-O FILE] [-S FILE] [-q] SHARD...
+ * 	histo_program.out range [-O FILE] FILENAME...
  * 
  * 	Required arguments:
  * 	-R N B		Randomly generate data of size N and apply the histogram 
  * 				data binning using bin size B.
  * 				(CANNOT be used with (FILENAME B))
  * 	FILENAME B	Load data to sort from a file using bin size B.
+ * 				The file may also be a column file (see vector.h).
  * 				(CANNOT be used with (-R N B))
+ * 	B = auto	With -R or FILENAME, pick the number of bins from the
+ * 				data (Freedman-Diaconis, see histogram.h)
+ * 				(CANNOT be used with -s)
+ * 	-b PATH B	Batch mode: histogram every file in directory PATH
+ * 				(or every file listed in file PATH, one per line)
+ * 				using bin size B, writing each result next to its
+ * 				file as FILENAME.hist (CANNOT be used with the others)
+ * 	-D SOCKET	Daemon mode: keep named histograms resident and serve
+ * 				ingest and queries on Unix socket SOCKET (see daemon.h)
+ * 				(CANNOT be used with the others)
  * 
  * 	Optional arguments:
  * 	-h			Display help message and exit
  * 	-p N		Use parallel binning process with N number of threads
- * 				(Default mode is serial)
+ * 				(Default mode is serial). -p auto picks serial or the
+ * 				thread count from a machine profile (see tuner.h)
+ * 	-o FORMAT	Output format: text, csv, json or binary
+ * 				(Default is text)
+ * 	-O FILE		Write the output to FILE instead of the screen
+ * 	-n			NUMA mode: pin threads to cpus and have each thread
+ * 				first touch the data it bins (only affects parallel mode)
+ * 	-H			Use explicit huge pages for big arrays
+ * 				(Default is transparent huge pages)
+ * 	-d CHUNK	Dynamic mode: threads take CHUNK data at a time from
+ * 				a shared cursor instead of one fixed slice each
+ * 				(only affects parallel mode)
+ * 	-r MIN MAX	Use the range MIN to MAX instead of finding the min and
+ * 				max of the data. Files with a known range (from -r or
+ * 				their header) are binned while being read.
+ * 	-s			Answer from a fine grained sketch saved next to the
+ * 				data as FILENAME.sketch, building it if needed
+ * 				(only with FILENAME B, CANNOT be used with -r)
+ * 	-q			Be quiet: do not print status messages
+ * 	-c FILE		Also save the loaded data as a compressed column
+ * 				file FILE
+ * 	-i			Integer mode: load (or generate) whole numbers and bin
+ * 				them with exact integer bins (text files and -R only,
+ * 				CANNOT be used with -s, -c, -b or -D)
+ * 	-S FILE		Also save the histogram as a shard file FILE
+ * 	-I			Direct I/O: read data files with O_DIRECT (see reader.h)
+ * 	-m MB		Out of core mode: bin a text data file in mapped windows
+ * 				without loading it, using at most MB MB of memory
+ * 				(see outcore.h, only with FILENAME B, CANNOT be used
+ * 				with -s, -c, -i or B = auto)
+ * 	-M			Moments: also find the count, mean, variance, skewness,
+ * 				min and max of the data in the binning pass (see
+ * 				moments.h, only with -R or FILENAME B, CANNOT be used
+ * 				with -s or -i)
+ * 	-x			Answer from the data sorted once and saved next to it
+ * 				as FILENAME.index (see index.h), building it if
+ * 				needed. Any range and bins are then answered without
+ * 				reading the data (only with FILENAME B, CANNOT be used
+ * 				with -s, -m, -i, -M or B = auto)
+ * 	-g			Group mode: FILENAME has key value lines (see
+ * 				group.h), output one histogram per key, all with
+ * 				the same bins (only with FILENAME B, CANNOT be used
+ * 				with -s, -x, -m, -i, -M, -c, -S, -o binary or
+ * 				B = auto)
+ * 	-a FRACTION	Approximate mode: bin a random FRACTION (above 0, at
+ * 				most 1) of the data, and output the estimated counts
+ * 				with their 95% intervals (see sample.h, only with -R
+ * 				or FILENAME B, CANNOT be used with -s, -x, -g, -m,
+ * 				-i, -M or -S)
+ * 	-e ERROR	Approximate mode like -a, picking the fraction for
+ * 				the relative ERROR of an average bin (CANNOT be used
+ * 				with -a)
+ * 
+ * 	Subcommands (see shard.h):
+ * 	merge SHARD...		Add up shard files with the same bins and output
+ * 				the result like a normal run (-S saves it as a
+ * 				shard again)
+ * 	range FILENAME...	Find the range of all the given data files (or
+ * 				range files) together, and write it as a range
+ * 				file (0 MIN MAX), to agree on bins before sharding
+ * 				(quiet unless given -O FILE, so it can be redirected)
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "config.h"
 #include "return_code.h"
+#include "batch.h"
+#include "daemon.h"
+#include "group.h"
 #include "histogram.h"
+#include "index.h"
+#include "memory.h"
+#include "outcore.h"
+#include "output.h"
+#include "pipeline.h"
+#include "reader.h"
+#include "sample.h"
+#include "shard.h"
+#include "sketch.h"
+#include "status.h"
+#include "tuner.h"
 #include "vector.h"
 
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Runs the merge subcommand (argv[0] is "merge")
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the shards were merged and written
+ * 	ERROR if they were not (messages will have already been printed out)
+ */
+static int merge_main(int argc, char* argv[]);
+
+/**
+ * Runs the range subcommand (argv[0] is "range")
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the range was found and written
+ * 	ERROR if it was not (messages will have already been printed out)
+ */
+static int range_main(int argc, char* argv[]);
+
+/**
+ * Writes the histogram (or the histograms of groups, if not NULL) in
+ * the given format to out_filename (or to the screen if it is NULL)
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the histogram was written
+ * 	ERROR if it was not (messages will have already been printed out)
+ */
+static int write_output(histogram* graph, group_set* groups, OUTPUT_FORMAT format, const char* out_filename, unsigned long thread_count);
+
+/*	FUNCTIONS	======================================================*/
+
 int main(int argc, char* argv[]){
-	unsigned long size, bins_size, thread_count;
+	unsigned long size, bins_size, thread_count, place_count, chunk_size, budget;
 	int rc, index;
 	histogram* graph;
-	bool para_mode, rand_mode, file_mode, verb_mode;
+	bool para_mode, auto_mode, rand_mode, file_mode, verb_mode, numa_mode, range_mode, sketch_mode, batch_mode, daemon_mode, column_mode, integer_mode, auto_bins, outcore_mode, stats_mode, index_mode, group_mode, sample_mode;
+	double range_min, range_max, header_min, header_max, sample_fraction, sample_error;
 	FILE* file;
+	OUTPUT_FORMAT out_format;
+	char* out_filename;
+	char* data_filename;
+	char* sketch_filename;
+	char* index_filename;
+	char* batch_path;
+	char* socket_path;
+	char* column_filename;
+	char* shard_filename;
+	sketch* sk;
+	sorted_index* ix;
+	file_stamp data_stamp;
+	group_set* groups;
 	
 	/* We need at least 1 argument */
 	if(argc < 2){
@@ -58,6 +195,13 @@ int main(int argc, char* argv[]){
 		return SUCCESS;
 	}
 	
+	/* first argument is a subcommand */
+	if(strcmp(argv[index],MERGE_CMD)==0){
+		return merge_main(argc-index,argv+index);
+	}else if(strcmp(argv[index],RANGE_CMD)==0){
+		return range_main(argc-index,argv+index);
+	}
+	
 	/* first argument is verb flag */
 	if(strcmp(argv[index],VERB_FLAG)==0){
 		verb_mode = true;
@@ -67,27 +211,59 @@ int main(int argc, char* argv[]){
 	}
 	
 	para_mode = false;
+	auto_mode = false;
 	rand_mode = false;
 	file_mode = false;
+	numa_mode = false;
+	range_mode = false;
+	sketch_mode = false;
+	batch_mode = false;
+	batch_path = NULL;
+	daemon_mode = false;
+	socket_path = NULL;
+	column_mode = false;
+	column_filename = NULL;
+	integer_mode = false;
+	auto_bins = false;
+	outcore_mode = false;
+	stats_mode = false;
+	index_mode = false;
+	group_mode = false;
+	sample_mode = false;
+	sample_fraction = 0;
+	sample_error = 0;
+	budget = 0;
+	shard_filename = NULL;
 	graph = NULL;
+	sk = NULL;
+	ix = NULL;
+	groups = NULL;
+	data_filename = NULL;
+	sketch_filename = NULL;
+	index_filename = NULL;
+	file = NULL;
+	out_format = FORMAT_TEXT;
+	out_filename = NULL;
+	thread_count = 1;
+	chunk_size = 0;
 	
 	/* parse all arguments */
 	while(index < argc){
 		
-		/* once we parse parallel flag and (file flag or random flag),
-		 * we dont need to do anymore argument parsing 
-		 */
-		if((para_mode && file_mode) || (para_mode && rand_mode)){
-			index = argc+1;
-		}
-		
 		/* we found parallel flag */
-		else if(strcmp(argv[index],PARA_FLAG)==0 && !para_mode){
+		if(strcmp(argv[index],PARA_FLAG)==0 && !para_mode){
 			
 			/* parallel flag requires at least 1 following argument */
-			if(argc-index < 1){
+			if(argc-index < 2){
 				printf(BAD_ARGS_MESSAGE,PARA_FLAG);
 				return ERROR;
+			}else if(strcmp(argv[index+1],TUNE_AUTO)==0){
+				
+				/* threads are picked once the data size is known */
+				auto_mode = true;
+				para_mode = true;
+				thread_count = 0;
+				index += 2;
 			}else{
 				index += 1;
 				
@@ -133,8 +309,14 @@ int main(int argc, char* argv[]){
 					index +=1;
 				}
 				
-				/* next argument is number of bins */
-				rc = sscanf(argv[index],"%lu",&bins_size);
+				/* next argument is number of bins (or auto) */
+				if(strcmp(argv[index],BINS_AUTO)==0){
+					auto_bins = true;
+					bins_size = AUTO_BINS_GUESS;
+					rc = 1;
+				}else{
+					rc = sscanf(argv[index],"%lu",&bins_size);
+				}
 				
 				/* we didnt find a number */
 				if(rc < 1){
@@ -145,18 +327,266 @@ int main(int argc, char* argv[]){
 				}
 				
 				rand_mode = true;
-				
-				/* create a histogram and randomized data vector */
-				graph = init_histogram(bins_size);
-				graph->data = create_vector_random(size);
 			}	
 		}
 		
+		/* we found output format flag */
+		else if(strcmp(argv[index],FORM_FLAG)==0){
+			
+			/* format flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_ARGS_MESSAGE,FORM_FLAG);
+				return ERROR;
+			}
+			
+			/* next argument is the format name */
+			if(parse_output_format(argv[index+1],&out_format)){
+				printf(BAD_FORM_MESSAGE,argv[index+1]);
+				return ERROR;
+			}
+			index += 2;
+		}
+		
+		/* we found output file flag */
+		else if(strcmp(argv[index],OUTF_FLAG)==0){
+			
+			/* output file flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_OUTF_MESSAGE,OUTF_FLAG);
+				return ERROR;
+			}
+			out_filename = argv[index+1];
+			index += 2;
+		}
+		
+		/* we found dynamic chunks flag */
+		else if(strcmp(argv[index],DYNA_FLAG)==0){
+			
+			/* dynamic flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_ARGS_MESSAGE,DYNA_FLAG);
+				return ERROR;
+			}
+			
+			/* next argument is the chunk size */
+			rc = sscanf(argv[index+1],"%lu",&chunk_size);
+			
+			/* we didnt find a number (or it was 0) */
+			if(rc < 1 || chunk_size < 1){
+				printf(BAD_NUM_MESSAGE,DYNA_FLAG);
+				return ERROR;
+			}
+			index += 2;
+		}
+		
+		/* we found out of core flag */
+		else if(strcmp(argv[index],OUTC_FLAG)==0){
+			
+			/* out of core flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_ARGS_MESSAGE,OUTC_FLAG);
+				return ERROR;
+			}
+			
+			/* next argument is the budget in MB */
+			rc = sscanf(argv[index+1],"%lu",&budget);
+			
+			/* we didnt find a number (or it was 0) */
+			if(rc < 1 || budget < 1){
+				printf(BAD_NUM_MESSAGE,OUTC_FLAG);
+				return ERROR;
+			}
+			budget <<= 20;
+			outcore_mode = true;
+			index += 2;
+		}
+		
+		/* we found range flag */
+		else if(strcmp(argv[index],RANG_FLAG)==0){
+			
+			/* range flag requires 2 following arguments */
+			if(argc-index < 3){
+				printf(BAD_ARGS_MESSAGE,RANG_FLAG);
+				return ERROR;
+			}
+			
+			/* next arguments are the min and max */
+			if(sscanf(argv[index+1],"%lf",&range_min) < 1 || sscanf(argv[index+2],"%lf",&range_max) < 1
+				|| !(range_min < range_max)){
+				printf(BAD_RANGE_MESSAGE,RANG_FLAG);
+				return ERROR;
+			}
+			range_mode = true;
+			index += 3;
+		}
+		
+		/* we found sketch flag */
+		else if(strcmp(argv[index],SKTC_FLAG)==0){
+			sketch_mode = true;
+			index += 1;
+		}
+		
+		/* we found batch flag */
+		else if(strcmp(argv[index],BTCH_FLAG)==0 && !batch_mode){
+			
+			/* batch flag requires 2 following arguments */
+			if(argc-index < 3){
+				printf(BAD_ARGS_MESSAGE,BTCH_FLAG);
+				return ERROR;
+			}
+			batch_path = argv[index+1];
+			
+			/* next argument is number of bins */
+			rc = sscanf(argv[index+2],"%lu",&bins_size);
+			
+			/* we didnt find a number */
+			if(rc < 1){
+				printf(BAD_BIN_MESSAGE,BTCH_FLAG);
+				return ERROR;
+			}
+			
+			batch_mode = true;
+			index += 3;
+		}
+		
+		/* we found daemon flag */
+		else if(strcmp(argv[index],DMON_FLAG)==0 && !daemon_mode){
+			
+			/* daemon flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_OUTF_MESSAGE,DMON_FLAG);
+				return ERROR;
+			}
+			socket_path = argv[index+1];
+			daemon_mode = true;
+			index += 2;
+		}
+		
+		/* we found column file flag */
+		else if(strcmp(argv[index],COLM_FLAG)==0){
+			
+			/* column flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_OUTF_MESSAGE,COLM_FLAG);
+				return ERROR;
+			}
+			column_filename = argv[index+1];
+			index += 2;
+		}
+		
+		/* we found shard file flag */
+		else if(strcmp(argv[index],SHRD_FLAG)==0){
+			
+			/* shard flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_OUTF_MESSAGE,SHRD_FLAG);
+				return ERROR;
+			}
+			shard_filename = argv[index+1];
+			index += 2;
+		}
+		
+		/* we found moments flag */
+		else if(strcmp(argv[index],STAT_FLAG)==0){
+			stats_mode = true;
+			index += 1;
+		}
+		
+		/* we found index flag */
+		else if(strcmp(argv[index],INDX_FLAG)==0){
+			index_mode = true;
+			index += 1;
+		}
+		
+		/* we found group flag */
+		else if(strcmp(argv[index],GRUP_FLAG)==0){
+			group_mode = true;
+			index += 1;
+		}
+		
+		/* we found sample flag */
+		else if(strcmp(argv[index],SMPL_FLAG)==0){
+			
+			/* sample flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_ARGS_MESSAGE,SMPL_FLAG);
+				return ERROR;
+			}
+			
+			/* next argument is the fraction to sample */
+			rc = sscanf(argv[index+1],"%lf",&sample_fraction);
+			
+			/* we didnt find a number (or it was no fraction) */
+			if(rc < 1){
+				printf(BAD_NUM_MESSAGE,SMPL_FLAG);
+				return ERROR;
+			}else if(!(sample_fraction > 0 && sample_fraction <= 1)){
+				printf(BAD_FRAC_MESSAGE,SMPL_FLAG);
+				return ERROR;
+			}
+			sample_mode = true;
+			index += 2;
+		}
+		
+		/* we found sample error flag */
+		else if(strcmp(argv[index],SERR_FLAG)==0){
+			
+			/* sample error flag requires 1 following argument */
+			if(argc-index < 2){
+				printf(BAD_ARGS_MESSAGE,SERR_FLAG);
+				return ERROR;
+			}
+			
+			/* next argument is the relative error */
+			rc = sscanf(argv[index+1],"%lf",&sample_error);
+			
+			/* we didnt find a number (or it was not a finite number above 0) */
+			if(rc < 1){
+				printf(BAD_NUM_MESSAGE,SERR_FLAG);
+				return ERROR;
+			}else if(!(sample_error > 0 && sample_error < INFINITY)){
+				printf(BAD_ERR_MESSAGE,SERR_FLAG);
+				return ERROR;
+			}
+			sample_mode = true;
+			index += 2;
+		}
+		
+		/* we found integer flag */
+		else if(strcmp(argv[index],INTG_FLAG)==0){
+			integer_mode = true;
+			index += 1;
+		}
+		
+		/* we found quiet flag */
+		else if(strcmp(argv[index],QUIE_FLAG)==0){
+			set_quiet_mode(true);
+			index += 1;
+		}
+		
+		/* we found direct I/O flag */
+		else if(strcmp(argv[index],DRCT_FLAG)==0){
+			set_direct_io(true);
+			index += 1;
+		}
+		
+		/* we found huge pages flag */
+		else if(strcmp(argv[index],HUGE_FLAG)==0){
+			set_explicit_huge_pages(true);
+			index += 1;
+		}
+		
+		/* we found numa flag */
+		else if(strcmp(argv[index],NUMA_FLAG)==0){
+			numa_mode = true;
+			index += 1;
+		}
+		
 		/* no flags means filename */
 		else if(!file_mode){
 			
 			/* filename requires at least 1 following argument */
-			if(argc-index < 1){
+			if(argc-index < 2){
 				printf(BAD_BIN_MESSAGE,argv[index]);
 				return ERROR;
 			}
@@ -169,11 +599,18 @@ int main(int argc, char* argv[]){
 				printf(ERROR_FILENAME,argv[index]);
 				return ERROR;
 			}else{
+				data_filename = argv[index];
 				index += 1;
 			}
 			
-			/* next argument is number of bins */
-			rc = sscanf(argv[index],"%lu",&bins_size);
+			/* next argument is number of bins (or auto) */
+			if(strcmp(argv[index],BINS_AUTO)==0){
+				auto_bins = true;
+				bins_size = AUTO_BINS_GUESS;
+				rc = 1;
+			}else{
+				rc = sscanf(argv[index],"%lu",&bins_size);
+			}
 			
 			/* we didnt find a number */
 			if(rc < 1){
@@ -184,14 +621,46 @@ int main(int argc, char* argv[]){
 			}
 			
 			file_mode = true;
-			
-			/* create a histogram and read vector data from file */
-			graph = init_histogram(bins_size);
-			graph->data = create_vector_from_file(file);
-			
-			/* close the file */
-			fclose(file);
 		}
+		
+		/* we dont know what this is */
+		else{
+			printf(BAD_FLAG_MESSAGE,argv[index]);
+			return ERROR;
+		}
+	}
+	
+	/* integer data only goes through the plain loading paths */
+	if(integer_mode && (batch_mode || daemon_mode || sketch_mode || column_filename)){
+		printf(ERROR_SKETCH_RANGE,INTG_FLAG,batch_mode ? BTCH_FLAG : daemon_mode ? DMON_FLAG : sketch_mode ? SKTC_FLAG : COLM_FLAG);
+		return ERROR;
+	}
+	
+	/* moments are found while binning double data from -R or a file */
+	if(stats_mode && (batch_mode || daemon_mode || sketch_mode || integer_mode)){
+		printf(ERROR_SKETCH_RANGE,STAT_FLAG,batch_mode ? BTCH_FLAG : daemon_mode ? DMON_FLAG : sketch_mode ? SKTC_FLAG : INTG_FLAG);
+		return ERROR;
+	}
+	
+	/* daemon mode runs on its own (until it is killed) */
+	if(daemon_mode){
+		if(rand_mode || file_mode || batch_mode){
+			printf(ERROR_DAEMON_MODE,DMON_FLAG);
+			return ERROR;
+		}
+		
+		return run_daemon(socket_path,para_mode ? thread_count : 0);
+	}
+	
+	/* batch mode runs on its own */
+	if(batch_mode){
+		if(rand_mode || file_mode){
+			printf(ERROR_BATCH_MODE,BTCH_FLAG);
+			return ERROR;
+		}
+		
+		rc = process_batch(batch_path,bins_size,para_mode ? thread_count : 0,out_format);
+		return rc ? ERROR : SUCCESS;
 	}
 	
 	/* we need to be in random mode or file mode to run */
@@ -201,37 +670,508 @@ int main(int argc, char* argv[]){
 		return ERROR;
 	}
 	
-	/* setup the graph's bins */
-	rc = process_stats(graph);
+	/* sketches need the real min and max of the data */
+	if(sketch_mode && range_mode){
+		printf(ERROR_SKETCH_RANGE,SKTC_FLAG,RANG_FLAG);
+		return ERROR;
+	}
 	
-	/* we had problems setting the graph's bins */
-	if(rc < 0){
-		printf(ERROR_UNKNOWN);
+	/* sketches are answered without the data to pick bins from */
+	if(sketch_mode && auto_bins){
+		printf(ERROR_SKETCH_RANGE,SKTC_FLAG,BINS_AUTO);
 		return ERROR;
-	}else if(rc > 0){
-		printf(ERROR_NO_DATA);
+	}
+	
+	/* out of core mode only bins text data files as they are */
+	if(outcore_mode && (rand_mode || sketch_mode || column_filename || integer_mode || auto_bins)){
+		printf(ERROR_SKETCH_RANGE,OUTC_FLAG,rand_mode ? RAND_FLAG : sketch_mode ? SKTC_FLAG : column_filename ? COLM_FLAG : integer_mode ? INTG_FLAG : BINS_AUTO);
+		return ERROR;
+	}
+	
+	/* indexes keep the double data of a file, as it is */
+	if(index_mode && (rand_mode || sketch_mode || outcore_mode || integer_mode || stats_mode || auto_bins)){
+		printf(ERROR_SKETCH_RANGE,INDX_FLAG,rand_mode ? RAND_FLAG : sketch_mode ? SKTC_FLAG : outcore_mode ? OUTC_FLAG : integer_mode ? INTG_FLAG : stats_mode ? STAT_FLAG : BINS_AUTO);
 		return ERROR;
 	}
 	
-	/* parallization mode */
-	if(para_mode){
+	/* group files are binned from their lines as they are */
+	if(group_mode && (rand_mode || sketch_mode || index_mode || outcore_mode || integer_mode || stats_mode || column_filename || shard_filename || auto_bins || out_format == FORMAT_BINARY)){
+		printf(ERROR_SKETCH_RANGE,GRUP_FLAG,rand_mode ? RAND_FLAG : sketch_mode ? SKTC_FLAG : index_mode ? INDX_FLAG : outcore_mode ? OUTC_FLAG : integer_mode ? INTG_FLAG : stats_mode ? STAT_FLAG : column_filename ? COLM_FLAG : shard_filename ? SHRD_FLAG : auto_bins ? BINS_AUTO : FORM_BINARY);
+		return ERROR;
+	}
+	
+	/* samples are drawn from double data loaded as a whole */
+	if(sample_mode && (sample_fraction > 0 && sample_error > 0)){
+		printf(ERROR_SKETCH_RANGE,SMPL_FLAG,SERR_FLAG);
+		return ERROR;
+	}
+	if(sample_mode && (sketch_mode || index_mode || group_mode || outcore_mode || integer_mode || stats_mode || shard_filename)){
+		printf(ERROR_SKETCH_RANGE,sample_error > 0 ? SERR_FLAG : SMPL_FLAG,sketch_mode ? SKTC_FLAG : index_mode ? INDX_FLAG : group_mode ? GRUP_FLAG : outcore_mode ? OUTC_FLAG : integer_mode ? INTG_FLAG : stats_mode ? STAT_FLAG : SHRD_FLAG);
+		return ERROR;
+	}
+	
+	/* column files have no text header */
+	if(file_mode){
+		column_mode = is_column_file(file);
+	}
+	if(group_mode && column_mode){
+		printf(ERROR_GROUP_MAP,GRUP_FLAG);
+		return ERROR;
+	}
+	if(outcore_mode && column_mode){
+		printf(ERROR_OUTCORE_MAP,OUTC_FLAG);
+		return ERROR;
+	}
+	if(integer_mode && column_mode){
+		printf(ERROR_INTEGER_COLUMNS,INTG_FLAG);
+		return ERROR;
+	}
+	
+	/* a range in the file header works like the range flag */
+	if(file_mode && !column_mode){
+		rc = read_vector_header(file,&size,&header_min,&header_max);
+		
+		if(rc == ERROR){
+			printf(ERROR_BAD_DATA);
+			return ERROR;
+		}else if(rc == SUCCESS && !range_mode && !sketch_mode){
+			range_mode = true;
+			range_min = header_min;
+			range_max = header_max;
+		}
+	}
+	
+	/* auto mode picks the threads from the data size
+	 * (column files are decoded on every cpu, then picked for) */
+	if(auto_mode){
+		thread_count = column_mode ? count_cpus() : pick_thread_count(size,bins_size,integer_mode);
+		para_mode = thread_count > 1;
+		if(!column_mode){
+			print_status(TUNE_PICK_MSG,thread_count);
+		}
+	}
+	
+	graph = init_histogram(bins_size);
+	if(stats_mode){
+		graph->stats = calloc(1,sizeof(moments));
+	}
+	
+	/* caches of the data file are stamped with it before it is read */
+	if((sketch_mode && file_mode) || index_mode){
+		stamp_file(data_filename,&data_stamp);
+	}
+	
+	/* sketches live next to the data file */
+	sketch_mode = sketch_mode && file_mode;
+	if(sketch_mode){
+		sketch_filename = malloc(strlen(data_filename)+strlen(SKETCH_SUFFIX)+1);
+		strcpy(sketch_filename,data_filename);
+		strcat(sketch_filename,SKETCH_SUFFIX);
+		
+		sk = load_sketch(sketch_filename,data_filename);
+	}
+	
+	/* so do indexes */
+	if(index_mode){
+		index_filename = malloc(strlen(data_filename)+strlen(INDEX_SUFFIX)+1);
+		strcpy(index_filename,data_filename);
+		strcat(index_filename,INDEX_SUFFIX);
+		
+		ix = load_index(index_filename,data_filename);
+	}
+	
+	/* a saved sketch answers without reading the data */
+	if(sk){
+		print_status(H_RB_MSG,sketch_filename);
+		rebin_sketch(sk,graph);
+		fclose(file);
+	}
+	
+	/* a saved index answers any range without reading the data */
+	else if(ix){
+		print_status(H_IB_MSG,index_filename);
+		fclose(file);
+		
+		if(!range_mode && ix->count < 1){
+			printf(ERROR_NO_DATA);
+			return ERROR;
+		}
+		process_stats_range(graph,range_mode ? range_min : ix->min,range_mode ? range_max : ix->max);
+		bin_index(ix,graph);
+	}
+	
+	/* group files are binned into one histogram per key, finding their
+	 * range first if it is not known */
+	else if(group_mode){
+		if(range_mode){
+			process_stats_range(graph,range_min,range_max);
+		}
+		groups = init_group_set(graph);
+		rc = process_file_grouped(groups,file,size,range_mode,para_mode ? thread_count : 1);
+		fclose(file);
+		
+		/* the reason was already printed (or it was bad data) */
+		if(rc < 0){
+			return ERROR;
+		}else if(rc > 0){
+			printf(ERROR_BAD_DATA);
+			return ERROR;
+		}
+	}
+	
+	/* out of core files are binned from mapped windows, finding their
+	 * range first if it is not known */
+	else if(outcore_mode){
+		if(range_mode){
+			process_stats_range(graph,range_min,range_max);
+		}
+		rc = process_file_outcore(graph,file,size,range_mode,para_mode ? thread_count : 1,budget);
+		fclose(file);
+		
+		/* the reason was already printed (or it was bad data) */
+		if(rc < 0){
+			return ERROR;
+		}else if(rc > 0){
+			printf(ERROR_BAD_DATA);
+			return ERROR;
+		}
+	}
+	
+	/* files with a known range are binned while they are read
+	 * (unless we need all the data for a column file, integers, an
+	 * index, a sample, or to pick the bins) */
+	else if(file_mode && range_mode && !column_mode && !column_filename && !integer_mode && !index_mode && !sample_mode && !auto_bins){
+		process_stats_range(graph,range_min,range_max);
+		rc = process_file_pipelined(graph,file,size,para_mode ? thread_count : 1);
+		fclose(file);
+		
+		/* we had problems reading the file */
+		if(rc < 0){
+			printf(ERROR_UNKNOWN);
+			return ERROR;
+		}else if(rc > 0){
+			printf(ERROR_BAD_DATA);
+			return ERROR;
+		}
+	}else{
+		
+		/* in NUMA mode the binning threads also place the data */
+		place_count = (para_mode && numa_mode) ? thread_count : 1;
+		
+		/* create the data vector */
+		if(integer_mode){
+			if(rand_mode){
+				graph->data = create_vector_random_integers(size);
+			}else{
+				graph->data = create_vector_integers_from_file(file,size);
+			}
+		}else if(rand_mode){
+			if(place_count > 1){
+				graph->data = create_vector_random_parallel(size,place_count);
+			}else{
+				graph->data = create_vector_random(size);
+			}
+		}else if(column_mode){
+			graph->data = create_vector_from_columns(file,para_mode ? thread_count : 1);
+		}else{
+			graph->data = create_vector_from_file(file,size,place_count);
+		}
+		
+		/* close the file */
+		if(file_mode){
+			fclose(file);
+		}
+		
+		if(auto_mode && column_mode && graph->data){
+			thread_count = pick_thread_count(graph->data->size,bins_size,false);
+			para_mode = thread_count > 1;
+			print_status(TUNE_PICK_MSG,thread_count);
+		}
+		
+		/* save the data compressed for later runs */
+		if(column_filename && graph->data && save_vector_columns(graph->data,column_filename)){
+			printf(ERROR_COLUMN_SAVE,column_filename);
+		}
+		
+		/* setup the graph's bins (picking how many first, with auto) */
+		if(auto_bins){
+			if(range_mode){
+				graph->min = range_min;
+				graph->max = range_max;
+			}
+			rc = process_stats_auto(graph,para_mode ? thread_count : 1,range_mode);
+		}else if(range_mode){
+			process_stats_range(graph,range_min,range_max);
+			rc = graph->data ? SUCCESS : ERROR;
+		}else{
+			rc = process_stats(graph);
+		}
+		
+		/* we had problems setting the graph's bins */
+		if(rc < 0){
+			printf(ERROR_UNKNOWN);
+			return ERROR;
+		}else if(rc > 0){
+			printf(ERROR_NO_DATA);
+			return ERROR;
+		}
 		
 		/* We cant have more threads than amount of data */
-		if(thread_count > graph->data->size){
+		if(para_mode && thread_count > graph->data->size){
 			printf(ERROR_TOO_MANY_THREADS,thread_count,graph->data->size);
 			return ERROR;
 		}
 		
-		process_data_parallel(graph,thread_count,verb_mode);
-	}else{
-		process_data_serial(graph);
+		/* build the sketch, save it, and answer from it like later runs */
+		if(sketch_mode){
+			print_status(H_SK_MSG,sketch_filename);
+			sk = build_sketch(graph,thread_count);
+			
+			if(save_sketch(sk,sketch_filename,&data_stamp)){
+				printf(ERROR_SKETCH_SAVE,sketch_filename);
+			}
+			
+			rebin_sketch(sk,graph);
+		}
+		
+		/* sort the data into an index, save it, and answer from it */
+		else if(index_mode){
+			print_status(H_IX_MSG,index_filename);
+			ix = build_index(graph->data,para_mode ? thread_count : 1);
+			
+			if(save_index(ix,index_filename,&data_stamp)){
+				printf(ERROR_INDEX_SAVE,index_filename);
+			}
+			
+			bin_index(ix,graph);
+		}
+		
+		/* bin a random sample, of the given fraction or of the one
+		 * for the given error */
+		else if(sample_mode){
+			if(sample_error > 0){
+				sample_fraction = pick_sample_fraction(graph->data->size,graph->bin_count,sample_error);
+			}
+			process_data_sampled(graph,para_mode ? thread_count : 1,sample_fraction);
+		}
+		
+		/* parallization mode */
+		else if(para_mode){
+			process_data_parallel(graph,thread_count,verb_mode,numa_mode,chunk_size);
+		}else{
+			process_data_serial(graph);
+		}
 	}
 	
-	/* print results */
-	print_bins(graph);
+	/* save the counts to be merged with other shards later */
+	if(shard_filename){
+		size = sk ? sk->data_count : ix ? ix->count + ix->nan_count : graph->data ? graph->data->size : size;
+		if(save_shard(graph,size,shard_filename)){
+			printf(ERROR_SHARD_SAVE,shard_filename);
+		}
+	}
 	
+	/* print results (to the screen unless given a file) */
+	if(write_output(graph,groups,out_format,out_filename,thread_count)){
+		return ERROR;
+	}
+	
+	delete_group_set(groups);
 	delete_histogram(graph);
+	if(sketch_mode){
+		delete_sketch(sk);
+		free(sketch_filename);
+	}
+	if(index_mode){
+		delete_index(ix);
+		free(index_filename);
+	}
 	/*delete_vector(graph->data);*/
 	
 	return SUCCESS;
 }
+
+static int merge_main(int argc, char* argv[]){
+	unsigned long thread_count, sample_count, shard_count;
+	int index;
+	histogram* graph;
+	OUTPUT_FORMAT out_format;
+	char* out_filename;
+	char* shard_filename;
+	char** shard_paths;
+	
+	thread_count = 1;
+	out_format = FORMAT_TEXT;
+	out_filename = NULL;
+	shard_filename = NULL;
+	shard_paths = malloc(argc*sizeof(char*));
+	shard_count = 0;
+	
+	/* parse all arguments (after the subcommand) */
+	index = 1;
+	while(index < argc){
+		
+		/* flags that need a following argument */
+		if((strcmp(argv[index],PARA_FLAG)==0 || strcmp(argv[index],FORM_FLAG)==0
+			|| strcmp(argv[index],OUTF_FLAG)==0 || strcmp(argv[index],SHRD_FLAG)==0) && argc-index < 2){
+			printf(BAD_ARGS_MESSAGE,argv[index]);
+			free(shard_paths);
+			return ERROR;
+		}
+		
+		/* we found parallel flag */
+		if(strcmp(argv[index],PARA_FLAG)==0){
+			if(sscanf(argv[index+1],"%lu",&thread_count) < 1 || thread_count < 1){
+				printf(BAD_NUM_MESSAGE,PARA_FLAG);
+				free(shard_paths);
+				return ERROR;
+			}
+			index += 2;
+		}
+		
+		/* we found output format flag */
+		else if(strcmp(argv[index],FORM_FLAG)==0){
+			if(parse_output_format(argv[index+1],&out_format)){
+				printf(BAD_FORM_MESSAGE,argv[index+1]);
+				free(shard_paths);
+				return ERROR;
+			}
+			index += 2;
+		}
+		
+		/* we found output file flag */
+		else if(strcmp(argv[index],OUTF_FLAG)==0){
+			out_filename = argv[index+1];
+			index += 2;
+		}
+		
+		/* we found shard file flag */
+		else if(strcmp(argv[index],SHRD_FLAG)==0){
+			shard_filename = argv[index+1];
+			index += 2;
+		}
+		
+		/* we found quiet flag */
+		else if(strcmp(argv[index],QUIE_FLAG)==0){
+			set_quiet_mode(true);
+			index += 1;
+		}
+		
+		/* no flags means a shard */
+		else{
+			shard_paths[shard_count++] = argv[index];
+			index += 1;
+		}
+	}
+	
+	if(shard_count < 1){
+		printf(ERROR_NO_SHARDS,MERGE_CMD);
+		free(shard_paths);
+		return ERROR;
+	}
+	
+	print_status(MERGE_MSG,shard_count,thread_count);
+	graph = merge_shards(shard_paths,shard_count,thread_count,&sample_count);
+	free(shard_paths);
+	
+	/* the reason was already printed */
+	if(!graph){
+		return ERROR;
+	}
+	
+	/* the merged shard can be merged again */
+	if(shard_filename && save_shard(graph,sample_count,shard_filename)){
+		printf(ERROR_SHARD_SAVE,shard_filename);
+	}
+	
+	if(write_output(graph,NULL,out_format,out_filename,thread_count)){
+		return ERROR;
+	}
+	
+	delete_histogram(graph);
+	return SUCCESS;
+}
+
+static int range_main(int argc, char* argv[]){
+	int index, rc;
+	double min, max;
+	FILE* out;
+	char* out_filename;
+	
+	/* an output file may come before the data files */
+	index = 1;
+	out_filename = NULL;
+	if(index < argc && strcmp(argv[index],OUTF_FLAG)==0){
+		if(argc-index < 2){
+			printf(BAD_OUTF_MESSAGE,OUTF_FLAG);
+			return ERROR;
+		}
+		out_filename = argv[index+1];
+		index += 2;
+	}
+	
+	if(index >= argc){
+		printf(ERROR_NO_SHARDS,RANGE_CMD);
+		return ERROR;
+	}
+	
+	/* the range file goes to the screen, so it must be all that does
+	 * (like `range a b > r.range`) */
+	if(!out_filename){
+		set_quiet_mode(true);
+	}
+	
+	rc = find_shard_range(argv+index,argc-index,&min,&max);
+	
+	/* we had problems finding the range */
+	if(rc < 0){
+		return ERROR;
+	}else if(rc > 0){
+		printf(ERROR_NO_DATA);
+		return ERROR;
+	}
+	
+	/* write the range (to the screen unless given a file) */
+	out = out_filename ? fopen(out_filename,WRITE_ONLY) : stdout;
+	if(!out){
+		printf(ERROR_OUTPUT_FILE,out_filename);
+		return ERROR;
+	}
+	
+	fprintf(out,RANGE_FORMAT,min,max);
+	
+	if(out_filename && fclose(out)){
+		printf(ERROR_OUTPUT);
+		return ERROR;
+	}
+	
+	return SUCCESS;
+}
+
+static int write_output(histogram* graph, group_set* groups, OUTPUT_FORMAT format, const char* out_filename, unsigned long thread_count){
+	int out_fd, rc;
+	
+	if(out_filename){
+		out_fd = open(out_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(out_fd < 0){
+			printf(ERROR_OUTPUT_FILE,out_filename);
+			return ERROR;
+		}
+	}else{
+		out_fd = STDOUT_FILENO;
+	}
+	
+	rc = groups ? write_groups(groups,format,out_fd) : write_histogram(graph,format,out_fd,thread_count);
+	
+	if(out_filename){
+		close(out_fd);
+	}
+	
+	/* we had problems writing the results */
+	if(rc){
+		printf(ERROR_OUTPUT);
+		return ERROR;
+	}
+	
+	return SUCCESS;
+}
@@ -0,0 +1,164 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Memory functions allocate the big arrays used by vectors and
+ * histograms.
+ *
+ * Every block has a one cache line header in front of it that
+ * remembers how the block was allocated, so free_block knows whether
+ * to free or munmap it.
+ */
+
+#define _GNU_SOURCE /* for MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "memory.h"
+#include "config.h"
+
+/*	TYPES	==========================================================*/
+
+/* how a block was allocated */
+typedef enum{
+	BLOCK_HEAP = 0,
+	BLOCK_MAPPED = 1
+}BLOCK_KIND;
+
+/* the header in front of every block */
+typedef struct{
+	BLOCK_KIND kind; /* how the block was allocated */
+	void* base; /* the start of the allocation */
+	size_t mapped_size; /* the size of the mapping (mapped blocks only) */
+}block_header;
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* true to try MAP_HUGETLB for big blocks */
+static bool explicit_huge;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Maps a HUGE_PAGE_SIZE aligned block big enough for size bytes plus
+ * the header
+ *
+ * @returns the start of the header, or NULL if it could not be mapped
+ */
+static void* map_block(size_t size, size_t* mapped_size);
+
+/**
+ * @returns value rounded up to a multiple of alignment
+ * (alignment must be a power of two)
+ */
+static size_t round_up(size_t value, size_t alignment);
+
+/*	FUNCTIONS	======================================================*/
+
+void* alloc_block(size_t size){
+	block_header* header;
+	size_t mapped_size;
+	void* base;
+
+	/* pad to whole cache lines */
+	size = round_up(size > 0 ? size : 1, CACHE_LINE_SIZE);
+
+	if(size >= HUGE_PAGE_MIN){
+		base = map_block(size, &mapped_size);
+		if(!base){
+			return NULL;
+		}
+		header = (block_header*) base;
+		header->kind = BLOCK_MAPPED;
+		header->mapped_size = mapped_size;
+	}else{
+		if(posix_memalign(&base, CACHE_LINE_SIZE, size + CACHE_LINE_SIZE)){
+			return NULL;
+		}
+		header = (block_header*) base;
+		header->kind = BLOCK_HEAP;
+		header->mapped_size = 0;
+	}
+	header->base = base;
+
+	/* the block starts one cache line after the header */
+	return (char*)base + CACHE_LINE_SIZE;
+}
+
+unsigned long* alloc_counters(unsigned long count){
+	unsigned long* counters;
+	size_t size;
+
+	size = round_up((count > 0 ? count : 1)*sizeof(unsigned long), CACHE_LINE_SIZE);
+	counters = alloc_block(size);
+
+	/* mapped blocks are already zero (and untouched) */
+	if(counters && size < HUGE_PAGE_MIN){
+		memset(counters, 0, size);
+	}
+
+	return counters;
+}
+
+void free_block(void* block){
+	block_header* header;
+
+	if(block){
+		header = (block_header*)((char*)block - CACHE_LINE_SIZE);
+		if(header->kind == BLOCK_MAPPED){
+			munmap(header->base, header->mapped_size);
+		}else{
+			free(header->base);
+		}
+	}
+}
+
+static void* map_block(size_t size, size_t* mapped_size){
+	char* base;
+	char* aligned;
+	size_t length, extra;
+
+	length = round_up(size + CACHE_LINE_SIZE, HUGE_PAGE_SIZE);
+
+	/* explicit huge pages come aligned already */
+	if(explicit_huge){
+		base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(base != MAP_FAILED){
+			*mapped_size = length;
+			return base;
+		}
+	}
+
+	/* map an extra huge page so we can trim to an aligned start */
+	base = mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED){
+		return NULL;
+	}
+
+	aligned = (char*) round_up((size_t)(uintptr_t)base, HUGE_PAGE_SIZE);
+
+	/* give back the unaligned head and the unused tail */
+	if(aligned > base){
+		munmap(base, aligned - base);
+	}
+	extra = (base + length + HUGE_PAGE_SIZE) - (aligned + length);
+	if(extra > 0){
+		munmap(aligned + length, extra);
+	}
+
+	/* ask for transparent huge pages (just a hint) */
+	madvise(aligned, length, MADV_HUGEPAGE);
+
+	*mapped_size = length;
+	return aligned;
+}
+
+static size_t round_up(size_t value, size_t alignment){
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void set_explicit_huge_pages(bool explicit_pages){
+	explicit_huge = explicit_pages;
+}
@@ -0,0 +1,62 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Memory functions allocate the big arrays used by vectors and
+ * histograms.
+ *
+ * Every block is CACHE_LINE_SIZE aligned (good for vector loads) and
+ * padded to a whole number of cache lines, so two blocks (like the
+ * loc_bin_counts of two threads) never share a cache line.
+ *
+ * Blocks of at least HUGE_PAGE_MIN bytes are mapped straight from the
+ * kernel, aligned to HUGE_PAGE_SIZE and backed by huge pages: either
+ * transparent huge pages (madvise(MADV_HUGEPAGE), the default) or
+ * explicit ones (MAP_HUGETLB) when enabled and available. Mapped blocks
+ * are not touched here, so their pages are still placed by whichever
+ * thread writes them first.
+ *
+ * Blocks must be freed with free_block
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Allocates a block of the given number of bytes (see top)
+ * The contents are NOT initialized
+ *
+ * @returns the block, or NULL if it could not be allocated
+ */
+void* alloc_block(size_t size);
+
+/**
+ * Allocates a block of count zeroed counters, padded to whole
+ * cache lines. Small blocks are zeroed by the calling thread and big
+ * ones come zeroed from the kernel, so either way the counters are
+ * placed on the node of the thread that touches them first.
+ *
+ * @returns the counters, or NULL if they could not be allocated
+ */
+unsigned long* alloc_counters(unsigned long count);
+
+/**
+ * Frees a block from alloc_block or alloc_counters
+ * Does nothing for NULL
+ */
+void free_block(void* block);
+
+/**
+ * Use explicit huge pages (MAP_HUGETLB) for big blocks when true,
+ * transparent huge pages when false (the default).
+ * Explicit huge pages fall back to transparent ones when the system
+ * has none reserved.
+ */
+void set_explicit_huge_pages(bool explicit_pages);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Moments functions keep the descriptive statistics of data
+ *
+ * A block is summed in two passes, which stay in cache since binning
+ * hands the moments blocks it just read (see count_bins_moments).
+ */
+
+#include <math.h>
+#include "moments.h"
+
+/*	FUNCTIONS	======================================================*/
+
+void add_moments(moments* stats, double* values, unsigned long count){
+	moments block;
+	unsigned long t;
+	double sum, distance;
+
+	/* the mean (and min and max) of the block */
+	block.count = 0;
+	block.min = HUGE_VAL;
+	block.max = -HUGE_VAL;
+	sum = 0;
+	for(t=0; t < count; t++){
+		if(isfinite(values[t])){
+			block.count += 1;
+			sum += values[t];
+			block.min = (values[t] < block.min) ? values[t] : block.min;
+			block.max = (values[t] > block.max) ? values[t] : block.max;
+		}
+	}
+	if(block.count == 0){
+		return;
+	}
+	block.mean = sum/block.count;
+
+	/* then the distances from it */
+	block.m2 = 0;
+	block.m3 = 0;
+	for(t=0; t < count; t++){
+		if(isfinite(values[t])){
+			distance = values[t] - block.mean;
+			block.m2 += distance*distance;
+			block.m3 += distance*distance*distance;
+		}
+	}
+
+	merge_moments(stats, &block);
+}
+
+double find_skewness(moments* stats){
+	if(stats->count == 0 || !(stats->m2 > 0)){
+		return 0;
+	}
+
+	return sqrt((double)stats->count)*stats->m3/pow(stats->m2, 1.5);
+}
+
+double find_variance(moments* stats){
+	if(stats->count < 2){
+		return 0;
+	}
+
+	return stats->m2/(stats->count - 1);
+}
+
+void merge_moments(moments* stats, moments* other){
+	double count_a, count_b, count, delta;
+
+	if(other->count == 0){
+		return;
+	}
+	if(stats->count == 0){
+		*stats = *other;
+		return;
+	}
+
+	/* the moments of both, around the mean of both */
+	count_a = stats->count;
+	count_b = other->count;
+	count = count_a + count_b;
+	delta = other->mean - stats->mean;
+
+	stats->m3 += other->m3
+		+ delta*delta*delta*count_a*count_b*(count_a - count_b)/(count*count)
+		+ 3*delta*(count_a*other->m2 - count_b*stats->m2)/count;
+	stats->m2 += other->m2 + delta*delta*count_a*count_b/count;
+	stats->mean += delta*count_b/count;
+	stats->count += other->count;
+
+	stats->min = (other->min < stats->min) ? other->min : stats->min;
+	stats->max = (other->max > stats->max) ? other->max : stats->max;
+}
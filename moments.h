@@ -0,0 +1,60 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Moments functions keep the descriptive statistics of data (count,
+ * mean, variance, skewness, min and max) while it is being binned, so
+ * they cost no extra pass over it.
+ *
+ * Values are added a block at a time: the mean of the block is found
+ * first, then the sums of the powers of the distances from it (so no
+ * big sums of squares cancel out), and the block is merged into the
+ * running moments. Moments of separate data (like the slices of two
+ * threads) merge exactly the same way (Chan et al.), so each thread
+ * keeps its own and they are merged like the bin counts.
+ *
+ * Only finite values are counted (NaNs and infinities would make every
+ * moment NaN). The variance is the sample variance (n-1) and the
+ * skewness is the population skewness (g1).
+ */
+
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+/*	TYPES	==========================================================*/
+
+/* the moments of some data (all zero is no data) */
+typedef struct{
+	unsigned long count; /* number of finite values */
+	double mean; /* their mean */
+	double m2; /* sum of the squared distances from the mean */
+	double m3; /* sum of the cubed distances from the mean */
+	double min; /* the min value (if count > 0) */
+	double max; /* the max value (if count > 0) */
+}moments;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Adds count values to the given moments (refer to top)
+ */
+void add_moments(moments* stats, double* values, unsigned long count);
+
+/**
+ * @returns the population skewness of the moments, 0 if all the
+ * 	values are the same (or there are none)
+ */
+double find_skewness(moments* stats);
+
+/**
+ * @returns the sample variance of the moments, 0 with fewer than 2
+ * 	values
+ */
+double find_variance(moments* stats);
+
+/**
+ * Merges the moments other into stats (other is left as it was)
+ */
+void merge_moments(moments* stats, moments* other);
+
+#endif
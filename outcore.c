@@ -0,0 +1,430 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Out of core functions bin text data files bigger than memory.
+ *
+ * Windows are mapped by the thread that parses them, so the threads
+ * never wait on each other until their regions are done. Pages are
+ * only read from the mapping, and a number is only handed to the
+ * parser when a space follows it in the mapping (which stops strtod),
+ * except for the last number of the file, which is parsed from a copy.
+ */
+
+#define _DEFAULT_SOURCE /* for madvise and posix_fadvise */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "histogram.h"
+#include "memory.h"
+#include "moments.h"
+#include "outcore.h"
+#include "parallel_helpers.h"
+#include "status.h"
+#include "vector.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* the bytes of the file one thread parses */
+typedef struct{
+	histogram* graph; /* the histogram being binned (shared) */
+	int fd; /* the data file */
+	size_t data_start; /* first byte after the header line */
+	size_t file_size; /* bytes in the file */
+	size_t start; /* first byte of the region */
+	size_t end; /* one past the last byte of the region */
+	size_t window; /* bytes mapped at a time */
+	unsigned long limit; /* most values to take */
+	bool binning; /* bin the values (or find their min and max) */
+	double* values; /* OUTCORE_CHUNK parsed values */
+	unsigned long* counts; /* local bin counts (when binning) */
+	moments stats; /* local moments (when binning, if graph->stats) */
+	unsigned long count; /* values taken */
+	double min; /* min of the values taken (when not binning) */
+	double max; /* max of the values taken (when not binning) */
+	int rc; /* RETURN_CODE of the region */
+}outcore_region;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * @returns true if c separates numbers
+ */
+static bool is_space(char c);
+
+/**
+ * Resets the region and parses it again, with at most limit values
+ */
+static void redo_region(outcore_region* region, unsigned long limit);
+
+/**
+ * Parses every region, one thread each
+ *
+ * USES RETURN_CODE
+ * @returns ERROR if a region could not be read, FAIL if one had
+ * 	something that is not a number, otherwise SUCCESS
+ */
+static int run_regions(outcore_region* regions, unsigned long thread_count);
+
+/**
+ * Parses a region window by window (thread function, outcore_region)
+ */
+static void* scan_region(void* data);
+
+/**
+ * Maps the bytes begin to stop of the file and parses the numbers that
+ * start in them (the first number of a region only if first, since it
+ * may belong to the region before)
+ *
+ * @param next set to the byte after the last number parsed
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the window was parsed
+ * 	FAIL if it had something that is not a number
+ * 	ERROR if it could not be mapped
+ */
+static int scan_window(outcore_region* region, size_t begin, size_t stop, bool first, size_t* next);
+
+/**
+ * Bins (or finds the min and max of) the first count parsed values
+ */
+static void take_values(outcore_region* region, unsigned long count);
+
+/**
+ * Finds the region the first size values end in, parses it again up
+ * to them, and drops the regions after it (for the next pass too)
+ *
+ * @returns the number of regions to keep
+ */
+static unsigned long trim_regions(outcore_region* regions, unsigned long thread_count, unsigned long size);
+
+/*	FUNCTIONS	======================================================*/
+
+static bool is_space(char c){
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+int process_file_outcore(histogram* graph, FILE* file, unsigned long size, bool has_range, unsigned long thread_count, unsigned long budget){
+	outcore_region* regions;
+	struct stat info;
+	size_t page, overhead, window, data_size;
+	unsigned long t, bin, kept;
+	double min, max;
+	int fd, rc;
+	long position;
+
+	/* only a regular file can be mapped */
+	fd = fileno(file);
+	position = ftell(file);
+	if(fstat(fd, &info) || !S_ISREG(info.st_mode) || position < 0){
+		printf(ERROR_OUTCORE_MAP, OUTC_FLAG);
+		return ERROR;
+	}
+
+	/* every thread keeps its counts, a chunk and a bit more than a window,
+	 * next to the bins of graph and the program itself */
+	page = sysconf(_SC_PAGESIZE);
+	overhead = OUTCORE_RESERVE + (thread_count + 1)*(graph->bin_count + REJECT_COUNT)*sizeof(unsigned long)
+		+ graph->bin_count*sizeof(double)
+		+ thread_count*(OUTCORE_CHUNK*sizeof(double) + OUTCORE_MAX_NUMBER + page);
+	window = (budget > overhead) ? (budget - overhead)/thread_count : 0;
+	window -= window % page;
+	if(window < OUTCORE_MIN_WINDOW){
+		printf(ERROR_OUTCORE_BUDGET, budget >> 20, thread_count, graph->bin_count);
+		return ERROR;
+	}
+
+	/* one region of the data per thread */
+	data_size = info.st_size - position;
+	regions = calloc(thread_count, sizeof(outcore_region));
+	for(t=0; t < thread_count; t++){
+		regions[t].graph = graph;
+		regions[t].fd = fd;
+		regions[t].data_start = position;
+		regions[t].file_size = info.st_size;
+		regions[t].start = position + calculate_start_index(t, thread_count, data_size);
+		regions[t].end = position + calculate_start_index(t+1, thread_count, data_size);
+		regions[t].window = window;
+		regions[t].limit = size;
+		regions[t].values = malloc(OUTCORE_CHUNK*sizeof(double));
+	}
+
+	/* without a range, a first pass finds it */
+	rc = SUCCESS;
+	if(!has_range){
+		print_status(H_MM_MSG);
+		rc = run_regions(regions, thread_count);
+		kept = trim_regions(regions, thread_count, size);
+		if(rc == ERROR){
+			printf(ERROR_OUTCORE_MAP, OUTC_FLAG);
+		}
+
+		min = HUGE_VAL;
+		max = -HUGE_VAL;
+		for(t=0; t < kept; t++){
+			if(regions[t].count > 0 && regions[t].min < min){
+				min = regions[t].min;
+			}
+			if(regions[t].count > 0 && regions[t].max > max){
+				max = regions[t].max;
+			}
+		}
+
+		/* no numbers at all (NaNs have no range either) */
+		if(rc == SUCCESS && process_stats_range(graph, min, max)){
+			printf(ERROR_NO_DATA);
+			rc = ERROR;
+		}
+	}
+
+	/* the binning pass */
+	if(rc == SUCCESS){
+		print_status(H_OC_MSG, window >> 20, thread_count);
+		for(t=0; t < thread_count; t++){
+			regions[t].binning = true;
+			regions[t].counts = alloc_bin_counts(graph->bin_count);
+		}
+		rc = run_regions(regions, thread_count);
+		kept = trim_regions(regions, thread_count, size);
+		if(rc == ERROR){
+			printf(ERROR_OUTCORE_MAP, OUTC_FLAG);
+		}
+
+		/* sum the local bin counts (and moments) into the histogram */
+		for(t=0; t < kept; t++){
+			for(bin=0; bin < graph->bin_count + REJECT_COUNT; bin++){
+				graph->bin_counts[bin] += regions[t].counts[bin];
+			}
+			if(graph->stats){
+				merge_moments(graph->stats, &regions[t].stats);
+			}
+		}
+	}
+
+	/* Delete what we dont need anymore */
+	for(t=0; t < thread_count; t++){
+		free(regions[t].values);
+		free_block(regions[t].counts);
+	}
+	free(regions);
+
+	return rc;
+}
+
+static void redo_region(outcore_region* region, unsigned long limit){
+	region->limit = limit;
+	region->count = 0;
+	region->min = HUGE_VAL;
+	region->max = -HUGE_VAL;
+	memset(&region->stats, 0, sizeof(moments));
+	if(region->counts){
+		memset(region->counts, 0, (region->graph->bin_count + REJECT_COUNT)*sizeof(unsigned long));
+	}
+
+	scan_region(region);
+}
+
+static int run_regions(outcore_region* regions, unsigned long thread_count){
+	pthread_t* threads;
+	unsigned long t;
+	int rc, thread_rc;
+
+	threads = malloc(thread_count*sizeof(pthread_t));
+
+	for(t=0; t < thread_count; t++){
+		regions[t].count = 0;
+		regions[t].min = HUGE_VAL;
+		regions[t].max = -HUGE_VAL;
+		memset(&regions[t].stats, 0, sizeof(moments));
+
+		thread_rc = pthread_create(&threads[t], NULL, scan_region, (void*)&regions[t]);
+
+		/* problem creating thread */
+		if(thread_rc){
+			printf(ERROR_THREAD_CR, thread_rc);
+			exit(ERROR);
+		}
+	}
+
+	rc = SUCCESS;
+	for(t=0; t < thread_count; t++){
+		thread_rc = pthread_join(threads[t], NULL);
+
+		/* error joining thread */
+		if(thread_rc){
+			printf(ERROR_THREAD_JN, thread_rc);
+			exit(ERROR);
+		}
+
+		/* not being able to read beats bad data */
+		if(regions[t].rc == ERROR || (regions[t].rc == FAIL && rc == SUCCESS)){
+			rc = regions[t].rc;
+		}
+	}
+
+	free(threads);
+	return rc;
+}
+
+static void* scan_region(void* data){
+	outcore_region* region;
+	size_t position, stop;
+	bool first;
+
+	region = (outcore_region*) data;
+	region->rc = SUCCESS;
+	position = region->start;
+	first = true;
+
+	while(position < region->end && region->count < region->limit && region->rc == SUCCESS){
+		stop = (region->end - position > region->window) ? position + region->window : region->end;
+		region->rc = scan_window(region, position, stop, first, &position);
+		first = false;
+	}
+
+	return NULL;
+}
+
+static int scan_window(outcore_region* region, size_t begin, size_t stop, bool first, size_t* next){
+	char tail[OUTCORE_MAX_NUMBER + 1];
+	char* map;
+	size_t map_start, map_end, length, piece_begin, piece_end, position, consumed;
+	unsigned long count, wanted;
+	bool at_end;
+	int rc;
+
+	/* from the page of the byte before (to see if a number goes on into
+	 * the window) to the end of a number that goes on past it */
+	map_start = (begin > region->data_start) ? begin - 1 : begin;
+	map_start -= map_start % sysconf(_SC_PAGESIZE);
+	map_end = (region->file_size - stop > OUTCORE_MAX_NUMBER) ? stop + OUTCORE_MAX_NUMBER : region->file_size;
+	length = map_end - map_start;
+
+	map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, region->fd, map_start);
+	if(map == MAP_FAILED){
+		return ERROR;
+	}
+	madvise(map, length, MADV_SEQUENTIAL);
+
+	/* a number that started before the region belongs to the region before */
+	piece_begin = begin;
+	if(first && begin > region->data_start && !is_space(map[begin - 1 - map_start])){
+		while(piece_begin < map_end && !is_space(map[piece_begin - map_start])){
+			piece_begin++;
+		}
+	}
+
+	/* and a number going on past the window belongs to this one */
+	piece_end = stop;
+	if(stop > begin && !is_space(map[stop - 1 - map_start])){
+		while(piece_end < map_end && !is_space(map[piece_end - map_start])){
+			piece_end++;
+		}
+	}
+	if(piece_begin > piece_end){
+		piece_begin = piece_end;
+	}
+
+	/* past the end of the file there is no space to stop the parser */
+	at_end = piece_end < region->file_size;
+	rc = SUCCESS;
+
+	/* a number longer than the extra bytes */
+	if(piece_end == map_end && at_end){
+		rc = FAIL;
+	}
+
+	position = piece_begin;
+	while(rc == SUCCESS && position < piece_end && region->count < region->limit){
+		wanted = region->limit - region->count;
+		if(wanted > OUTCORE_CHUNK){
+			wanted = OUTCORE_CHUNK;
+		}
+
+		rc = parse_values(map + (position - map_start), piece_end - position, at_end, region->values, wanted, &count, &consumed);
+		take_values(region, count);
+		position += consumed;
+
+		/* nothing left but spaces (or the last number of the file) */
+		if(count == 0){
+			break;
+		}
+	}
+
+	/* the last number of the file, parsed from a copy ending in '\0' */
+	if(rc == SUCCESS && !at_end && region->count < region->limit){
+		while(position < piece_end && is_space(map[position - map_start])){
+			position++;
+		}
+
+		length = piece_end - position;
+		if(length > OUTCORE_MAX_NUMBER){
+			rc = FAIL;
+		}else if(length > 0){
+			memcpy(tail, map + (position - map_start), length);
+			tail[length] = '\0';
+			rc = parse_values(tail, length, true, region->values, 1, &count, &consumed);
+			take_values(region, count);
+		}
+	}
+
+	/* done with the window, so its pages can go */
+	length = map_end - map_start;
+	madvise(map, length, MADV_DONTNEED);
+	posix_fadvise(region->fd, map_start, length, POSIX_FADV_DONTNEED);
+	munmap(map, length);
+
+	*next = piece_end;
+	return rc;
+}
+
+static void take_values(outcore_region* region, unsigned long count){
+	unsigned long t;
+
+	if(region->binning){
+		count_bins_moments(region->graph, region->values, count, region->counts,
+			region->graph->stats ? &region->stats : NULL);
+	}else{
+		for(t=0; t < count; t++){
+			if(region->values[t] < region->min){
+				region->min = region->values[t];
+			}
+			if(region->values[t] > region->max){
+				region->max = region->values[t];
+			}
+		}
+	}
+	region->count += count;
+}
+
+static unsigned long trim_regions(outcore_region* regions, unsigned long thread_count, unsigned long size){
+	unsigned long t, total;
+
+	/* the regions up to the one the first size values end in */
+	total = 0;
+	for(t=0; t < thread_count && total + regions[t].count <= size; t++){
+		total += regions[t].count;
+	}
+	if(t == thread_count){
+		return thread_count;
+	}
+
+	redo_region(&regions[t], size - total);
+
+	/* the later regions are skipped from now on */
+	total = t + 1;
+	for(t=total; t < thread_count; t++){
+		regions[t].limit = 0;
+	}
+	return total;
+}
@@ -0,0 +1,59 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Out of core functions bin text data files bigger than memory, without
+ * ever holding the data in a vector.
+ *
+ * The data of the file (after the header line) is split into one equal
+ * region of bytes per thread. Each thread walks its region in windows,
+ * mapping one window of the file at a time (madvise(MADV_SEQUENTIAL)
+ * so the kernel reads ahead), parsing it OUTCORE_CHUNK values at a time
+ * and dropping the window (MADV_DONTNEED, and out of the page cache)
+ * before mapping the next one. A number belongs to the region (or
+ * window) its first char is in, so windows are mapped with up to
+ * OUTCORE_MAX_NUMBER extra bytes to finish the last one.
+ *
+ * Passes:
+ * With a known range (from -r or the file header) the bins are set up
+ * first and the file is binned in one pass. Otherwise one pass finds the
+ * min and max of every region, and a second pass bins them.
+ *
+ * Memory budget:
+ * Every thread keeps its own counts (B + REJECT_COUNT counters) and a
+ * chunk of parsed values. What is left of the budget is split into the
+ * threads' windows, so the resident memory (windows included) stays
+ * under the budget however big the file is.
+ *
+ * Like other data files, values past the count in the header are
+ * ignored. Regions are binned without knowing where that count ends,
+ * so if a file turns out to have more values, the region it ends in is
+ * binned again up to it and the regions after it are dropped.
+ */
+
+#ifndef OUTCORE_H
+#define OUTCORE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "histogram.h"
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Bins up to size values of file (after the header line) with
+ * thread_count threads, keeping memory under budget bytes (see top).
+ * If has_range, assumes the bins of graph were already set up
+ * (process_stats_range), otherwise they are set up from the min and
+ * max of the data.
+ * graph->data is not used.
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the file was binned
+ * 	FAIL if the file contained something that is not a number
+ * 	ERROR if the budget is too small, the file could not be mapped or
+ * 		it had no data (messages will have already been printed out)
+ */
+int process_file_outcore(histogram* graph, FILE* file, unsigned long size, bool has_range, unsigned long thread_count, unsigned long budget);
+
+#endif
@@ -0,0 +1,863 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Output functions write a binned histogram in one of several formats
+ *
+ * Each range of bins is formatted into its own buffer (in parallel
+ * for huge histograms), and all of the buffers are written out
+ * together with writev.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "group.h"
+#include "histogram.h"
+#include "moments.h"
+#include "output.h"
+#include "sample.h"
+#include "config.h"
+#include "return_code.h"
+
+/* some systems do not tell us how many iovecs writev can take */
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/*	TYPES	==========================================================*/
+
+/* a growable buffer of formatted text */
+typedef struct{
+	char* text; /* the formatted chars */
+	size_t length; /* number of chars used */
+	size_t capacity; /* number of chars allocated */
+}out_buffer;
+
+/* a range of bins for a thread to format */
+typedef struct{
+	histogram* graph; /* the histogram being written (shared) */
+	OUTPUT_FORMAT format; /* the format to use */
+	unsigned long start; /* first bin to format */
+	unsigned long end; /* one past the last bin to format */
+	out_buffer buffer; /* the formatted bins */
+	int rc; /* RETURN_CODE of the formatting */
+}format_job;
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* powers of ten for fixed point formatting */
+static const unsigned long powers_of_ten[] = {
+	1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL,
+	10000000UL, 100000000UL, 1000000000UL, 10000000000UL,
+	100000000000UL, 1000000000000UL
+};
+
+/* two digit pairs, so we only divide once per two digits */
+static const char digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Appends the given chars to the buffer
+ * Assumes the buffer has room for them (see reserve_buffer)
+ */
+static void append_chars(out_buffer* buffer, const char* chars, size_t length);
+
+/**
+ * Appends the given value right aligned in a TEXT_COLUMN_WIDTH column
+ */
+static void append_column(out_buffer* buffer, const char* value, size_t length);
+
+/**
+ * Appends the given key, quoted for the given format
+ * Assumes the buffer has room for 6 chars per char of the key, plus 2
+ */
+static void append_key(out_buffer* buffer, const char* key, OUTPUT_FORMAT format);
+
+/**
+ * Appends the given bin in the given format to the buffer
+ */
+static void append_bin(out_buffer* buffer, histogram* graph, OUTPUT_FORMAT format, unsigned long bin);
+
+/**
+ * Thread function that formats a range of bins (format_job)
+ */
+static void* format_bins(void* data);
+
+/**
+ * format_double with printf, for values the fast way cannot round
+ *
+ * @returns the number of chars written to out
+ */
+static size_t format_double_printf(char* out, double value, int precision);
+
+/**
+ * Formats what comes after the bins: the json footer, or the rejected
+ * data and the moments (refer to output.h)
+ *
+ * @returns the number of chars written to out
+ */
+static size_t format_footer(char* out, histogram* graph, OUTPUT_FORMAT format);
+
+/**
+ * Appends the histogram of one key of groups (the entry'th) to the
+ * buffer (refer to write_groups)
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the histogram was formatted
+ * 	FAIL if the buffer could not be grown
+ */
+static int format_group(out_buffer* buffer, group_set* groups, unsigned long entry, OUTPUT_FORMAT format);
+
+/**
+ * Formats the histogram info that comes before the bins
+ *
+ * @returns the number of chars written to out
+ */
+static size_t format_header(char* out, histogram* graph, OUTPUT_FORMAT format);
+
+/**
+ * Formats the moments of the histogram in the given format (not binary),
+ * or nothing if it has none
+ *
+ * @returns the number of chars written to out
+ */
+static size_t format_moments(char* out, histogram* graph, OUTPUT_FORMAT format);
+
+/**
+ * Makes sure the buffer has room for at least extra more chars
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the buffer has room
+ * 	FAIL if the buffer could not be grown
+ */
+static int reserve_buffer(out_buffer* buffer, size_t extra);
+
+/**
+ * Writes all the given iovecs to the fd, retrying on partial writes
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if everything was written
+ * 	ERROR if writev failed
+ */
+static int write_vectors(int fd, struct iovec* vectors, int count);
+
+/*	FUNCTIONS	======================================================*/
+
+static void append_bin(out_buffer* buffer, histogram* graph, OUTPUT_FORMAT format, unsigned long bin){
+	char number[FLOAT_BUFFER_SIZE];
+	double lower;
+	unsigned long low, high;
+	size_t length;
+
+	/* the first bin starts at the min */
+	lower = (bin == 0) ? graph->min : graph->bin_maxes[bin-1];
+
+	/* sampled counts are estimates with an interval (see sample.h) */
+	low = high = 0;
+	if(graph->sample_fraction > 0){
+		find_sample_interval(graph, graph->bin_counts[bin], &low, &high);
+	}
+
+	switch(format){
+		case FORMAT_CSV:
+			buffer->length += format_unsigned(buffer->text+buffer->length, bin);
+			append_chars(buffer, ",", 1);
+			buffer->length += format_unsigned(buffer->text+buffer->length, graph->bin_counts[bin]);
+			append_chars(buffer, ",", 1);
+			buffer->length += format_exact(buffer->text+buffer->length, lower, format);
+			append_chars(buffer, ",", 1);
+			buffer->length += format_exact(buffer->text+buffer->length, graph->bin_maxes[bin], format);
+			if(graph->sample_fraction > 0){
+				append_chars(buffer, ",", 1);
+				buffer->length += format_unsigned(buffer->text+buffer->length, low);
+				append_chars(buffer, ",", 1);
+				buffer->length += format_unsigned(buffer->text+buffer->length, high);
+			}
+			append_chars(buffer, "\n", 1);
+			break;
+
+		case FORMAT_JSON:
+
+			/* every bin but the first is separated by a comma */
+			if(bin > 0){
+				append_chars(buffer, ",", 1);
+			}
+			append_chars(buffer, JSON_BIN_NUM, strlen(JSON_BIN_NUM));
+			buffer->length += format_unsigned(buffer->text+buffer->length, bin);
+			append_chars(buffer, JSON_BIN_COT, strlen(JSON_BIN_COT));
+			buffer->length += format_unsigned(buffer->text+buffer->length, graph->bin_counts[bin]);
+			append_chars(buffer, JSON_BIN_LOW, strlen(JSON_BIN_LOW));
+			buffer->length += format_exact(buffer->text+buffer->length, lower, format);
+			append_chars(buffer, JSON_BIN_MAX, strlen(JSON_BIN_MAX));
+			buffer->length += format_exact(buffer->text+buffer->length, graph->bin_maxes[bin], format);
+			if(graph->sample_fraction > 0){
+				append_chars(buffer, JSON_BIN_LOW_COT, strlen(JSON_BIN_LOW_COT));
+				buffer->length += format_unsigned(buffer->text+buffer->length, low);
+				append_chars(buffer, JSON_BIN_HIGH_COT, strlen(JSON_BIN_HIGH_COT));
+				buffer->length += format_unsigned(buffer->text+buffer->length, high);
+			}
+			append_chars(buffer, "}", 1);
+			break;
+
+		default:
+
+			/* same columns as BINS_DATA_MSG, but never cut off */
+			length = format_unsigned(number, bin);
+			append_column(buffer, number, length);
+			append_chars(buffer, " |", 2);
+			length = format_unsigned(number, graph->bin_counts[bin]);
+			append_column(buffer, number, length);
+			append_chars(buffer, " |", 2);
+			length = format_double(number, graph->bin_maxes[bin], TEXT_PRECISION);
+			append_column(buffer, number, length);
+			if(graph->sample_fraction > 0){
+				append_chars(buffer, " |", 2);
+				length = format_unsigned(number, low);
+				append_column(buffer, number, length);
+				append_chars(buffer, " |", 2);
+				length = format_unsigned(number, high);
+				append_column(buffer, number, length);
+			}
+			append_chars(buffer, "\n", 1);
+			break;
+	}
+}
+
+static void append_chars(out_buffer* buffer, const char* chars, size_t length){
+	memcpy(buffer->text+buffer->length, chars, length);
+	buffer->length += length;
+}
+
+static void append_column(out_buffer* buffer, const char* value, size_t length){
+	size_t t;
+
+	/* pad on the left like printf's %9 */
+	for(t=length; t < TEXT_COLUMN_WIDTH; t++){
+		buffer->text[buffer->length++] = ' ';
+	}
+	append_chars(buffer, value, length);
+}
+
+static void append_key(out_buffer* buffer, const char* key, OUTPUT_FORMAT format){
+	bool quoted;
+	size_t t;
+
+	switch(format){
+		case FORMAT_JSON:
+			append_chars(buffer, "\"", 1);
+			for(t=0; key[t]; t++){
+				if(key[t] == '"' || key[t] == '\\'){
+					buffer->text[buffer->length++] = '\\';
+					buffer->text[buffer->length++] = key[t];
+				}else if((unsigned char)key[t] < 0x20){
+					buffer->length += sprintf(buffer->text+buffer->length, JSON_CONTROL, (unsigned char)key[t]);
+				}else{
+					buffer->text[buffer->length++] = key[t];
+				}
+			}
+			append_chars(buffer, "\"", 1);
+			break;
+
+		case FORMAT_CSV:
+
+			/* quotes (doubled inside) only when the key needs them */
+			quoted = strpbrk(key, ",\"") != NULL;
+			if(quoted){
+				append_chars(buffer, "\"", 1);
+			}
+			for(t=0; key[t]; t++){
+				if(key[t] == '"'){
+					buffer->text[buffer->length++] = '"';
+				}
+				buffer->text[buffer->length++] = key[t];
+			}
+			if(quoted){
+				append_chars(buffer, "\"", 1);
+			}
+			break;
+
+		default:
+			append_chars(buffer, key, strlen(key));
+			break;
+	}
+}
+
+static void* format_bins(void* data){
+	format_job* job;
+	unsigned long t;
+
+	job = (format_job*) data;
+	job->rc = SUCCESS;
+
+	for(t=job->start; t < job->end; t++){
+
+		/* make sure we have room for one more bin */
+		if(reserve_buffer(&job->buffer, BIN_LINE_SIZE)){
+			job->rc = FAIL;
+			return NULL;
+		}
+
+		append_bin(&job->buffer, job->graph, job->format, t);
+	}
+
+	return NULL;
+}
+
+size_t format_double(char* out, double value, int precision){
+	char digits[FLOAT_BUFFER_SIZE];
+	unsigned long whole, fraction, scale;
+	double magnitude, scaled, remainder;
+	size_t length, digit_length;
+
+	magnitude = fabs(value);
+
+	/* the fast way below needs the whole part and the scaled fraction
+	 * to fit in exact integers, let printf deal with anything else */
+	if(!(magnitude < FIXED_POINT_LIMIT) || precision < 0 || precision > 12){
+		return format_double_printf(out, value, precision);
+	}
+
+	/* split into whole and fraction parts (the fraction is exact, and
+	 * scaling it is only off by its last bit) */
+	scale = powers_of_ten[precision];
+	whole = (unsigned long) magnitude;
+	scaled = (magnitude - (double)whole) * (double)scale;
+	fraction = (unsigned long) scaled;
+	remainder = scaled - (double)fraction;
+
+	/* too close to a half for that last bit not to matter, so only
+	 * printf rounds it right (like a tie, which it rounds to even) */
+	if(fabs(remainder - 0.5) < ROUNDING_MARGIN){
+		return format_double_printf(out, value, precision);
+	}
+
+	/* rounding the fraction may carry into the whole part */
+	if(remainder > 0.5){
+		fraction += 1;
+	}
+	if(fraction >= scale){
+		whole += 1;
+		fraction -= scale;
+	}
+
+	/* printf keeps the sign of values that round to zero (and -0) */
+	length = 0;
+	if(signbit(value)){
+		out[length++] = '-';
+	}
+	length += format_unsigned(out+length, whole);
+
+	if(precision > 0){
+		out[length++] = '.';
+
+		/* the fraction is zero padded up to the precision */
+		digit_length = format_unsigned(digits, fraction);
+		memset(out+length, '0', precision-digit_length);
+		length += precision-digit_length;
+		memcpy(out+length, digits, digit_length);
+		length += digit_length;
+	}
+
+	return length;
+}
+
+static size_t format_double_printf(char* out, double value, int precision){
+	int rc;
+
+	rc = snprintf(out, FLOAT_BUFFER_SIZE, "%.*f", precision < 0 ? 0 : precision, value);
+	return (rc < FLOAT_BUFFER_SIZE) ? (size_t)rc : FLOAT_BUFFER_SIZE-1;
+}
+
+size_t format_exact(char* out, double value, OUTPUT_FORMAT format){
+
+	/* json has no nan or inf */
+	if(format == FORMAT_JSON && !isfinite(value)){
+		memcpy(out, JSON_NULL, strlen(JSON_NULL));
+		return strlen(JSON_NULL);
+	}
+
+	return sprintf(out, EXACT_FORMAT, value);
+}
+
+static size_t format_footer(char* out, histogram* graph, OUTPUT_FORMAT format){
+	unsigned long* rejects;
+	size_t length;
+
+	rejects = graph->bin_counts + graph->bin_count;
+
+	/* json has the rejects and moments in its header */
+	if(format == FORMAT_JSON){
+		memcpy(out, JSON_FOOTER, strlen(JSON_FOOTER));
+		return strlen(JSON_FOOTER);
+	}
+
+	/* clean data has no rejects */
+	length = 0;
+	if(rejects[REJECT_UNDERFLOW] > 0 || rejects[REJECT_OVERFLOW] > 0 || rejects[REJECT_NAN] > 0){
+		length = sprintf(out, (format == FORMAT_CSV) ? REJECT_CSV : REJECT_TEXT,
+			rejects[REJECT_UNDERFLOW], rejects[REJECT_OVERFLOW], rejects[REJECT_NAN]);
+	}
+
+	/* exact counts need no note */
+	if(graph->sample_fraction > 0){
+		length += sprintf(out+length, (format == FORMAT_CSV) ? SAMPLE_CSV : SAMPLE_TEXT, graph->sample_fraction);
+	}
+
+	return length + format_moments(out+length, graph, format);
+}
+
+static int format_group(out_buffer* buffer, group_set* groups, unsigned long entry, OUTPUT_FORMAT format){
+	histogram graph;
+	unsigned long* rejects;
+	const char* key;
+	unsigned long t, kind;
+	size_t key_size;
+
+	/* the shared bins, with this key's counts */
+	graph = *groups->graph;
+	graph.bin_counts = groups->entries[entry].counts;
+	graph.stats = NULL;
+	rejects = graph.bin_counts + graph.bin_count;
+	key = groups->entries[entry].key;
+	key_size = 6*strlen(key) + 2;
+
+	if(reserve_buffer(buffer, key_size + BIN_LINE_SIZE*4)){
+		return FAIL;
+	}
+
+	switch(format){
+		case FORMAT_CSV:
+			for(t=0; t < graph.bin_count; t++){
+				if(reserve_buffer(buffer, key_size + BIN_LINE_SIZE)){
+					return FAIL;
+				}
+				append_key(buffer, key, format);
+				append_chars(buffer, ",", 1);
+				append_bin(buffer, &graph, format, t);
+			}
+
+			/* clean keys have no reject rows */
+			for(kind=0; kind < REJECT_COUNT; kind++){
+				if(rejects[kind] > 0){
+					if(reserve_buffer(buffer, key_size + BIN_LINE_SIZE)){
+						return FAIL;
+					}
+					append_key(buffer, key, format);
+					buffer->length += sprintf(buffer->text+buffer->length, GROUP_REJECT_CSV,
+						(kind == REJECT_UNDERFLOW) ? GROUP_UNDER : (kind == REJECT_OVERFLOW) ? GROUP_OVER : GROUP_NAN, rejects[kind]);
+				}
+			}
+			return SUCCESS;
+
+		case FORMAT_JSON:
+
+			/* every key but the first is separated by a comma */
+			if(entry > 0){
+				append_chars(buffer, ",", 1);
+			}
+			append_chars(buffer, JSON_GROUP_KEY, strlen(JSON_GROUP_KEY));
+			append_key(buffer, key, format);
+			append_chars(buffer, JSON_HEAD_UNDER, strlen(JSON_HEAD_UNDER));
+			buffer->length += format_unsigned(buffer->text+buffer->length, rejects[REJECT_UNDERFLOW]);
+			append_chars(buffer, JSON_HEAD_OVER, strlen(JSON_HEAD_OVER));
+			buffer->length += format_unsigned(buffer->text+buffer->length, rejects[REJECT_OVERFLOW]);
+			append_chars(buffer, JSON_HEAD_NAN, strlen(JSON_HEAD_NAN));
+			buffer->length += format_unsigned(buffer->text+buffer->length, rejects[REJECT_NAN]);
+			append_chars(buffer, JSON_HEAD_LIST, strlen(JSON_HEAD_LIST));
+			for(t=0; t < graph.bin_count; t++){
+				if(reserve_buffer(buffer, BIN_LINE_SIZE)){
+					return FAIL;
+				}
+				append_bin(buffer, &graph, format, t);
+			}
+			if(reserve_buffer(buffer, 2)){
+				return FAIL;
+			}
+			append_chars(buffer, "]}", 2);
+			return SUCCESS;
+
+		default:
+
+			/* the key, then its table like a single histogram */
+			append_chars(buffer, GROUP_TEXT_KEY, strlen(GROUP_TEXT_KEY));
+			append_key(buffer, key, format);
+			append_chars(buffer, "\n", 1);
+			buffer->length += format_header(buffer->text+buffer->length, &graph, format);
+			for(t=0; t < graph.bin_count; t++){
+				if(reserve_buffer(buffer, BIN_LINE_SIZE)){
+					return FAIL;
+				}
+				append_bin(buffer, &graph, format, t);
+			}
+			if(reserve_buffer(buffer, BIN_LINE_SIZE*4)){
+				return FAIL;
+			}
+			buffer->length += format_footer(buffer->text+buffer->length, &graph, format);
+			append_chars(buffer, "\n", 1);
+			return SUCCESS;
+	}
+}
+
+static size_t format_header(char* out, histogram* graph, OUTPUT_FORMAT format){
+	const char* header;
+	size_t length;
+
+	switch(format){
+		case FORMAT_CSV:
+			header = (graph->sample_fraction > 0) ? SAMPLE_CSV_HEADER : CSV_HEADER;
+			length = strlen(header);
+			memcpy(out, header, length);
+			return length;
+
+		case FORMAT_JSON:
+			length = 0;
+			memcpy(out+length, JSON_HEAD_BINS, strlen(JSON_HEAD_BINS));
+			length += strlen(JSON_HEAD_BINS);
+			length += format_unsigned(out+length, graph->bin_count);
+			memcpy(out+length, JSON_HEAD_MIN, strlen(JSON_HEAD_MIN));
+			length += strlen(JSON_HEAD_MIN);
+			length += format_exact(out+length, graph->min, format);
+			memcpy(out+length, JSON_HEAD_MAX, strlen(JSON_HEAD_MAX));
+			length += strlen(JSON_HEAD_MAX);
+			length += format_exact(out+length, graph->max, format);
+			memcpy(out+length, JSON_HEAD_WIDTH, strlen(JSON_HEAD_WIDTH));
+			length += strlen(JSON_HEAD_WIDTH);
+			length += format_exact(out+length, graph->bin_width, format);
+			memcpy(out+length, JSON_HEAD_UNDER, strlen(JSON_HEAD_UNDER));
+			length += strlen(JSON_HEAD_UNDER);
+			length += format_unsigned(out+length, graph->bin_counts[graph->bin_count + REJECT_UNDERFLOW]);
+			memcpy(out+length, JSON_HEAD_OVER, strlen(JSON_HEAD_OVER));
+			length += strlen(JSON_HEAD_OVER);
+			length += format_unsigned(out+length, graph->bin_counts[graph->bin_count + REJECT_OVERFLOW]);
+			memcpy(out+length, JSON_HEAD_NAN, strlen(JSON_HEAD_NAN));
+			length += strlen(JSON_HEAD_NAN);
+			length += format_unsigned(out+length, graph->bin_counts[graph->bin_count + REJECT_NAN]);
+			length += format_moments(out+length, graph, format);
+			if(graph->sample_fraction > 0){
+				memcpy(out+length, JSON_HEAD_SAMPLE, strlen(JSON_HEAD_SAMPLE));
+				length += strlen(JSON_HEAD_SAMPLE);
+				length += format_exact(out+length, graph->sample_fraction, format);
+			}
+			memcpy(out+length, JSON_HEAD_LIST, strlen(JSON_HEAD_LIST));
+			length += strlen(JSON_HEAD_LIST);
+			return length;
+
+		default:
+			if(graph->sample_fraction > 0){
+				return sprintf(out, SAMPLE_BINS_MESSAGE, BINS_MSG_BIN, BINS_MSG_COT, BINS_MSG_MAX, BINS_MSG_LOW, BINS_MSG_HIGH);
+			}
+			return sprintf(out, BINS_MESSAGE, BINS_MSG_BIN, BINS_MSG_COT, BINS_MSG_MAX);
+	}
+}
+
+static size_t format_moments(char* out, histogram* graph, OUTPUT_FORMAT format){
+	char numbers[5][FLOAT_BUFFER_SIZE];
+	double values[5];
+	const char* line;
+	unsigned long t;
+
+	if(!graph->stats){
+		return 0;
+	}
+
+	/* json numbers are formatted first, so nan and inf become null */
+	if(format == FORMAT_JSON){
+		values[0] = graph->stats->mean;
+		values[1] = find_variance(graph->stats);
+		values[2] = find_skewness(graph->stats);
+		values[3] = graph->stats->min;
+		values[4] = graph->stats->max;
+		for(t=0; t < 5; t++){
+			numbers[t][format_exact(numbers[t], values[t], format)] = '\0';
+		}
+		return sprintf(out, JSON_MOMENTS, graph->stats->count, numbers[0], numbers[1], numbers[2], numbers[3], numbers[4]);
+	}
+
+	line = (format == FORMAT_CSV) ? MOMENTS_CSV : MOMENTS_TEXT;
+	return sprintf(out, line, graph->stats->count, graph->stats->mean, find_variance(graph->stats),
+		find_skewness(graph->stats), graph->stats->min, graph->stats->max);
+}
+
+size_t format_unsigned(char* out, unsigned long value){
+	char digits[20];
+	size_t index, length;
+	unsigned long pair;
+
+	/* fill digits from the back, two at a time */
+	index = sizeof(digits);
+	while(value >= 100){
+		pair = (value % 100) * 2;
+		value /= 100;
+		digits[--index] = digit_pairs[pair+1];
+		digits[--index] = digit_pairs[pair];
+	}
+
+	/* last one or two digits */
+	if(value >= 10){
+		pair = value * 2;
+		digits[--index] = digit_pairs[pair+1];
+		digits[--index] = digit_pairs[pair];
+	}else{
+		digits[--index] = (char)('0' + value);
+	}
+
+	length = sizeof(digits) - index;
+	memcpy(out, digits+index, length);
+	return length;
+}
+
+int parse_output_format(const char* name, OUTPUT_FORMAT* format){
+	if(strcmp(name, FORM_TEXT)==0){
+		*format = FORMAT_TEXT;
+	}else if(strcmp(name, FORM_CSV)==0){
+		*format = FORMAT_CSV;
+	}else if(strcmp(name, FORM_JSON)==0){
+		*format = FORMAT_JSON;
+	}else if(strcmp(name, FORM_BINARY)==0){
+		*format = FORMAT_BINARY;
+	}else{
+		return FAIL;
+	}
+	return SUCCESS;
+}
+
+static int reserve_buffer(out_buffer* buffer, size_t extra){
+	size_t capacity;
+	char* text;
+
+	/* already have room */
+	if(buffer->length + extra <= buffer->capacity){
+		return SUCCESS;
+	}
+
+	/* double until it fits */
+	capacity = buffer->capacity > 0 ? buffer->capacity : OUTPUT_BUFFER_SIZE;
+	while(buffer->length + extra > capacity){
+		capacity *= 2;
+	}
+
+	text = realloc(buffer->text, capacity);
+	if(!text){
+		return FAIL;
+	}
+
+	buffer->text = text;
+	buffer->capacity = capacity;
+	return SUCCESS;
+}
+
+int write_groups(group_set* groups, OUTPUT_FORMAT format, int fd){
+	out_buffer buffer;
+	struct iovec vector;
+	unsigned long t;
+	int rc;
+
+	/* anything printed before us must come out first */
+	fflush(stdout);
+
+	memset(&buffer, 0, sizeof(out_buffer));
+	if(reserve_buffer(&buffer, BIN_LINE_SIZE*4)){
+		return FAIL;
+	}
+
+	/* the shared bins come first in csv and json */
+	if(format == FORMAT_CSV){
+		append_chars(&buffer, GROUP_CSV_HEADER, strlen(GROUP_CSV_HEADER));
+	}else if(format == FORMAT_JSON){
+		append_chars(&buffer, JSON_HEAD_BINS, strlen(JSON_HEAD_BINS));
+		buffer.length += format_unsigned(buffer.text+buffer.length, groups->graph->bin_count);
+		append_chars(&buffer, JSON_HEAD_MIN, strlen(JSON_HEAD_MIN));
+		buffer.length += format_exact(buffer.text+buffer.length, groups->graph->min, format);
+		append_chars(&buffer, JSON_HEAD_MAX, strlen(JSON_HEAD_MAX));
+		buffer.length += format_exact(buffer.text+buffer.length, groups->graph->max, format);
+		append_chars(&buffer, JSON_HEAD_WIDTH, strlen(JSON_HEAD_WIDTH));
+		buffer.length += format_exact(buffer.text+buffer.length, groups->graph->bin_width, format);
+		append_chars(&buffer, JSON_HEAD_GROUPS, strlen(JSON_HEAD_GROUPS));
+	}
+
+	/* written out whenever a good amount is formatted */
+	rc = SUCCESS;
+	for(t=0; t < groups->group_count && rc == SUCCESS; t++){
+		rc = format_group(&buffer, groups, t, format);
+
+		if(rc == SUCCESS && buffer.length >= GROUP_WRITE_SIZE){
+			vector.iov_base = buffer.text;
+			vector.iov_len = buffer.length;
+			rc = write_vectors(fd, &vector, 1);
+			buffer.length = 0;
+		}
+	}
+
+	if(rc == SUCCESS && format == FORMAT_JSON){
+		if(reserve_buffer(&buffer, strlen(JSON_FOOTER))){
+			rc = FAIL;
+		}else{
+			append_chars(&buffer, JSON_FOOTER, strlen(JSON_FOOTER));
+		}
+	}
+
+	if(rc == SUCCESS){
+		vector.iov_base = buffer.text;
+		vector.iov_len = buffer.length;
+		rc = write_vectors(fd, &vector, 1);
+	}
+
+	free(buffer.text);
+	return rc;
+}
+
+int write_histogram(histogram* graph, OUTPUT_FORMAT format, int fd, unsigned long thread_count){
+	char header[BIN_LINE_SIZE*4];
+	char footer[BIN_LINE_SIZE*4];
+	binary_header bin_header;
+	struct iovec* vectors;
+	format_job* jobs;
+	pthread_t* threads;
+	unsigned long job_count, t;
+	int rc, vector_count;
+
+	/* anything printed before us must come out first */
+	fflush(stdout);
+
+	/* binary output is written straight from the histogram arrays */
+	if(format == FORMAT_BINARY){
+		struct iovec bin_vectors[3];
+
+		memcpy(bin_header.magic, BIN_MAGIC, sizeof(bin_header.magic));
+		bin_header.version = BIN_VERSION;
+		bin_header.bin_count = graph->bin_count;
+		bin_header.min = graph->min;
+		bin_header.max = graph->max;
+		memcpy(bin_header.rejects, graph->bin_counts + graph->bin_count, sizeof(bin_header.rejects));
+		memset(&bin_header.stats, 0, sizeof(bin_header.stats));
+		if(graph->stats){
+			bin_header.stats.count = graph->stats->count;
+			bin_header.stats.mean = graph->stats->mean;
+			bin_header.stats.variance = find_variance(graph->stats);
+			bin_header.stats.skewness = find_skewness(graph->stats);
+			bin_header.stats.min = graph->stats->min;
+			bin_header.stats.max = graph->stats->max;
+		}
+		bin_header.sample_fraction = graph->sample_fraction;
+
+		bin_vectors[0].iov_base = &bin_header;
+		bin_vectors[0].iov_len = sizeof(bin_header);
+		bin_vectors[1].iov_base = graph->bin_counts;
+		bin_vectors[1].iov_len = graph->bin_count*sizeof(unsigned long);
+		bin_vectors[2].iov_base = graph->bin_maxes;
+		bin_vectors[2].iov_len = graph->bin_count*sizeof(double);
+
+		return write_vectors(fd, bin_vectors, 3);
+	}
+
+	/* only split the bins up when each thread gets enough of them */
+	job_count = 1;
+	if(thread_count > 1 && graph->bin_count / thread_count >= PARALLEL_FORMAT_MIN){
+		job_count = thread_count;
+	}
+
+	jobs = calloc(job_count, sizeof(format_job));
+	threads = malloc(job_count*sizeof(pthread_t));
+	vectors = malloc((job_count+2)*sizeof(struct iovec));
+
+	/* assign the bin ranges, the same way threads split the data */
+	for(t=0; t < job_count; t++){
+		jobs[t].graph = graph;
+		jobs[t].format = format;
+		jobs[t].start = (t * graph->bin_count) / job_count;
+		jobs[t].end = ((t+1) * graph->bin_count) / job_count;
+	}
+
+	/* the calling thread formats the first range */
+	for(t=1; t < job_count; t++){
+		rc = pthread_create(&threads[t], NULL, format_bins, (void*)&jobs[t]);
+		if(rc){
+			printf(ERROR_THREAD_CR, rc);
+			exit(ERROR);
+		}
+	}
+	format_bins((void*)&jobs[0]);
+	for(t=1; t < job_count; t++){
+		rc = pthread_join(threads[t], NULL);
+		if(rc){
+			printf(ERROR_THREAD_JN, rc);
+			exit(ERROR);
+		}
+	}
+
+	/* header, every range, then the footer */
+	vector_count = 0;
+	vectors[vector_count].iov_base = header;
+	vectors[vector_count++].iov_len = format_header(header, graph, format);
+
+	rc = SUCCESS;
+	for(t=0; t < job_count; t++){
+		if(jobs[t].rc){
+			rc = FAIL;
+		}
+		vectors[vector_count].iov_base = jobs[t].buffer.text;
+		vectors[vector_count++].iov_len = jobs[t].buffer.length;
+	}
+
+	vectors[vector_count].iov_base = footer;
+	vectors[vector_count++].iov_len = format_footer(footer, graph, format);
+
+	/* write everything in one go */
+	if(rc == SUCCESS){
+		rc = write_vectors(fd, vectors, vector_count);
+	}
+
+	for(t=0; t < job_count; t++){
+		free(jobs[t].buffer.text);
+	}
+	free(jobs);
+	free(threads);
+	free(vectors);
+
+	return rc;
+}
+
+static int write_vectors(int fd, struct iovec* vectors, int count){
+	ssize_t written;
+
+	while(count > 0){
+
+		/* writev can only take so many at once */
+		written = writev(fd, vectors, count < IOV_MAX ? count : IOV_MAX);
+
+		if(written < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			return ERROR;
+		}
+
+		/* skip everything that was fully written */
+		while(count > 0 && (size_t)written >= vectors->iov_len){
+			written -= vectors->iov_len;
+			vectors++;
+			count--;
+		}
+
+		/* part of the next vector was written */
+		if(count > 0){
+			vectors->iov_base = (char*)vectors->iov_base + written;
+			vectors->iov_len -= written;
+		}
+	}
+
+	return SUCCESS;
+}
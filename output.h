@@ -0,0 +1,155 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Output functions write a binned histogram in one of several formats
+ *
+ * All output is formatted into large in-memory buffers with custom
+ * integer and fixed point formatters (the text table is the same as
+ * printf's %lf), then handed to the given file descriptor with a single
+ * writev call. Bounds in csv and json are written with EXACT_FORMAT, so
+ * they read back as the same doubles, and json has null for nan and inf.
+ *
+ * Formats:
+ * text		The bin table printed by print_bins (without width limits)
+ * csv		bin,count,lower_bound,upper_bound
+ * json		one object with the histogram info and a list of bins
+ * binary	raw header, bin counts and bin upper bounds (native endian)
+ *
+ * Group sets (see group.h) are written one key at a time, in key order:
+ * text		"Key: KEY", then the bin table of the key
+ * csv		key,bin,count,lower_bound,upper_bound (and key,underflow,N,,
+ * 		like rows for the rejects of a key)
+ * json		one object with the shared bins info and a list of groups, each
+ * 		with its key, rejects and bins
+ * There is no binary format for them.
+ *
+ * Rejected data (see histogram.h) is in the json and binary headers.
+ * Text and csv only add it after the bins when something was rejected
+ * (csv as underflow, overflow and nan rows), so clean data looks the
+ * same as always.
+ *
+ * Sampled histograms (see sample.h) also have the 95% interval of every
+ * estimated count: as count_low and count_high columns in csv (and a
+ * sample_fraction row after the bins), count_low and count_high fields
+ * of every bin and a sample_fraction field in json, two more columns
+ * and a note in text. The binary header always has the sample fraction,
+ * 0 for exact counts.
+ *
+ * Moments (see moments.h) are only written when the histogram has them:
+ * in the json header as a moments object, after the bins in text and
+ * csv (csv as count, mean, variance, skewness, min and max rows). The
+ * binary header always has them, all zero without them.
+ *
+ * Binary layout:
+ * <magic "HBIN"> <uint32 version> <uint64 bin_count> <double min>
+ * <double max> <uint64 underflow> <uint64 overflow> <uint64 nan>
+ * <uint64 count> <double mean> <double variance> <double skewness>
+ * <double data min> <double data max> <double sample fraction>
+ * <uint64 counts[bin_count]> <double upper_bounds[bin_count]>
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include "group.h"
+#include "histogram.h"
+
+/*	TYPES	==========================================================*/
+
+/* the supported output formats */
+typedef enum{
+	FORMAT_TEXT = 0,
+	FORMAT_CSV = 1,
+	FORMAT_JSON = 2,
+	FORMAT_BINARY = 3
+}OUTPUT_FORMAT;
+
+/* moments in the binary output format */
+typedef struct{
+	unsigned long count; /* values in the moments (0 without them) */
+	double mean; /* their mean */
+	double variance; /* their sample variance */
+	double skewness; /* their population skewness */
+	double min; /* the min value */
+	double max; /* the max value */
+}binary_moments;
+
+/* header of the binary output format */
+typedef struct{
+	char magic[4]; /* always BIN_MAGIC */
+	unsigned int version; /* BIN_VERSION */
+	unsigned long bin_count; /* number of bins that follow */
+	double min; /* the min value of the histogram */
+	double max; /* the max value of the histogram */
+	unsigned long rejects[REJECT_COUNT]; /* data outside the bins, by REJECT_KIND */
+	binary_moments stats; /* moments of the data (refer to top) */
+	double sample_fraction; /* fraction of the data binned, 0 if exact (refer to top) */
+}binary_header;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Writes the given double into out as fixed point with the given
+ * number of decimals, the same as printf's %.*f (correctly rounded).
+ * Most values are formatted without printf, the rest (huge values, or
+ * fractions too close to a half to round safely) with it.
+ * out must have room for at least FLOAT_BUFFER_SIZE chars
+ *
+ * @returns the number of chars written (no null terminator is written)
+ */
+size_t format_double(char* out, double value, int precision);
+
+/**
+ * Writes the given double into out so it reads back as the same double
+ * (EXACT_FORMAT), for csv and json. Json has no nan or inf, so those
+ * are written as null in the json format.
+ * out must have room for at least FLOAT_BUFFER_SIZE chars
+ *
+ * @returns the number of chars written (no null terminator is written)
+ */
+size_t format_exact(char* out, double value, OUTPUT_FORMAT format);
+
+/**
+ * Writes the given unsigned value into out as decimal digits
+ * out must have room for at least 20 chars
+ *
+ * @returns the number of chars written (no null terminator is written)
+ */
+size_t format_unsigned(char* out, unsigned long value);
+
+/**
+ * Converts the given format name (text, csv, json, binary) to its
+ * OUTPUT_FORMAT
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the name was a known format
+ * 	FAIL if the name was not a known format
+ */
+int parse_output_format(const char* name, OUTPUT_FORMAT* format);
+
+/**
+ * Writes the given histogram to the given file descriptor using the
+ * given format. With more than one thread and enough bins, ranges of
+ * bins are formatted in parallel.
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the whole histogram was written
+ * 	FAIL if the output could not be allocated
+ * 	ERROR if writing to the file descriptor failed
+ */
+int write_histogram(histogram* graph, OUTPUT_FORMAT format, int fd, unsigned long thread_count);
+
+/**
+ * Writes the histogram of every key of groups to the given file
+ * descriptor using the given format (not binary, refer to top)
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if every histogram was written
+ * 	FAIL if the output could not be allocated
+ * 	ERROR if writing to the file descriptor failed
+ */
+int write_groups(group_set* groups, OUTPUT_FORMAT format, int fd);
+
+#endif
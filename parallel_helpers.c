@@ -5,8 +5,33 @@
  * These functions help parallel methods to their stuff
  */
 
+#define _GNU_SOURCE /* for CPU affinity */
+
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include "parallel_helpers.h"
+#include "return_code.h"
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* the CPUs the process was allowed to use before any thread was pinned */
+static cpu_set_t allowed_cpus;
+
+/* RETURN_CODE of reading allowed_cpus */
+static int allowed_cpus_rc;
+
+/* makes sure allowed_cpus is only read once */
+static pthread_once_t allowed_cpus_once = PTHREAD_ONCE_INIT;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Reads the allowed CPUs of the calling thread into allowed_cpus
+ * Threads inherit their creator's affinity, so this has to happen
+ * before the first thread pins itself.
+ */
+static void load_allowed_cpus(void);
 
 /*	FUNCTIONS	======================================================*/
 
@@ -36,6 +61,24 @@ unsigned int calculate_thread_spawn_size(unsigned long divisor, unsigned long th
 	}
 }
 
+bool claim_chunk(unsigned long* cursor, unsigned long chunk_size, unsigned long size, unsigned long* start, unsigned long* end){
+	
+	/* the cursor only has to be atomic, not ordered with anything */
+	*start = __atomic_load_n(cursor, __ATOMIC_RELAXED);
+	do{
+		
+		/* someone already took the last chunk */
+		if(*start >= size){
+			return false;
+		}
+		
+		/* never move the cursor past size (so it cannot wrap) */
+		*end = (chunk_size < size - *start) ? *start + chunk_size : size;
+	}while(!__atomic_compare_exchange_n(cursor, start, *end, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	
+	return true;
+}
+
 int find_larger_power_of_two(int value){
 	return (int) pow(2,find_largest_expo_of_two(value));
 }
@@ -52,6 +95,47 @@ int find_smallest_expo_of_two(int value){
 	return (int) floor(log_base(value, 2));
 }
 
+static void load_allowed_cpus(void){
+	if(sched_getaffinity(0, sizeof(cpu_set_t), &allowed_cpus)){
+		allowed_cpus_rc = ERROR;
+	}else{
+		allowed_cpus_rc = SUCCESS;
+	}
+}
+
 double log_base(double value, double base){
 	return log(value) / log(base);
 }
+
+int pin_thread(unsigned long thread_id){
+	cpu_set_t target;
+	unsigned long index;
+	int cpu, cpu_count;
+	
+	/* the first thread here reads the CPUs before pinning itself */
+	pthread_once(&allowed_cpus_once, load_allowed_cpus);
+	
+	cpu_count = CPU_COUNT(&allowed_cpus);
+	if(allowed_cpus_rc || cpu_count < 1){
+		return ERROR;
+	}
+	
+	/* find the (thread_id % cpu_count)th allowed cpu */
+	index = thread_id % cpu_count;
+	for(cpu=0; cpu < CPU_SETSIZE; cpu++){
+		if(CPU_ISSET(cpu, &allowed_cpus)){
+			if(index == 0){
+				break;
+			}
+			index -= 1;
+		}
+	}
+	
+	CPU_ZERO(&target);
+	CPU_SET(cpu, &target);
+	
+	if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &target)){
+		return ERROR;
+	}
+	return SUCCESS;
+}
@@ -8,8 +8,19 @@
 #ifndef P_HELP_H
 #define P_HELP_H
 
+#include <stdbool.h>
+
 /*	FUNCTIONS	======================================================*/
 
+/**
+ * Atomically claims the next chunk_size (or fewer, at the end) indexes
+ * from the shared cursor. The claimed range is start to end-1.
+ * The cursor never moves past size, so any chunk_size is safe.
+ * 
+ * @returns true if a chunk was claimed, false if the cursor passed size
+ */
+bool claim_chunk(unsigned long* cursor, unsigned long chunk_size, unsigned long size, unsigned long* start, unsigned long* end);
+
 /**
  *	@returns the index the given thread will stop at
  */
@@ -55,4 +66,16 @@ int find_smallest_expo_of_two(int value);
  */
 double log_base(double value, double base);
 
+/**
+ * Pins the calling thread to one CPU, picked from the CPUs this process
+ * was allowed to run on (thread_id modulo the number of those CPUs).
+ * Consecutive thread ids land on consecutive CPUs, which keeps the
+ * threads of neighbouring slices on the same NUMA node.
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the thread was pinned
+ * 	ERROR if the affinity could not be read or set
+ */
+int pin_thread(unsigned long thread_id);
+
 #endif
@@ -0,0 +1,340 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Pipeline functions bin a data file while it is still being read.
+ *
+ * The ring keeps two queues of block indexes: free blocks for the
+ * reader to fill, and full blocks for the binning threads. A block is
+ * owned by exactly one side at a time, so only the queues are locked.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "histogram.h"
+#include "memory.h"
+#include "moments.h"
+#include "pipeline.h"
+#include "reader.h"
+#include "status.h"
+#include "vector.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* a queue of block indexes */
+typedef struct{
+	unsigned long slots[PIPE_RING_SIZE]; /* the queued block indexes */
+	unsigned long head; /* index of the first queued slot */
+	unsigned long count; /* number of queued slots */
+}block_queue;
+
+/* the blocks shared between the reader and the binning threads */
+typedef struct{
+	double* blocks[PIPE_RING_SIZE]; /* PIPE_BLOCK_SIZE values each */
+	unsigned long counts[PIPE_RING_SIZE]; /* values used in each block */
+	block_queue free_blocks; /* blocks the reader can fill */
+	block_queue full_blocks; /* blocks waiting to be binned */
+	bool done; /* true once the reader will not fill any more blocks */
+	pthread_mutex_t lock; /* guards both queues and done */
+	pthread_cond_t has_free; /* signaled when a block is freed */
+	pthread_cond_t has_full; /* signaled when a block is filled (or done) */
+}block_ring;
+
+/* a binning thread */
+typedef struct{
+	histogram* graph; /* the histogram being binned (shared) */
+	block_ring* ring; /* where the blocks come from (shared) */
+	unsigned long* loc_bin_counts; /* local bin counts for this thread */
+	moments loc_stats; /* local moments for this thread (if graph->stats) */
+}pipe_binner;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Thread function that bins full blocks until the reader is done
+ * (pipe_binner)
+ */
+static void* bin_blocks(void* data);
+
+/**
+ * Removes and returns the first block index of the queue
+ * Assumes the queue is not empty
+ */
+static unsigned long pop_block(block_queue* queue);
+
+/**
+ * Adds the given block index to the end of the queue
+ */
+static void push_block(block_queue* queue, unsigned long block);
+
+/**
+ * Hands a filled block to the binning threads
+ */
+static void put_full_block(block_ring* ring, unsigned long block, unsigned long count);
+
+/**
+ * Reads and parses the file into blocks until size values were read
+ * or the file ends
+ *
+ * USES RETURN_CODE
+ * @returns same codes as process_file_pipelined
+ */
+static int read_blocks(block_ring* ring, FILE* file, unsigned long size);
+
+/**
+ * Waits for a free block for the reader
+ *
+ * @returns the index of the free block
+ */
+static unsigned long take_free_block(block_ring* ring);
+
+/*	FUNCTIONS	======================================================*/
+
+static void* bin_blocks(void* data){
+	pipe_binner* binner;
+	block_ring* ring;
+	unsigned long block;
+
+	binner = (pipe_binner*) data;
+	ring = binner->ring;
+
+	while(true){
+
+		/* wait for a full block (or for the reader to finish) */
+		pthread_mutex_lock(&ring->lock);
+		while(ring->full_blocks.count == 0 && !ring->done){
+			pthread_cond_wait(&ring->has_full, &ring->lock);
+		}
+
+		/* nothing left to bin */
+		if(ring->full_blocks.count == 0){
+			pthread_mutex_unlock(&ring->lock);
+			return NULL;
+		}
+
+		block = pop_block(&ring->full_blocks);
+		pthread_mutex_unlock(&ring->lock);
+
+		count_bins_moments(binner->graph, ring->blocks[block], ring->counts[block], binner->loc_bin_counts,
+			binner->graph->stats ? &binner->loc_stats : NULL);
+
+		/* give the block back to the reader */
+		pthread_mutex_lock(&ring->lock);
+		push_block(&ring->free_blocks, block);
+		pthread_cond_signal(&ring->has_free);
+		pthread_mutex_unlock(&ring->lock);
+	}
+}
+
+static unsigned long pop_block(block_queue* queue){
+	unsigned long block;
+
+	block = queue->slots[queue->head];
+	queue->head = (queue->head + 1) % PIPE_RING_SIZE;
+	queue->count -= 1;
+
+	return block;
+}
+
+int process_file_pipelined(histogram* graph, FILE* file, unsigned long size, unsigned long thread_count){
+	block_ring ring;
+	pipe_binner* binners;
+	pthread_t* threads;
+	unsigned long t, bin;
+	int rc, thread_rc;
+
+	/* print status message */
+	print_status(H_PL_MSG, thread_count);
+
+	/* every block starts out free */
+	memset(&ring, 0, sizeof(block_ring));
+	for(t=0; t < PIPE_RING_SIZE; t++){
+		ring.blocks[t] = alloc_block(PIPE_BLOCK_SIZE*sizeof(double));
+		push_block(&ring.free_blocks, t);
+	}
+	pthread_mutex_init(&ring.lock, NULL);
+	pthread_cond_init(&ring.has_free, NULL);
+	pthread_cond_init(&ring.has_full, NULL);
+
+	binners = malloc(thread_count*sizeof(pipe_binner));
+	threads = malloc(thread_count*sizeof(pthread_t));
+
+	/* start the binning threads */
+	for(t=0; t < thread_count; t++){
+		binners[t].graph = graph;
+		binners[t].ring = &ring;
+		binners[t].loc_bin_counts = alloc_bin_counts(graph->bin_count);
+		memset(&binners[t].loc_stats, 0, sizeof(moments));
+
+		thread_rc = pthread_create(&threads[t], NULL, bin_blocks, (void*)&binners[t]);
+
+		/* problem creating thread */
+		if(thread_rc){
+			printf(ERROR_THREAD_CR, thread_rc);
+			exit(ERROR);
+		}
+	}
+
+	/* this thread is the reader */
+	rc = read_blocks(&ring, file, size);
+
+	/* let the binning threads finish up */
+	pthread_mutex_lock(&ring.lock);
+	ring.done = true;
+	pthread_cond_broadcast(&ring.has_full);
+	pthread_mutex_unlock(&ring.lock);
+
+	for(t=0; t < thread_count; t++){
+		thread_rc = pthread_join(threads[t], NULL);
+
+		/* error joining thread */
+		if(thread_rc){
+			printf(ERROR_THREAD_JN, thread_rc);
+			exit(ERROR);
+		}
+
+		/* sum the local bin counts into the histogram */
+		for(bin=0; bin < graph->bin_count + REJECT_COUNT; bin++){
+			graph->bin_counts[bin] += binners[t].loc_bin_counts[bin];
+		}
+		if(graph->stats){
+			merge_moments(graph->stats, &binners[t].loc_stats);
+		}
+		free_block(binners[t].loc_bin_counts);
+	}
+
+	/* Delete what we dont need anymore */
+	for(t=0; t < PIPE_RING_SIZE; t++){
+		free_block(ring.blocks[t]);
+	}
+	pthread_mutex_destroy(&ring.lock);
+	pthread_cond_destroy(&ring.has_free);
+	pthread_cond_destroy(&ring.has_full);
+	free(binners);
+	free(threads);
+
+	return rc;
+}
+
+static void push_block(block_queue* queue, unsigned long block){
+	queue->slots[(queue->head + queue->count) % PIPE_RING_SIZE] = block;
+	queue->count += 1;
+}
+
+static void put_full_block(block_ring* ring, unsigned long block, unsigned long count){
+	ring->counts[block] = count;
+
+	pthread_mutex_lock(&ring->lock);
+	push_block(&ring->full_blocks, block);
+	pthread_cond_signal(&ring->has_full);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+static int read_blocks(block_ring* ring, FILE* file, unsigned long size){
+	file_reader* reader;
+	char* text;
+	size_t length, position, consumed;
+	ssize_t read_size;
+	unsigned long block, filled, total, count, wanted;
+	bool at_end;
+	int rc;
+
+	/* one extra char for the '\0' parse_values needs */
+	text = malloc(PIPE_READ_SIZE + 1);
+	reader = init_reader(file);
+	length = 0;
+	total = 0;
+	at_end = false;
+	rc = SUCCESS;
+
+	block = take_free_block(ring);
+	filled = 0;
+
+	while(total < size && !at_end){
+
+		/* top up the text after whatever was left unparsed */
+		read_size = read_reader(reader, text + length, PIPE_READ_SIZE - length);
+		if(read_size < 0){
+			rc = ERROR;
+			break;
+		}else if(read_size == 0){
+			at_end = true;
+		}
+		length += read_size;
+		text[length] = '\0';
+
+		/* parse as much of the text as we can */
+		position = 0;
+		while(total < size){
+			wanted = PIPE_BLOCK_SIZE - filled;
+			if(wanted > size - total){
+				wanted = size - total;
+			}
+
+			rc = parse_values(text + position, length - position, at_end, ring->blocks[block] + filled, wanted, &count, &consumed);
+			filled += count;
+			total += count;
+			position += consumed;
+
+			if(rc){
+				break;
+			}
+
+			/* block is full, hand it over and get another */
+			if(filled == PIPE_BLOCK_SIZE){
+				put_full_block(ring, block, filled);
+				block = take_free_block(ring);
+				filled = 0;
+			}else{
+				break;
+			}
+		}
+
+		/* bad data */
+		if(rc){
+			break;
+		}
+
+		/* a single number should never fill the whole buffer */
+		if(position == 0 && length == PIPE_READ_SIZE){
+			rc = FAIL;
+			break;
+		}
+
+		/* keep the unparsed end for the next read */
+		length -= position;
+		memmove(text, text + position, length);
+	}
+
+	/* hand over the last partial block */
+	if(filled > 0){
+		put_full_block(ring, block, filled);
+	}else{
+		pthread_mutex_lock(&ring->lock);
+		push_block(&ring->free_blocks, block);
+		pthread_mutex_unlock(&ring->lock);
+	}
+
+	delete_reader(reader);
+	free(text);
+	return rc;
+}
+
+static unsigned long take_free_block(block_ring* ring){
+	unsigned long block;
+
+	/* wait while every block is full (backpressure) */
+	pthread_mutex_lock(&ring->lock);
+	while(ring->free_blocks.count == 0){
+		pthread_cond_wait(&ring->has_free, &ring->lock);
+	}
+	block = pop_block(&ring->free_blocks);
+	pthread_mutex_unlock(&ring->lock);
+
+	return block;
+}
@@ -0,0 +1,39 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Pipeline functions bin a data file while it is still being read.
+ *
+ * When the range of the data is known up front (from the -r flag or
+ * the file header), the bins can be set up before any data is read.
+ * A reader thread then parses the file into fixed size blocks from a
+ * ring of PIPE_RING_SIZE blocks, while binning threads take full blocks,
+ * bin them into their local bin counts and hand them back.
+ *
+ * The reader waits when every block is full (backpressure), so memory
+ * stays at PIPE_RING_SIZE * PIPE_BLOCK_SIZE values no matter how big
+ * the file is, and the data never needs to be held in a vector.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include "histogram.h"
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Reads up to size values from file (after the header line) and bins
+ * them with thread_count binning threads as they are read.
+ * Assumes the bins of graph were already set up (process_stats_range)
+ * graph->data is not used.
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the file was binned
+ * 	FAIL if the file contained something that is not a number
+ * 	ERROR if reading the file failed
+ */
+int process_file_pipelined(histogram* graph, FILE* file, unsigned long size, unsigned long thread_count);
+
+#endif
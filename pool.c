@@ -0,0 +1,176 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * A thread pool runs tasks on a fixed set of worker threads.
+ *
+ * Queued tasks live in a ring that doubles when it fills up.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "pool.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* what a worker thread is given */
+typedef struct{
+	thread_pool* pool; /* the pool it works for */
+	unsigned long worker_id; /* its index */
+}pool_worker;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Thread function that runs tasks until the pool stops (pool_worker)
+ */
+static void* run_worker(void* data);
+
+/*	FUNCTIONS	======================================================*/
+
+void delete_pool(thread_pool* pool){
+	unsigned long t;
+	int rc;
+
+	if(pool){
+		pool_wait(pool);
+
+		/* wake everyone up to exit */
+		pthread_mutex_lock(&pool->lock);
+		pool->stopping = true;
+		pthread_cond_broadcast(&pool->has_job);
+		pthread_mutex_unlock(&pool->lock);
+
+		for(t=0; t < pool->thread_count; t++){
+			rc = pthread_join(pool->threads[t], NULL);
+
+			/* error joining thread */
+			if(rc){
+				printf(ERROR_THREAD_JN, rc);
+				exit(ERROR);
+			}
+		}
+
+		pthread_mutex_destroy(&pool->lock);
+		pthread_cond_destroy(&pool->has_job);
+		pthread_cond_destroy(&pool->idle);
+		free(pool->jobs);
+		free(pool->threads);
+		free(pool);
+	}
+}
+
+thread_pool* init_pool(unsigned long thread_count){
+	thread_pool* pool;
+	pool_worker* worker;
+	unsigned long t;
+	int rc;
+
+	pool = malloc(sizeof(thread_pool));
+	pool->threads = malloc(thread_count*sizeof(pthread_t));
+	pool->thread_count = thread_count;
+	pool->job_capacity = POOL_QUEUE_SIZE;
+	pool->jobs = malloc(pool->job_capacity*sizeof(pool_job));
+	pool->job_head = 0;
+	pool->job_count = 0;
+	pool->pending = 0;
+	pool->stopping = false;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->has_job, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+
+	for(t=0; t < thread_count; t++){
+
+		/* the worker frees this when it exits */
+		worker = malloc(sizeof(pool_worker));
+		worker->pool = pool;
+		worker->worker_id = t;
+
+		rc = pthread_create(&pool->threads[t], NULL, run_worker, (void*)worker);
+
+		/* problem creating thread */
+		if(rc){
+			printf(ERROR_THREAD_CR, rc);
+			exit(ERROR);
+		}
+	}
+
+	return pool;
+}
+
+void pool_submit(thread_pool* pool, pool_task task, void* arg){
+	pool_job* jobs;
+	unsigned long t;
+
+	pthread_mutex_lock(&pool->lock);
+
+	/* ring is full, double it (unwrapping the queued tasks) */
+	if(pool->job_count == pool->job_capacity){
+		jobs = malloc(2*pool->job_capacity*sizeof(pool_job));
+		for(t=0; t < pool->job_count; t++){
+			jobs[t] = pool->jobs[(pool->job_head + t) % pool->job_capacity];
+		}
+		free(pool->jobs);
+		pool->jobs = jobs;
+		pool->job_head = 0;
+		pool->job_capacity *= 2;
+	}
+
+	pool->jobs[(pool->job_head + pool->job_count) % pool->job_capacity].task = task;
+	pool->jobs[(pool->job_head + pool->job_count) % pool->job_capacity].arg = arg;
+	pool->job_count += 1;
+	pool->pending += 1;
+
+	pthread_cond_signal(&pool->has_job);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_wait(thread_pool* pool){
+	pthread_mutex_lock(&pool->lock);
+	while(pool->pending > 0){
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void* run_worker(void* data){
+	pool_worker* worker;
+	thread_pool* pool;
+	pool_job job;
+
+	worker = (pool_worker*) data;
+	pool = worker->pool;
+
+	while(true){
+
+		/* wait for a task (or for the pool to stop) */
+		pthread_mutex_lock(&pool->lock);
+		while(pool->job_count == 0 && !pool->stopping){
+			pthread_cond_wait(&pool->has_job, &pool->lock);
+		}
+
+		if(pool->job_count == 0){
+			pthread_mutex_unlock(&pool->lock);
+			free(worker);
+			return NULL;
+		}
+
+		job = pool->jobs[pool->job_head];
+		pool->job_head = (pool->job_head + 1) % pool->job_capacity;
+		pool->job_count -= 1;
+		pthread_mutex_unlock(&pool->lock);
+
+		job.task(job.arg, worker->worker_id);
+
+		/* let pool_wait know when everything is done */
+		pthread_mutex_lock(&pool->lock);
+		pool->pending -= 1;
+		if(pool->pending == 0){
+			pthread_cond_broadcast(&pool->idle);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
@@ -0,0 +1,69 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * A thread pool runs tasks on a fixed set of worker threads, so many
+ * small jobs do not each pay for creating their own threads.
+ *
+ * Tasks get the index of the worker running them (0 to thread_count-1),
+ * so they can reuse per-worker scratch memory. Tasks may submit more
+ * tasks, but should never wait on other tasks.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+/*	TYPES	==========================================================*/
+
+/* a task function, given its argument and the running worker's index */
+typedef void (*pool_task)(void* arg, unsigned long worker_id);
+
+/* a queued task */
+typedef struct{
+	pool_task task; /* the function to run */
+	void* arg; /* the argument to give it */
+}pool_job;
+
+/* the pool */
+typedef struct{
+	pthread_t* threads; /* the worker threads */
+	unsigned long thread_count; /* number of worker threads */
+	pool_job* jobs; /* ring of queued tasks */
+	unsigned long job_head; /* index of the first queued task */
+	unsigned long job_count; /* number of queued tasks */
+	unsigned long job_capacity; /* size of the jobs ring */
+	unsigned long pending; /* tasks queued or running */
+	bool stopping; /* true when the workers should exit */
+	pthread_mutex_t lock; /* guards everything above */
+	pthread_cond_t has_job; /* signaled when a task is queued */
+	pthread_cond_t idle; /* signaled when pending reaches 0 */
+}thread_pool;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Waits for the queued tasks to finish, stops the workers and deletes
+ * the given pool
+ */
+void delete_pool(thread_pool* pool);
+
+/**
+ * Creates a pool with thread_count worker threads
+ */
+thread_pool* init_pool(unsigned long thread_count);
+
+/**
+ * Queues the given task to run on the next free worker
+ */
+void pool_submit(thread_pool* pool, pool_task task, void* arg);
+
+/**
+ * Waits until every task (including the ones they submit) is done
+ * Must not be called from a task
+ */
+void pool_wait(thread_pool* pool);
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Quantile functions estimate quantiles of data in one pass
+ *
+ * Every level has room for 4*QUANTILE_K values: a merge can add up to
+ * QUANTILE_K-1 values to a level that already has that many, and the
+ * level below can compact up to half of its (at most 2*QUANTILE_K)
+ * values into it before it is compacted itself.
+ */
+
+#define _DEFAULT_SOURCE /* for rand_r */
+
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "quantile.h"
+#include "config.h"
+
+/*	TYPES	==========================================================*/
+
+/* a kept value and the number of data it stands for (for find_quantile) */
+typedef struct{
+	double value;
+	unsigned long weight;
+}weighted_value;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Sorts the given level and moves every other value of it up a level
+ * (refer to quantile.h), adding the next level if it is not there yet
+ */
+static void compact_level(quantile_sketch* qs, unsigned long level);
+
+/**
+ * Compacts every level that is full, from the bottom up
+ */
+static void compact_levels(quantile_sketch* qs);
+
+/**
+ * Compares two weighted_values by value (for qsort)
+ */
+static int compare_weighted(const void* a, const void* b);
+
+/**
+ * Sorts count values (at most 4*QUANTILE_K) with an LSD radix sort,
+ * using scratch (room for 8*QUANTILE_K keys) for the keys.
+ * Adding values is mostly this sort, and a radix sort has no
+ * comparisons to mispredict on random data like qsort does.
+ */
+static void sort_values(double* values, unsigned long count, unsigned long* scratch);
+
+/*	FUNCTIONS	======================================================*/
+
+void add_quantile_value(quantile_sketch* qs, double value){
+	qs->levels[0][qs->sizes[0]++] = value;
+	qs->count += 1;
+
+	if(qs->sizes[0] >= QUANTILE_K){
+		compact_levels(qs);
+	}
+}
+
+static void compact_level(quantile_sketch* qs, unsigned long level){
+	double* values;
+	double* up;
+	unsigned long t, pairs, offset, size;
+
+	values = qs->levels[level];
+	size = qs->sizes[level];
+	sort_values(values, size, qs->scratch);
+
+	/* the top level gets a level above it */
+	if(level+1 == qs->level_count){
+		qs->levels[level+1] = alloc_block(4*QUANTILE_K*sizeof(double));
+		qs->sizes[level+1] = 0;
+		qs->level_count += 1;
+	}
+
+	/* every other (sorted) value stands for itself and its neighbour */
+	up = qs->levels[level+1];
+	pairs = size/2;
+	offset = rand_r(&qs->seed) & 1;
+	for(t=0; t < pairs; t++){
+		up[qs->sizes[level+1]++] = values[2*t + offset];
+	}
+
+	/* an odd value out stays on this level */
+	if(size & 1){
+		values[0] = values[size-1];
+		qs->sizes[level] = 1;
+	}else{
+		qs->sizes[level] = 0;
+	}
+}
+
+static void compact_levels(quantile_sketch* qs){
+	unsigned long level;
+
+	/* compacting a level can fill up (or add) the one above it */
+	for(level=0; level < qs->level_count && level+1 < QUANTILE_MAX_LEVELS; level++){
+		if(qs->sizes[level] >= QUANTILE_K){
+			compact_level(qs, level);
+		}
+	}
+}
+
+static int compare_weighted(const void* a, const void* b){
+	double x, y;
+
+	x = ((const weighted_value*)a)->value;
+	y = ((const weighted_value*)b)->value;
+	return (x > y) - (x < y);
+}
+
+void delete_quantile_sketch(quantile_sketch* qs){
+	unsigned long level;
+
+	if(qs){
+		for(level=0; level < qs->level_count; level++){
+			free_block(qs->levels[level]);
+		}
+		free(qs->levels);
+		free(qs->sizes);
+		free_block(qs->scratch);
+		free(qs);
+	}
+}
+
+double find_quantile(quantile_sketch* qs, double quantile){
+	weighted_value* kept;
+	unsigned long level, t, count, seen;
+	double rank, value;
+
+	if(qs->count == 0){
+		return 0;
+	}
+
+	/* every kept value with the number of data it stands for */
+	count = 0;
+	for(level=0; level < qs->level_count; level++){
+		count += qs->sizes[level];
+	}
+	kept = malloc(count*sizeof(weighted_value));
+	count = 0;
+	for(level=0; level < qs->level_count; level++){
+		for(t=0; t < qs->sizes[level]; t++){
+			kept[count].value = qs->levels[level][t];
+			kept[count].weight = 1UL << level;
+			count += 1;
+		}
+	}
+	qsort(kept, count, sizeof(weighted_value), compare_weighted);
+
+	/* the first value whose (estimated) rank reaches the quantile */
+	rank = quantile*qs->count;
+	seen = 0;
+	value = kept[count-1].value;
+	for(t=0; t < count; t++){
+		seen += kept[t].weight;
+		if(seen >= rank){
+			value = kept[t].value;
+			break;
+		}
+	}
+
+	free(kept);
+	return value;
+}
+
+quantile_sketch* init_quantile_sketch(unsigned int seed){
+	quantile_sketch* qs;
+
+	qs = malloc(sizeof(quantile_sketch));
+	qs->levels = calloc(QUANTILE_MAX_LEVELS, sizeof(double*));
+	qs->sizes = calloc(QUANTILE_MAX_LEVELS, sizeof(unsigned long));
+	qs->levels[0] = alloc_block(4*QUANTILE_K*sizeof(double));
+	qs->scratch = alloc_block(8*QUANTILE_K*sizeof(unsigned long));
+	qs->level_count = 1;
+	qs->count = 0;
+	qs->seed = seed;
+
+	return qs;
+}
+
+void merge_quantile_sketch(quantile_sketch* qs, quantile_sketch* other){
+	unsigned long level;
+
+	/* both sketches need the same levels */
+	while(qs->level_count < other->level_count){
+		qs->levels[qs->level_count] = alloc_block(4*QUANTILE_K*sizeof(double));
+		qs->sizes[qs->level_count] = 0;
+		qs->level_count += 1;
+	}
+
+	/* values of a level stand for as many data in either sketch */
+	for(level=0; level < other->level_count; level++){
+		memcpy(qs->levels[level] + qs->sizes[level], other->levels[level], other->sizes[level]*sizeof(double));
+		qs->sizes[level] += other->sizes[level];
+	}
+	qs->count += other->count;
+
+	compact_levels(qs);
+}
+
+static void sort_values(double* values, unsigned long count, unsigned long* scratch){
+	unsigned long digit_counts[QUANTILE_RADIX];
+	unsigned long* keys;
+	unsigned long* sorted;
+	unsigned long* swap;
+	unsigned long t, shift, digit, total, bits;
+
+	/* doubles as unsigned keys in the same order (negatives flipped) */
+	keys = scratch;
+	sorted = scratch + 4*QUANTILE_K;
+	for(t=0; t < count; t++){
+		memcpy(&bits, &values[t], sizeof(double));
+		keys[t] = (bits >> 63) ? ~bits : bits | (1UL << 63);
+	}
+
+	/* one counting pass per digit, from the lowest */
+	for(shift=0; shift < 64; shift += QUANTILE_RADIX_BITS){
+		memset(digit_counts, 0, sizeof(digit_counts));
+		for(t=0; t < count; t++){
+			digit_counts[(keys[t] >> shift) & (QUANTILE_RADIX-1)] += 1;
+		}
+
+		/* every key has this digit (like the exponent of close values) */
+		if(count == 0 || digit_counts[(keys[0] >> shift) & (QUANTILE_RADIX-1)] == count){
+			continue;
+		}
+
+		total = 0;
+		for(digit=0; digit < QUANTILE_RADIX; digit++){
+			t = digit_counts[digit];
+			digit_counts[digit] = total;
+			total += t;
+		}
+		for(t=0; t < count; t++){
+			sorted[digit_counts[(keys[t] >> shift) & (QUANTILE_RADIX-1)]++] = keys[t];
+		}
+
+		swap = keys;
+		keys = sorted;
+		sorted = swap;
+	}
+
+	for(t=0; t < count; t++){
+		bits = (keys[t] >> 63) ? keys[t] & ~(1UL << 63) : ~keys[t];
+		memcpy(&values[t], &bits, sizeof(double));
+	}
+}
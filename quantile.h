@@ -0,0 +1,72 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Quantile functions estimate quantiles (like the quartiles) of data
+ * in one pass, without sorting it or keeping all of it.
+ *
+ * A quantile sketch (KLL style) keeps levels of at most QUANTILE_K
+ * values each. Every value is added to level 0. When a level fills up it
+ * is compacted: it is sorted, and every other value (starting at a
+ * random one of the first two) moves up a level, where each value stands
+ * for twice as many data. So a sketch of n data keeps about
+ * QUANTILE_K*log2(n/QUANTILE_K) values, and adding a value costs about
+ * log2(QUANTILE_K) comparisons.
+ *
+ * Sketches are mergeable: each binning thread can sketch its own slice
+ * and the sketches are merged (level by level, then compacted) into one
+ * sketch of all the data, with the same error bounds.
+ *
+ * Error bounds:
+ * The rank of an estimated quantile is off by about
+ * n*log2(n/QUANTILE_K)/QUANTILE_K at worst, and usually by much less
+ * (the compactions make random, mostly cancelling, errors).
+ */
+
+#ifndef QUANTILE_H
+#define QUANTILE_H
+
+/*	TYPES	==========================================================*/
+
+/* a mergeable quantile sketch */
+typedef struct{
+	unsigned long level_count; /* levels in use */
+	double** levels; /* kept values, each stands for 2^level data (QUANTILE_MAX_LEVELS) */
+	unsigned long* sizes; /* number of values in each level */
+	unsigned long* scratch; /* room to sort a level in */
+	unsigned long count; /* number of data added */
+	unsigned int seed; /* picks which half a compaction keeps */
+}quantile_sketch;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Adds one value to the given sketch
+ */
+void add_quantile_value(quantile_sketch* qs, double value);
+
+/**
+ * Deletes the given quantile sketch
+ */
+void delete_quantile_sketch(quantile_sketch* qs);
+
+/**
+ * Estimates the given quantile (0 is the min, 0.5 the median, 1 the max)
+ * of the data added to the sketch
+ *
+ * @returns the estimate, 0 if the sketch is empty
+ */
+double find_quantile(quantile_sketch* qs, double quantile);
+
+/**
+ * Creates an empty quantile sketch, seeding its compactions with seed
+ * (sketches merged together should have different seeds)
+ */
+quantile_sketch* init_quantile_sketch(unsigned int seed);
+
+/**
+ * Merges the sketch other into qs (other is left as it was)
+ */
+void merge_quantile_sketch(quantile_sketch* qs, quantile_sketch* other);
+
+#endif
@@ -0,0 +1,517 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Reader functions read data files ahead of the parser
+ *
+ * Buffer n of a reader holds the bytes at base + n*READER_BUFFER_SIZE,
+ * and lives in slot n % READER_DEPTH. Buffers are sent off in order and
+ * handed out in order; a slot is sent off again (for buffer
+ * n + READER_DEPTH) as soon as buffer n has been handed out.
+ *
+ * io_uring:
+ * The submission and completion rings are shared with the kernel
+ * through mmap. We are the only one adding submissions and taking
+ * completions, so the ring heads and tails only need acquire/release
+ * ordering, no locks. Completions may come out of order; each one says
+ * which slot it filled.
+ *
+ * Any read that comes back short (before the end of the file) or fails
+ * is finished with pread, so the buffers handed out are always whole.
+ */
+
+#define _GNU_SOURCE /* for O_DIRECT and MAP_POPULATE */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "reader.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* how the buffers are filled */
+typedef enum{
+	READ_URING = 0, /* asynchronously, through io_uring */
+	READ_PREAD = 1, /* with pread when they are needed */
+	READ_STREAM = 2 /* no buffers, straight from the FILE (pipes) */
+}READ_MODE;
+
+/* an io_uring instance, with its rings mapped */
+typedef struct{
+	int fd;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	struct io_uring_sqe* sqes;
+	struct io_uring_cqe* cqes;
+	void* sq_map; /* the submission ring (and the completion ring with single mmap) */
+	size_t sq_map_size;
+	void* cq_map; /* the completion ring, if it is mapped on its own */
+	size_t cq_map_size;
+	size_t sqes_size;
+	unsigned queued; /* submissions the kernel has not taken yet */
+	unsigned in_flight; /* submissions without a completion yet */
+}uring;
+
+struct file_reader{
+	FILE* file; /* the file being read */
+	int fd; /* the file's descriptor */
+	READ_MODE mode;
+	int flags; /* the file's status flags before direct mode */
+	bool direct; /* if O_DIRECT was turned on (and must be turned off) */
+	off_t base; /* aligned offset of buffer 0 */
+	off_t end; /* size of the file */
+	unsigned long next; /* the buffer handed out next */
+	unsigned long sent; /* buffers sent off so far */
+	size_t position; /* bytes of buffer next already handed out */
+	char* buffers[READER_DEPTH]; /* allocated when first needed */
+	ssize_t lengths[READER_DEPTH]; /* bytes read into each slot, -1 for errors */
+	bool done[READER_DEPTH]; /* if the read into each slot finished */
+	struct iovec iovecs[READER_DEPTH]; /* what each slot reads into (io_uring) */
+	uring ring;
+};
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* if readers use O_DIRECT (see set_direct_io) */
+static bool direct_io = false;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Unmaps and closes the given ring
+ */
+static void delete_uring(uring* ring);
+
+/**
+ * Finishes filling the slot of buffer next with pread, from have bytes
+ * up to a whole buffer (or the end of the file)
+ */
+static void fill_buffer(file_reader* reader, unsigned long slot, size_t have);
+
+/**
+ * Sets up an io_uring instance with room for READER_DEPTH reads
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the ring can be used
+ * 	ERROR if the kernel does not have (or lets us use) io_uring
+ */
+static int init_uring(uring* ring);
+
+/**
+ * Takes every completion the kernel has posted
+ */
+static void reap_uring(file_reader* reader);
+
+/**
+ * Sends off the read of the next buffer, if it is not past the end
+ * of the file
+ */
+static void send_buffer(file_reader* reader);
+
+/**
+ * Waits for the read of buffer next to finish
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the buffer was read
+ * 	ERROR if the ring failed (the buffer is not read)
+ */
+static int wait_buffer(file_reader* reader);
+
+/*	FUNCTIONS	======================================================*/
+
+void delete_reader(file_reader* reader){
+	off_t position;
+	unsigned long t;
+	bool reading;
+
+	if(!reader){
+		return;
+	}
+
+	if(reader->mode != READ_STREAM){
+
+		/* the kernel may still be reading into our buffers */
+		reading = false;
+		if(reader->mode == READ_URING){
+			while(reader->ring.in_flight > 0){
+				reap_uring(reader);
+				if(reader->ring.in_flight > 0
+					&& syscall(__NR_io_uring_enter, reader->ring.fd, reader->ring.queued, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+					&& errno != EINTR){
+					break;
+				}
+			}
+
+			/* the ring could not be waited on, so reads may still land
+			 * in the buffers even after it is closed: leak them */
+			reading = reader->ring.in_flight > 0;
+			delete_uring(&reader->ring);
+		}
+
+		if(reader->direct){
+			fcntl(reader->fd, F_SETFL, reader->flags);
+		}
+
+		/* leave the file where the reader stopped */
+		position = reader->base + (off_t)reader->next*READER_BUFFER_SIZE + reader->position;
+		if(position > reader->end){
+			position = reader->end;
+		}
+		fseeko(reader->file, position, SEEK_SET);
+
+		for(t=0; t < READER_DEPTH && !reading; t++){
+			free(reader->buffers[t]);
+		}
+	}
+
+	free(reader);
+}
+
+static void delete_uring(uring* ring){
+	munmap(ring->sqes, ring->sqes_size);
+	if(ring->cq_map != ring->sq_map){
+		munmap(ring->cq_map, ring->cq_map_size);
+	}
+	munmap(ring->sq_map, ring->sq_map_size);
+	close(ring->fd);
+}
+
+static void fill_buffer(file_reader* reader, unsigned long slot, size_t have){
+	off_t offset;
+	ssize_t read_size;
+
+	offset = reader->base + (off_t)reader->next*READER_BUFFER_SIZE;
+
+	while(have < READER_BUFFER_SIZE){
+		read_size = pread(reader->fd, reader->buffers[slot] + have, READER_BUFFER_SIZE - have, offset + have);
+
+		if(read_size < 0 && errno == EINTR){
+			continue;
+		}else if(read_size < 0){
+			reader->lengths[slot] = -1;
+			reader->done[slot] = true;
+			return;
+		}else if(read_size == 0){
+			break;
+		}
+		have += read_size;
+	}
+
+	reader->lengths[slot] = have;
+	reader->done[slot] = true;
+}
+
+file_reader* init_reader(FILE* file){
+	file_reader* reader;
+	struct stat file_stat;
+	off_t offset;
+	unsigned long t;
+
+	reader = malloc(sizeof(file_reader));
+	memset(reader, 0, sizeof(file_reader));
+	reader->file = file;
+	reader->fd = fileno(file);
+
+	/* only regular files can be read at offsets */
+	offset = ftello(file);
+	if(offset < 0 || fstat(reader->fd, &file_stat) || !S_ISREG(file_stat.st_mode)){
+		reader->mode = READ_STREAM;
+		return reader;
+	}
+
+	/* start at an aligned offset (O_DIRECT needs it), skipping up to the data */
+	reader->end = file_stat.st_size;
+	reader->base = offset & ~((off_t)READER_ALIGN - 1);
+	reader->position = offset - reader->base;
+
+	/* filesystems without O_DIRECT just refuse it here */
+	if(direct_io){
+		reader->flags = fcntl(reader->fd, F_GETFL);
+		reader->direct = reader->flags >= 0 && fcntl(reader->fd, F_SETFL, reader->flags | O_DIRECT) == 0;
+	}
+
+	reader->mode = (init_uring(&reader->ring) == SUCCESS) ? READ_URING : READ_PREAD;
+
+	for(t=0; t < READER_DEPTH; t++){
+		send_buffer(reader);
+	}
+
+	return reader;
+}
+
+static int init_uring(uring* ring){
+	struct io_uring_params params;
+	unsigned char* sq;
+	unsigned char* cq;
+	long fd;
+
+	memset(&params, 0, sizeof(params));
+	fd = syscall(__NR_io_uring_setup, READER_DEPTH, &params);
+	if(fd < 0){
+		return ERROR;
+	}
+
+	memset(ring, 0, sizeof(uring));
+	ring->fd = fd;
+	ring->sq_map_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+	ring->cq_map_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+	ring->sqes_size = params.sq_entries*sizeof(struct io_uring_sqe);
+
+	/* newer kernels map both rings at once */
+	if(params.features & IORING_FEAT_SINGLE_MMAP){
+		if(ring->cq_map_size > ring->sq_map_size){
+			ring->sq_map_size = ring->cq_map_size;
+		}
+		ring->cq_map_size = ring->sq_map_size;
+	}
+
+	ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if(ring->sq_map == MAP_FAILED){
+		close(fd);
+		return ERROR;
+	}
+
+	if(params.features & IORING_FEAT_SINGLE_MMAP){
+		ring->cq_map = ring->sq_map;
+	}else{
+		ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if(ring->cq_map == MAP_FAILED){
+			munmap(ring->sq_map, ring->sq_map_size);
+			close(fd);
+			return ERROR;
+		}
+	}
+
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(ring->sqes == MAP_FAILED){
+		if(ring->cq_map != ring->sq_map){
+			munmap(ring->cq_map, ring->cq_map_size);
+		}
+		munmap(ring->sq_map, ring->sq_map_size);
+		close(fd);
+		return ERROR;
+	}
+
+	sq = ring->sq_map;
+	cq = ring->cq_map;
+	ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+	ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	return SUCCESS;
+}
+
+bool is_cache_fresh(const char* cache_path, const char* data_path, const file_stamp* saved){
+	struct stat cache_stat, data_stat;
+
+	if(stat(cache_path, &cache_stat) || stat(data_path, &data_stat)){
+		return false;
+	}
+
+	/* the data was changed after the cache (to the nanosecond) */
+	if(cache_stat.st_mtim.tv_sec < data_stat.st_mtim.tv_sec
+		|| (cache_stat.st_mtim.tv_sec == data_stat.st_mtim.tv_sec && cache_stat.st_mtim.tv_nsec < data_stat.st_mtim.tv_nsec)){
+		return false;
+	}
+
+	/* or it is not the data the cache was made from */
+	return saved->size == (unsigned long)data_stat.st_size
+		&& saved->mtime_sec == (long)data_stat.st_mtim.tv_sec
+		&& saved->mtime_nsec == (long)data_stat.st_mtim.tv_nsec;
+}
+
+ssize_t read_reader(file_reader* reader, char* out, size_t length){
+	unsigned long slot;
+	size_t copied, available;
+
+	/* pipes are read like they always were */
+	if(reader->mode == READ_STREAM){
+		copied = fread(out, 1, length, reader->file);
+		return (copied == 0 && ferror(reader->file)) ? -1 : (ssize_t)copied;
+	}
+
+	copied = 0;
+	while(copied < length && reader->next < reader->sent){
+		slot = reader->next % READER_DEPTH;
+
+		if(wait_buffer(reader) || reader->lengths[slot] < 0){
+			return -1;
+		}
+
+		/* buffer used up (or cut short by the end of the file), send it off again */
+		if(reader->position >= (size_t)reader->lengths[slot]){
+			reader->next += 1;
+			reader->position = 0;
+			send_buffer(reader);
+			continue;
+		}
+
+		available = reader->lengths[slot] - reader->position;
+		if(available > length - copied){
+			available = length - copied;
+		}
+		memcpy(out + copied, reader->buffers[slot] + reader->position, available);
+		reader->position += available;
+		copied += available;
+	}
+
+	return copied;
+}
+
+static void reap_uring(file_reader* reader){
+	uring* ring;
+	struct io_uring_cqe* cqe;
+	unsigned head, tail, slot;
+
+	ring = &reader->ring;
+	head = *ring->cq_head;
+	tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+	while(head != tail){
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		slot = cqe->user_data;
+		reader->lengths[slot] = (cqe->res < 0) ? -1 : cqe->res;
+		reader->done[slot] = true;
+		ring->in_flight -= 1;
+		head += 1;
+	}
+
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void send_buffer(file_reader* reader){
+	uring* ring;
+	struct io_uring_sqe* sqe;
+	unsigned long slot;
+	unsigned tail, index;
+	off_t offset;
+	long rc;
+
+	offset = reader->base + (off_t)reader->sent*READER_BUFFER_SIZE;
+	if(offset >= reader->end){
+		return;
+	}
+
+	slot = reader->sent % READER_DEPTH;
+	if(!reader->buffers[slot] && posix_memalign((void**)&reader->buffers[slot], READER_ALIGN, READER_BUFFER_SIZE)){
+		reader->buffers[slot] = NULL;
+		reader->lengths[slot] = -1;
+		reader->done[slot] = true;
+		reader->sent += 1;
+		return;
+	}
+	reader->done[slot] = false;
+	reader->sent += 1;
+
+	/* pread mode reads the buffer when it is waited on */
+	if(reader->mode != READ_URING){
+		return;
+	}
+
+	ring = &reader->ring;
+	reader->iovecs[slot].iov_base = reader->buffers[slot];
+	reader->iovecs[slot].iov_len = READER_BUFFER_SIZE;
+
+	tail = *ring->sq_tail;
+	index = tail & *ring->sq_mask;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = reader->fd;
+	sqe->off = offset;
+	sqe->addr = (unsigned long)&reader->iovecs[slot];
+	sqe->len = 1;
+	sqe->user_data = slot;
+	ring->sq_array[index] = index;
+
+	/* the kernel must see the whole submission before the new tail */
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->queued += 1;
+	ring->in_flight += 1;
+
+	/* if the kernel is busy, it takes the submission on the next enter */
+	rc = syscall(__NR_io_uring_enter, ring->fd, ring->queued, 0, 0, NULL, 0);
+	if(rc > 0){
+		ring->queued -= rc;
+	}
+}
+
+void set_direct_io(bool direct){
+	direct_io = direct;
+}
+
+int stamp_file(const char* path, file_stamp* stamp){
+	struct stat file_stat;
+
+	memset(stamp, 0, sizeof(file_stamp));
+	if(stat(path, &file_stat)){
+		return ERROR;
+	}
+
+	stamp->size = file_stat.st_size;
+	stamp->mtime_sec = file_stat.st_mtim.tv_sec;
+	stamp->mtime_nsec = file_stat.st_mtim.tv_nsec;
+	return SUCCESS;
+}
+
+static int wait_buffer(file_reader* reader){
+	uring* ring;
+	unsigned long slot;
+	off_t offset;
+	long rc;
+
+	slot = reader->next % READER_DEPTH;
+	if(!reader->buffers[slot]){
+		return SUCCESS;
+	}
+
+	if(reader->mode == READ_PREAD){
+		if(!reader->done[slot]){
+			fill_buffer(reader, slot, 0);
+		}
+		return SUCCESS;
+	}
+
+	ring = &reader->ring;
+	while(!reader->done[slot]){
+		reap_uring(reader);
+		if(reader->done[slot]){
+			break;
+		}
+
+		rc = syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if(rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY){
+			return ERROR;
+		}else if(rc > 0){
+			ring->queued -= rc;
+		}
+	}
+
+	/* finish short (or failed) reads ourselves */
+	offset = reader->base + (off_t)reader->next*READER_BUFFER_SIZE;
+	if(reader->lengths[slot] < 0){
+		fill_buffer(reader, slot, 0);
+	}else if((size_t)reader->lengths[slot] < READER_BUFFER_SIZE && offset + reader->lengths[slot] < reader->end){
+		fill_buffer(reader, slot, reader->lengths[slot]);
+	}
+
+	return SUCCESS;
+}
@@ -0,0 +1,93 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Reader functions read data files ahead of the parser, so parsing and
+ * binning never wait on one blocking read at a time.
+ *
+ * A reader keeps up to READER_DEPTH reads of READER_BUFFER_SIZE bytes
+ * in flight (aligned to READER_ALIGN) through io_uring, and hands the
+ * completed buffers out in file order. Each buffer that is used up is
+ * sent off again right away for the next piece of the file.
+ *
+ * io_uring is used through its raw system calls. When the kernel does
+ * not have it (or does not let us use it), the buffers are filled with
+ * pread instead, and files that cannot be pread (pipes) are read from
+ * their FILE like before.
+ *
+ * Direct mode:
+ * With set_direct_io, regular files are read with O_DIRECT, skipping
+ * the page cache. Reads start at an aligned offset before the data, and
+ * filesystems that do not support O_DIRECT are read normally.
+ *
+ * File stamps:
+ * Caches made from a data file (sketches, indexes) keep a stamp of the
+ * file: its size and modification time to the nanosecond. A cache is
+ * only used while the data file still has that stamp, so rewriting the
+ * data in the same second as the cache was made is still noticed.
+ */
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*	TYPES	==========================================================*/
+
+/* a file being read ahead (see reader.c) */
+typedef struct file_reader file_reader;
+
+/* what a data file looked like when a cache was made from it (refer to top) */
+typedef struct{
+	unsigned long size; /* bytes in the file */
+	long mtime_sec; /* when it was last changed (seconds) */
+	long mtime_nsec; /* when it was last changed (nanoseconds past that) */
+}file_stamp;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Deletes the given reader, leaving its file positioned right after
+ * the last byte that was handed out (so the FILE can keep being used)
+ */
+void delete_reader(file_reader* reader);
+
+/**
+ * Creates a reader for the given file, starting from the current
+ * position of the file, and starts the first reads
+ */
+file_reader* init_reader(FILE* file);
+
+/**
+ * @returns true if the cache at cache_path can still be used for the
+ * 	data file at data_path: the data still has the saved stamp, and was
+ * 	not changed after the cache was (refer to top)
+ */
+bool is_cache_fresh(const char* cache_path, const char* data_path, const file_stamp* saved);
+
+/**
+ * Copies up to length of the next bytes of the file into out, waiting
+ * for them to be read if they have not been yet
+ *
+ * @returns the number of bytes copied (0 at the end of the file)
+ * 	OR -1 if reading failed
+ */
+ssize_t read_reader(file_reader* reader, char* out, size_t length);
+
+/**
+ * Sets if readers made from now on read regular files with O_DIRECT
+ */
+void set_direct_io(bool direct);
+
+/**
+ * Stamps the file at path (refer to top)
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the file was stamped
+ * 	ERROR if it could not be (stamp is zeroed)
+ */
+int stamp_file(const char* path, file_stamp* stamp);
+
+#endif
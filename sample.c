@@ -0,0 +1,211 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Sample functions bin a random sample of the data
+ *
+ * The kept values are gathered SAMPLE_CHUNK at a time and binned with
+ * count_bins, so the sample gets the same kernels as a full scan.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include "histogram.h"
+#include "memory.h"
+#include "parallel_helpers.h"
+#include "sample.h"
+#include "status.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* the slice of data one thread samples */
+typedef struct{
+	histogram* graph; /* the histogram being binned (shared) */
+	unsigned long start; /* first index of the slice */
+	unsigned long end; /* one past the last index of the slice */
+	double log_skip; /* log(1-p) */
+	unsigned long state; /* the generator state (never 0) */
+	unsigned long* counts; /* local bin counts */
+}sample_slice;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Bins the sample of a sample_slice (thread function)
+ */
+static void* bin_sample(void* data);
+
+/**
+ * @returns the number of values to skip before the next kept one
+ * 	(capped at limit)
+ */
+static unsigned long next_gap(sample_slice* slice, unsigned long limit);
+
+/**
+ * @returns the next random number of the slice's xorshift64* generator
+ */
+static inline unsigned long next_random(unsigned long* state);
+
+/*	FUNCTIONS	======================================================*/
+
+static void* bin_sample(void* data){
+	sample_slice* slice;
+	double* array;
+	double* kept;
+	unsigned long position, size;
+
+	slice = (sample_slice*) data;
+	array = slice->graph->data->array;
+	kept = malloc(SAMPLE_CHUNK*sizeof(double));
+
+	size = 0;
+	position = slice->start + next_gap(slice, slice->end - slice->start);
+	while(position < slice->end){
+		kept[size++] = array[position];
+		if(size == SAMPLE_CHUNK){
+			count_bins(slice->graph, kept, size, slice->counts);
+			size = 0;
+		}
+
+		position += 1;
+		if(position < slice->end){
+			position += next_gap(slice, slice->end - position);
+		}
+	}
+	count_bins(slice->graph, kept, size, slice->counts);
+
+	free(kept);
+	return NULL;
+}
+
+void find_sample_interval(histogram* graph, unsigned long count, unsigned long* low, unsigned long* high){
+	double fraction, sampled, error;
+
+	/* the estimate is the sampled count over p, rounded, so this is exact */
+	fraction = graph->sample_fraction;
+	sampled = round(count*fraction);
+
+	if(sampled < 1){
+		*low = 0;
+		*high = (unsigned long)ceil(SAMPLE_ZERO/fraction);
+		return;
+	}
+
+	error = SAMPLE_Z*sqrt(sampled*(1-fraction))/fraction;
+	*low = (count > error) ? (unsigned long)floor(count - error) : 0;
+	*high = (unsigned long)ceil(count + error);
+}
+
+static unsigned long next_gap(sample_slice* slice, unsigned long limit){
+	double uniform, gap;
+
+	/* uniform in (0,1], so the log is finite */
+	uniform = ((next_random(&slice->state) >> 11) + 1) * (1.0/9007199254740992.0);
+	gap = floor(log(uniform)/slice->log_skip);
+
+	return (gap < (double)limit) ? (unsigned long)gap : limit;
+}
+
+static inline unsigned long next_random(unsigned long* state){
+	unsigned long x;
+
+	x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545F4914F6CDD1DUL;
+}
+
+double pick_sample_fraction(unsigned long size, unsigned long bin_count, double error){
+	double average, fraction;
+
+	average = (double)size/bin_count;
+	fraction = SAMPLE_Z*SAMPLE_Z/(SAMPLE_Z*SAMPLE_Z + error*error*average);
+
+	return (fraction < 1) ? fraction : 1;
+}
+
+void process_data_sampled(histogram* graph, unsigned long thread_count, double fraction){
+	sample_slice* slices;
+	pthread_t* threads;
+	unsigned long t, bin, size;
+	int rc;
+
+	/* the whole data is no sample */
+	if(fraction >= 1){
+		graph->sample_fraction = 0;
+		if(thread_count > 1){
+			process_data_parallel(graph, thread_count, false, false, 0);
+		}else{
+			process_data_serial(graph);
+		}
+		return;
+	}
+
+	/* the sample is drawn from the plain values */
+	decode_vector_dictionary(graph->data);
+	size = graph->data->size;
+	if(thread_count < 1 || thread_count > size){
+		thread_count = 1;
+	}
+	graph->sample_fraction = fraction;
+
+	/* display status message */
+	print_status(H_SA_MSG, fraction*100, thread_count);
+
+	/* one slice (and generator) per thread */
+	slices = malloc(thread_count*sizeof(sample_slice));
+	for(t=0; t < thread_count; t++){
+		slices[t].graph = graph;
+		slices[t].start = calculate_start_index(t, thread_count, size);
+		slices[t].end = calculate_end_index(t, thread_count, size)+1;
+		slices[t].log_skip = log1p(-fraction);
+		slices[t].state = SAMPLE_SEED + (t+1)*0x9E3779B97F4A7C15UL;
+		slices[t].counts = alloc_bin_counts(graph->bin_count);
+	}
+
+	if(thread_count == 1){
+		bin_sample(&slices[0]);
+	}else{
+		threads = malloc(thread_count*sizeof(pthread_t));
+		for(t=0; t < thread_count; t++){
+			rc = pthread_create(&threads[t], NULL, bin_sample, (void*)&slices[t]);
+
+			/* problem creating thread */
+			if(rc){
+				printf(ERROR_THREAD_CR, rc);
+				exit(ERROR);
+			}
+		}
+		for(t=0; t < thread_count; t++){
+			rc = pthread_join(threads[t], NULL);
+
+			/* error joining thread */
+			if(rc){
+				printf(ERROR_THREAD_JN, rc);
+				exit(ERROR);
+			}
+		}
+		free(threads);
+	}
+
+	/* the counts of every slice, scaled up to the whole data */
+	for(bin=0; bin < graph->bin_count + REJECT_COUNT; bin++){
+		size = 0;
+		for(t=0; t < thread_count; t++){
+			size += slices[t].counts[bin];
+		}
+		graph->bin_counts[bin] = (unsigned long)llround(size/fraction);
+	}
+
+	for(t=0; t < thread_count; t++){
+		free_block(slices[t].counts);
+	}
+	free(slices);
+}
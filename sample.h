@@ -0,0 +1,61 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Sample functions bin a random sample of the data instead of all of
+ * it, for quick approximate histograms of huge data.
+ *
+ * Sampling:
+ * Every value is kept with the same probability p (Bernoulli sampling),
+ * stratified across the threads: each thread samples its own slice with
+ * its own xorshift generator. Rather than drawing a number per value,
+ * the gap to the next kept value is drawn from the geometric
+ * distribution (log(u)/log(1-p)), so only the kept values (about p*n)
+ * are ever read. The seeds are fixed, so a run is repeatable.
+ *
+ * Estimates:
+ * The bin counts (and rejects) are the sampled counts divided by p.
+ * A bin of n values is sampled k ~ Binomial(n, p) times, so the
+ * estimate k/p has a standard error of about sqrt(k*(1-p))/p, and its
+ * 95% interval is the estimate +- SAMPLE_Z standard errors. A bin with
+ * nothing sampled gets 0 to SAMPLE_ZERO/p (the rule of three).
+ *
+ * Target error:
+ * Instead of p, a relative error e can be given. p is then picked so
+ * that a bin with the average count (n/B) has a 95% interval within
+ * +-e of it: p = z^2 / (z^2 + e^2*n/B). Fuller bins do better and
+ * emptier ones worse (the error goes with 1/sqrt(count)).
+ */
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include "histogram.h"
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Finds the 95% interval of an estimated count of graph (refer to top)
+ * Assumes graph was sampled (graph->sample_fraction > 0)
+ *
+ * @param low set to the low end of the interval
+ * @param high set to the high end of the interval
+ */
+void find_sample_interval(histogram* graph, unsigned long count, unsigned long* low, unsigned long* high);
+
+/**
+ * @returns the sample fraction for size data in bin_count bins to have
+ * 	the given relative error (refer to top), at most 1
+ */
+double pick_sample_fraction(unsigned long size, unsigned long bin_count, double error);
+
+/**
+ * Bins a fraction of the data of graph with thread_count threads
+ * (refer to top), setting graph->sample_fraction. A fraction of 1 (or
+ * more) bins all the data exactly, like process_data_parallel.
+ * Assumes the bins of graph were already set up, and the data is not
+ * integers.
+ */
+void process_data_sampled(histogram* graph, unsigned long thread_count, double fraction);
+
+#endif
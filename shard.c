@@ -0,0 +1,356 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Shard functions save, load and merge histograms of parts of a dataset
+ *
+ * Merging loads every shard, then each thread adds up one slice of the
+ * bins across all of the shards into the first one, so threads never
+ * touch the same counts and no locks or tree sum are needed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "histogram.h"
+#include "memory.h"
+#include "parallel_helpers.h"
+#include "shard.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* header of a shard file */
+typedef struct{
+	char magic[4]; /* always SHARD_MAGIC */
+	unsigned int version; /* SHARD_VERSION */
+	unsigned int scheme; /* a SHARD_SCHEME */
+	unsigned int padding;
+	unsigned long bin_count;
+	unsigned long sample_count; /* values the shard saw (binned or not) */
+	double min;
+	double max;
+	long int_min; /* SCHEME_INTEGER only */
+	unsigned long int_width; /* SCHEME_INTEGER only */
+}shard_header;
+
+/* a slice of bins for a thread to add up */
+typedef struct{
+	histogram** graphs; /* the loaded shards, added into the first (shared) */
+	unsigned long graph_count;
+	unsigned long start; /* first bin to add up */
+	unsigned long end; /* one past the last bin to add up */
+}merge_job;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Finds the range of one data file
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the range was found
+ * 	FAIL if the file has no data (and no range)
+ * 	ERROR if the file could not be read
+ */
+static int find_file_range(const char* path, double* min, double* max);
+
+/**
+ * Adds up the bins of one merge_job (thread function)
+ */
+static void* merge_bins(void* data);
+
+/**
+ * Checks two shards have exactly the same bins
+ *
+ * @returns true if their counts can simply be added
+ */
+static bool same_bins(histogram* a, histogram* b);
+
+/*	FUNCTIONS	======================================================*/
+
+static int find_file_range(const char* path, double* min, double* max){
+	FILE* file;
+	vector* vec;
+	unsigned long size, t;
+	int rc;
+
+	file = fopen(path, READ_ONLY);
+	if(!file){
+		printf(ERROR_FILENAME, path);
+		return ERROR;
+	}
+
+	/* the header (or the column file footer) may already know */
+	if(is_column_file(file)){
+		vec = create_vector_from_columns(file, 1);
+	}else{
+		rc = read_vector_header(file, &size, min, max);
+		if(rc == SUCCESS){
+			fclose(file);
+			return SUCCESS;
+		}else if(rc == ERROR){
+			fclose(file);
+			printf(ERROR_BAD_DATA);
+			return ERROR;
+		}
+
+		vec = create_vector_from_file(file, size, 1);
+	}
+	fclose(file);
+
+	if(!vec){
+		printf(ERROR_BAD_DATA);
+		return ERROR;
+	}
+
+	rc = SUCCESS;
+	decode_vector_dictionary(vec);
+	if(vec->has_range){
+		*min = vec->min;
+		*max = vec->max;
+	}else{
+
+		/* NaNs never compare, so they are skipped */
+		*min = INFINITY;
+		*max = -INFINITY;
+		for(t=0; t < vec->size; t++){
+			if(vec->array[t] < *min){
+				*min = vec->array[t];
+			}
+			if(vec->array[t] > *max){
+				*max = vec->array[t];
+			}
+		}
+
+		/* no data (or only NaNs) */
+		if(*min > *max){
+			rc = FAIL;
+		}
+	}
+
+	delete_vector(vec);
+	return rc;
+}
+
+int find_shard_range(char** paths, unsigned long path_count, double* min, double* max){
+	unsigned long t;
+	double file_min, file_max;
+	bool found;
+	int rc;
+
+	found = false;
+	for(t=0; t < path_count; t++){
+		rc = find_file_range(paths[t], &file_min, &file_max);
+
+		/* empty files do not change the range */
+		if(rc == FAIL){
+			continue;
+		}else if(rc){
+			return ERROR;
+		}
+
+		if(!found || file_min < *min){
+			*min = file_min;
+		}
+		if(!found || file_max > *max){
+			*max = file_max;
+		}
+		found = true;
+	}
+
+	return found ? SUCCESS : FAIL;
+}
+
+histogram* load_shard(const char* path, unsigned long* sample_count){
+	shard_header header;
+	histogram* graph;
+	FILE* file;
+	int rc;
+
+	file = fopen(path, READ_ONLY);
+	if(!file){
+		return NULL;
+	}
+
+	/* check the header is one we understand */
+	if(fread(&header, sizeof(shard_header), 1, file) != 1
+		|| memcmp(header.magic, SHARD_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != SHARD_VERSION
+		|| header.scheme > SCHEME_INTEGER
+		|| header.bin_count < 1
+		|| (header.scheme == SCHEME_INTEGER && header.int_width < 1)){
+		fclose(file);
+		return NULL;
+	}
+
+	graph = init_histogram(header.bin_count);
+	graph->min = header.min;
+	graph->max = header.max;
+	graph->bin_width = (header.max - header.min)/header.bin_count;
+	if(header.scheme == SCHEME_INTEGER){
+		graph->int_min = header.int_min;
+		graph->int_width = header.int_width;
+	}
+
+	/* the counts, then the exact upper bounds they were binned with */
+	rc = fread(graph->bin_counts, sizeof(unsigned long), graph->bin_count + REJECT_COUNT, file) != graph->bin_count + REJECT_COUNT
+		|| fread(graph->bin_maxes, sizeof(double), graph->bin_count, file) != graph->bin_count;
+	fclose(file);
+
+	/* cut short */
+	if(rc){
+		delete_histogram(graph);
+		return NULL;
+	}
+
+	*sample_count = header.sample_count;
+	return graph;
+}
+
+static void* merge_bins(void* data){
+	merge_job* job;
+	unsigned long* total;
+	unsigned long* counts;
+	unsigned long s, t;
+
+	job = (merge_job*)data;
+	total = job->graphs[0]->bin_counts;
+
+	/* one shard at a time, so each shard's counts are read in order */
+	for(s=1; s < job->graph_count; s++){
+		counts = job->graphs[s]->bin_counts;
+		for(t=job->start; t < job->end; t++){
+			total[t] += counts[t];
+		}
+	}
+
+	return NULL;
+}
+
+histogram* merge_shards(char** paths, unsigned long path_count, unsigned long thread_count, unsigned long* sample_count){
+	histogram** graphs;
+	histogram* merged;
+	merge_job* jobs;
+	pthread_t* threads;
+	unsigned long t, loaded, count;
+	int rc;
+
+	graphs = malloc(path_count*sizeof(histogram*));
+	*sample_count = 0;
+	merged = NULL;
+
+	/* load every shard, they must all have the first one's bins */
+	for(loaded=0; loaded < path_count; loaded++){
+		graphs[loaded] = load_shard(paths[loaded], &count);
+
+		if(!graphs[loaded]){
+			printf(ERROR_SHARD_LOAD, paths[loaded]);
+			break;
+		}else if(!same_bins(graphs[0], graphs[loaded])){
+			printf(ERROR_SHARD_BINS, paths[loaded], paths[0]);
+			delete_histogram(graphs[loaded]);
+			break;
+		}
+
+		*sample_count += count;
+	}
+
+	if(loaded == path_count && path_count > 0){
+
+		/* no more threads than bins */
+		if(thread_count > graphs[0]->bin_count){
+			thread_count = graphs[0]->bin_count;
+		}
+		if(thread_count < 1){
+			thread_count = 1;
+		}
+
+		jobs = malloc(thread_count*sizeof(merge_job));
+		threads = malloc(thread_count*sizeof(pthread_t));
+
+		for(t=0; t < thread_count; t++){
+			jobs[t].graphs = graphs;
+			jobs[t].graph_count = path_count;
+			jobs[t].start = calculate_start_index(t, thread_count, graphs[0]->bin_count + REJECT_COUNT);
+			jobs[t].end = calculate_start_index(t+1, thread_count, graphs[0]->bin_count + REJECT_COUNT);
+		}
+
+		/* this thread adds up the first slice itself */
+		for(t=1; t < thread_count; t++){
+			rc = pthread_create(&threads[t], NULL, merge_bins, &jobs[t]);
+			if(rc){
+				printf(ERROR_THREAD_CR, rc);
+				exit(ERROR);
+			}
+		}
+		merge_bins(&jobs[0]);
+		for(t=1; t < thread_count; t++){
+			rc = pthread_join(threads[t], NULL);
+			if(rc){
+				printf(ERROR_THREAD_JN, rc);
+				exit(ERROR);
+			}
+		}
+
+		free(jobs);
+		free(threads);
+
+		/* the first shard now holds the sum of all of them */
+		merged = graphs[0];
+	}
+
+	/* Delete what we dont need anymore */
+	for(t = merged ? 1 : 0; t < loaded; t++){
+		delete_histogram(graphs[t]);
+	}
+	free(graphs);
+
+	return merged;
+}
+
+static bool same_bins(histogram* a, histogram* b){
+	return a->bin_count == b->bin_count
+		&& a->min == b->min
+		&& a->max == b->max
+		&& a->int_min == b->int_min
+		&& a->int_width == b->int_width
+		&& memcmp(a->bin_maxes, b->bin_maxes, a->bin_count*sizeof(double)) == 0;
+}
+
+int save_shard(histogram* graph, unsigned long sample_count, const char* path){
+	shard_header header;
+	FILE* file;
+	int rc;
+
+	file = fopen(path, WRITE_ONLY);
+	if(!file){
+		return ERROR;
+	}
+
+	memset(&header, 0, sizeof(shard_header));
+	memcpy(header.magic, SHARD_MAGIC, sizeof(header.magic));
+	header.version = SHARD_VERSION;
+	header.scheme = graph->int_width ? SCHEME_INTEGER : SCHEME_UNIFORM;
+	header.bin_count = graph->bin_count;
+	header.sample_count = sample_count;
+	header.min = graph->min;
+	header.max = graph->max;
+	header.int_min = graph->int_min;
+	header.int_width = graph->int_width;
+
+	rc = SUCCESS;
+	if(fwrite(&header, sizeof(shard_header), 1, file) != 1
+		|| fwrite(graph->bin_counts, sizeof(unsigned long), graph->bin_count + REJECT_COUNT, file) != graph->bin_count + REJECT_COUNT
+		|| fwrite(graph->bin_maxes, sizeof(double), graph->bin_count, file) != graph->bin_count){
+		rc = ERROR;
+	}
+
+	if(fclose(file)){
+		rc = ERROR;
+	}
+
+	return rc;
+}
@@ -0,0 +1,80 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Shard functions save histograms of parts of a dataset (like the part
+ * on each machine of a cluster) so they can be merged exactly later.
+ *
+ * Shards only merge if they have the same bins, so when the parts do
+ * not share a known range, runs go in two phases:
+ * 1) every part finds its range (find_shard_range), and the ranges are
+ *    combined into the global range the same way
+ * 2) every part is binned over the global range and saved as a shard,
+ *    and the shards are merged (merge_shards)
+ *
+ * A range is written as an empty data file with a header range
+ * ("0 <min> <max>"), so range files can be given back to
+ * find_shard_range like any data file.
+ *
+ * Shard file layout (native byte order):
+ * <magic "HSHD"> <uint32 version> <uint32 scheme> <uint32 padding>
+ * <uint64 bin_count> <uint64 sample_count> <double min> <double max>
+ * <int64 int_min> <uint64 int_width>
+ * <uint64 counts[bin_count + REJECT_COUNT]> (the reject counters last,
+ * see histogram.h) <double upper_bounds[bin_count]>
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "histogram.h"
+
+/*	TYPES	==========================================================*/
+
+/* how the bins of a shard were made */
+typedef enum{
+	SCHEME_UNIFORM = 0, /* bin_count equal width bins from min to max */
+	SCHEME_INTEGER = 1 /* bins of int_width integers from int_min */
+}SHARD_SCHEME;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Finds the range of every given data file (or range file) together.
+ * Files with a range in their header (or column files) are not scanned.
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the range was found
+ * 	FAIL if a file had no data
+ * 	ERROR if a file could not be read
+ */
+int find_shard_range(char** paths, unsigned long path_count, double* min, double* max);
+
+/**
+ * Loads the shard at path as a histogram (with no data)
+ *
+ * @param sample_count set to the number of values the shard saw
+ * @returns NULL if the shard could not be read
+ */
+histogram* load_shard(const char* path, unsigned long* sample_count);
+
+/**
+ * Loads and adds up the given shards, with thread_count threads each
+ * adding up a slice of the bins
+ *
+ * @param sample_count set to the number of values all shards saw
+ * @returns the merged histogram, NULL if a shard could not be read or
+ * 	has different bins than the first one (the reason is printed)
+ */
+histogram* merge_shards(char** paths, unsigned long path_count, unsigned long thread_count, unsigned long* sample_count);
+
+/**
+ * Saves the given histogram as a shard at path
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the shard was written
+ * 	ERROR if it was not
+ */
+int save_shard(histogram* graph, unsigned long sample_count, const char* path);
+
+#endif
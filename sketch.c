@@ -0,0 +1,193 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Sketch functions keep a fine grained base histogram of a data file
+ *
+ * Sketch file layout (native byte order):
+ * <magic "HSKT"> <uint32 version> <uint64 sub_bin_count>
+ * <uint64 data_count> <double min> <double max>
+ * <file_stamp of the data file (uint64 size, int64 mtime sec, int64 nsec)>
+ * <uint64 counts[sub_bin_count + REJECT_COUNT]> (the reject counters last)
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "histogram.h"
+#include "memory.h"
+#include "reader.h"
+#include "sketch.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* header of a sketch file */
+typedef struct{
+	char magic[4]; /* always SKETCH_MAGIC */
+	unsigned int version; /* SKETCH_VERSION */
+	unsigned long sub_bin_count;
+	unsigned long data_count;
+	double min;
+	double max;
+	file_stamp data_stamp; /* the data file the sketch was made from */
+}sketch_header;
+
+/*	FUNCTIONS	======================================================*/
+
+sketch* build_sketch(histogram* graph, unsigned long thread_count){
+	histogram* sub_graph;
+	sketch* sk;
+
+	/* the sub-bins are just a histogram with a lot of bins */
+	sub_graph = init_histogram(SKETCH_BINS);
+	sub_graph->data = graph->data;
+	process_stats_range(sub_graph, graph->min, graph->max);
+
+	if(thread_count > 1 && thread_count <= graph->data->size){
+		process_data_parallel(sub_graph, thread_count, false, false, 0);
+	}else{
+		process_data_serial(sub_graph);
+	}
+
+	sk = malloc(sizeof(sketch));
+	sk->sub_bin_count = SKETCH_BINS;
+	sk->data_count = graph->data->size;
+	sk->min = graph->min;
+	sk->max = graph->max;
+
+	/* keep the counts, the data still belongs to graph */
+	sk->counts = sub_graph->bin_counts;
+	sub_graph->bin_counts = NULL;
+	sub_graph->data = NULL;
+	delete_histogram(sub_graph);
+
+	return sk;
+}
+
+void delete_sketch(sketch* sk){
+	if(sk){
+		free_block(sk->counts);
+		free(sk);
+	}
+}
+
+sketch* load_sketch(const char* path, const char* data_path){
+	struct stat sketch_stat;
+	sketch_header header;
+	sketch* sk;
+	FILE* file;
+	size_t read_count;
+
+	if(stat(path, &sketch_stat)){
+		return NULL;
+	}
+
+	file = fopen(path, READ_ONLY);
+	if(!file){
+		return NULL;
+	}
+
+	/* check the header is one we understand, and the counts it promises
+	 * are all there before allocating them */
+	if(fread(&header, sizeof(sketch_header), 1, file) != 1
+		|| memcmp(header.magic, SKETCH_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != SKETCH_VERSION
+		|| header.sub_bin_count != SKETCH_BINS
+		|| (unsigned long)sketch_stat.st_size != sizeof(sketch_header) + (header.sub_bin_count + REJECT_COUNT)*sizeof(unsigned long)){
+		fclose(file);
+		return NULL;
+	}
+
+	/* the data changed after the sketch was made */
+	if(!is_cache_fresh(path, data_path, &header.data_stamp)){
+		fclose(file);
+		return NULL;
+	}
+
+	sk = malloc(sizeof(sketch));
+	sk->sub_bin_count = header.sub_bin_count;
+	sk->data_count = header.data_count;
+	sk->min = header.min;
+	sk->max = header.max;
+	sk->counts = alloc_bin_counts(header.sub_bin_count);
+
+	read_count = fread(sk->counts, sizeof(unsigned long), sk->sub_bin_count + REJECT_COUNT, file);
+	fclose(file);
+
+	/* cut short */
+	if(read_count != sk->sub_bin_count + REJECT_COUNT){
+		delete_sketch(sk);
+		return NULL;
+	}
+
+	return sk;
+}
+
+void rebin_sketch(sketch* sk, histogram* graph){
+	unsigned long t, bin;
+	double sub_width, middle;
+
+	process_stats_range(graph, sk->min, sk->max);
+	memset(graph->bin_counts, 0, graph->bin_count*sizeof(unsigned long));
+
+	/* the sketch spans all the data, so its rejects are just the NaNs */
+	for(t=0; t < REJECT_COUNT; t++){
+		graph->bin_counts[graph->bin_count + t] = sk->counts[sk->sub_bin_count + t];
+	}
+
+	/* all data is the same value, which find_bin puts in the last bin */
+	if(graph->bin_width <= 0){
+		for(t=0; t < sk->sub_bin_count; t++){
+			graph->bin_counts[graph->bin_count-1] += sk->counts[t];
+		}
+		return;
+	}
+
+	sub_width = (sk->max - sk->min) / sk->sub_bin_count;
+
+	/* every sub-bin goes to the bin holding its middle */
+	for(t=0; t < sk->sub_bin_count; t++){
+		middle = sk->min + sub_width*(t + 0.5);
+		bin = (unsigned long)((middle - sk->min) / graph->bin_width);
+
+		if(bin >= graph->bin_count){
+			bin = graph->bin_count-1;
+		}
+		graph->bin_counts[bin] += sk->counts[t];
+	}
+}
+
+int save_sketch(sketch* sk, const char* path, const file_stamp* data_stamp){
+	sketch_header header;
+	FILE* file;
+	int rc;
+
+	file = fopen(path, WRITE_ONLY);
+	if(!file){
+		return ERROR;
+	}
+
+	memset(&header, 0, sizeof(sketch_header));
+	memcpy(header.magic, SKETCH_MAGIC, sizeof(header.magic));
+	header.version = SKETCH_VERSION;
+	header.sub_bin_count = sk->sub_bin_count;
+	header.data_count = sk->data_count;
+	header.min = sk->min;
+	header.max = sk->max;
+	header.data_stamp = *data_stamp;
+
+	rc = SUCCESS;
+	if(fwrite(&header, sizeof(sketch_header), 1, file) != 1
+		|| fwrite(sk->counts, sizeof(unsigned long), sk->sub_bin_count + REJECT_COUNT, file) != sk->sub_bin_count + REJECT_COUNT){
+		rc = ERROR;
+	}
+
+	if(fclose(file)){
+		rc = ERROR;
+	}
+
+	return rc;
+}
@@ -0,0 +1,85 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Sketch functions keep a fine grained base histogram of a data file
+ * so histograms with any (coarser) number of bins can be answered
+ * without reading the data again.
+ *
+ * A sketch is SKETCH_BINS uniform sub-bins over the exact min and max
+ * of the data, plus the number of data. It is saved next to the data
+ * file (FILENAME.sketch) with a stamp of the file, and reused while the
+ * file still has that stamp (see reader.h).
+ *
+ * Rebinning:
+ * Each sub-bin is added to the coarse bin that holds its midpoint, so
+ * answering a histogram costs O(SKETCH_BINS) no matter the data size.
+ *
+ * Error bounds:
+ * The min, max and total count are exact. With sub-bin width
+ * w = (max-min)/SKETCH_BINS, every coarse bin edge moves by at most w/2,
+ * so the count of a coarse bin is off by at most the counts of the
+ * (at most two) sub-bins that straddle its lower and upper edges.
+ * When SKETCH_BINS is a multiple of the bin count (any power of two up
+ * to SKETCH_BINS), the edges line up and the counts are exact (apart
+ * from floating point rounding of values sitting right on an edge).
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdbool.h>
+#include "histogram.h"
+#include "reader.h"
+
+/*	TYPES	==========================================================*/
+
+/* a fine grained base histogram */
+typedef struct{
+	unsigned long sub_bin_count; /* number of sub-bins (SKETCH_BINS) */
+	unsigned long data_count; /* number of data in the sketch */
+	double min; /* the exact min of the data */
+	double max; /* the exact max of the data */
+	unsigned long* counts; /* the count of each sub-bin (and rejects, see histogram.h) */
+}sketch;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Builds a sketch of the data of the given graph, binning it in
+ * parallel when thread_count is more than 1.
+ * Assumes the min and max of the graph were already found
+ * (process_stats)
+ */
+sketch* build_sketch(histogram* graph, unsigned long thread_count);
+
+/**
+ * Deletes the given sketch
+ */
+void delete_sketch(sketch* sk);
+
+/**
+ * Loads the sketch at the given path, if the data file at data_path
+ * has not changed since it was made
+ *
+ * @returns NULL if there is no usable sketch
+ */
+sketch* load_sketch(const char* path, const char* data_path);
+
+/**
+ * Sets the min, max, bins and bin counts of graph from the sketch
+ * (refer to top for the error bounds)
+ */
+void rebin_sketch(sketch* sk, histogram* graph);
+
+/**
+ * Saves the sketch to the given path, stamped with data_stamp (the data
+ * file as it was before the sketch was built)
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if the sketch was saved
+ * 	ERROR if the file could not be written
+ */
+int save_sketch(sketch* sk, const char* path, const file_stamp* data_stamp);
+
+#endif
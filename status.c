@@ -0,0 +1,35 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ * 
+ * Status functions print the progress messages unless quiet mode is on
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "status.h"
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* true if status messages are not printed */
+static bool quiet_mode;
+
+/*	FUNCTIONS	======================================================*/
+
+bool is_quiet_mode(void){
+	return quiet_mode;
+}
+
+void print_status(const char* format, ...){
+	va_list args;
+	
+	if(!quiet_mode){
+		va_start(args, format);
+		vprintf(format, args);
+		va_end(args);
+	}
+}
+
+void set_quiet_mode(bool quiet){
+	quiet_mode = quiet;
+}
@@ -0,0 +1,33 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ * 
+ * Status functions print the progress messages (like "Binning data in
+ * Serial...") that every step of the program prints, unless quiet mode
+ * is on. Batch runs over thousands of files use quiet mode.
+ */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <stdbool.h>
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * @returns true if quiet mode is on
+ */
+bool is_quiet_mode(void);
+
+/**
+ * Prints the given status message (printf style) unless quiet mode
+ * is on
+ */
+void print_status(const char* format, ...);
+
+/**
+ * Turns quiet mode on (no status messages) or off (the default)
+ */
+void set_quiet_mode(bool quiet);
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Checks that the binning kernels (see kernels.h) count every value in
+ * the bin find_bin gives it, for values sitting right on (and one double
+ * either side of) every bin edge, where a multiply and its fix up are
+ * most likely to be a bin off. Covers every bin count in the kernel
+ * table and a few others, enough values in one bin to flush the 16 bit
+ * counters, a partitioned histogram, and integer bins with power of two
+ * and other widths (both the reciprocal and the divide).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../histogram.h"
+#include "../kernels.h"
+#include "../memory.h"
+#include "../status.h"
+#include "../vector.h"
+#include "../config.h"
+#include "../return_code.h"
+
+#define CHECK_MIN -1.3
+#define CHECK_MAX 7.9
+#define CHECK_REPEATS (KERNEL_FLUSH_SIZE + 10) /* copies of one value, past a flush */
+#define CHECK_INT_COUNT 4096 /* values per integer check */
+
+/* bin counts to check: the kernel table, others, and a partitioned one */
+static const unsigned long bin_counts[] = {
+	1, 2, 3, 4, 5, 8, 10, 16, 20, 25, 32, 50, 64, 100, 128, 200, 256,
+	7, 99, 255, KERNEL_MAX_BINS + 1, 1000, PARTITION_MIN_BINS + 3
+};
+
+/* integer bins to check: int_min, the span to max, and the bin count */
+static const long int_ranges[][3] = {
+	{0, 1023, 16}, /* width 64, a shift */
+	{-50, 49, 10}, /* width 10 */
+	{-7, 1000, 3}, /* width 336 */
+	{3, 3000000, 7}, /* width 428572 */
+	{-4000000000L, 4000000000L, 5}, /* width 1600000001, offsets past 2^32 */
+	{0, 9000000000000L, 3} /* width past 2^32, divided */
+};
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Checks count_bins against find_bin for bin_count bins
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if every count matched, FAIL if not
+ */
+static int check_doubles(unsigned long bin_count);
+
+/**
+ * Checks count_bins_integers against plain division
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if every count matched, FAIL if not
+ */
+static int check_integers(long min, long max, unsigned long bin_count);
+
+/**
+ * Compares two counts arrays (with their reject counters)
+ *
+ * USES RETURN_CODE
+ * @returns SUCCESS if they are the same, FAIL if not (and prints the
+ * 	first difference)
+ */
+static int compare_counts(const char* name, unsigned long bin_count, unsigned long* expected, unsigned long* counts);
+
+/*	FUNCTIONS	======================================================*/
+
+static int check_doubles(unsigned long bin_count){
+	histogram* graph;
+	unsigned long* expected;
+	unsigned long* counts;
+	double* values;
+	unsigned long t, size, bin;
+	double edge;
+	char name[64];
+	int rc;
+
+	graph = init_histogram(bin_count);
+	graph->data = init_vector(0);
+	process_stats_range(graph, CHECK_MIN, CHECK_MAX);
+
+	/* every edge and the doubles either side of it, the rejects, and
+	 * a lot of one value so the narrow counters flush */
+	values = malloc((3*bin_count + 8 + CHECK_REPEATS)*sizeof(double));
+	size = 0;
+	for(t=0; t < bin_count; t++){
+		edge = graph->bin_maxes[t];
+		values[size++] = nextafter(edge, -INFINITY);
+		values[size++] = edge;
+		values[size++] = nextafter(edge, INFINITY);
+	}
+	values[size++] = graph->min;
+	values[size++] = nextafter(graph->min, -INFINITY);
+	values[size++] = nextafter(graph->min, INFINITY);
+	values[size++] = graph->max;
+	values[size++] = nextafter(graph->max, INFINITY);
+	values[size++] = NAN;
+	values[size++] = INFINITY;
+	values[size++] = -INFINITY;
+	for(t=0; t < CHECK_REPEATS; t++){
+		values[size++] = graph->bin_maxes[bin_count/2];
+	}
+
+	/* what count_bins does without a kernel */
+	expected = alloc_bin_counts(bin_count);
+	for(t=0; t < size; t++){
+		bin = find_bin(values[t], graph);
+		if(bin == bin_count){
+			bin += (values[t] > graph->max)*REJECT_OVERFLOW + (values[t] != values[t])*REJECT_NAN;
+		}
+		expected[bin] += 1;
+	}
+
+	counts = alloc_bin_counts(bin_count);
+	count_bins(graph, values, size, counts);
+
+	sprintf(name, "%lu bins", bin_count);
+	rc = compare_counts(name, bin_count, expected, counts);
+
+	free(values);
+	free_block(expected);
+	free_block(counts);
+	delete_histogram(graph);
+	return rc;
+}
+
+static int check_integers(long min, long max, unsigned long bin_count){
+	histogram* graph;
+	unsigned long* expected;
+	unsigned long* counts;
+	long* values;
+	unsigned long t, size, edge, offset, bin;
+	char name[64];
+	int rc;
+
+	graph = init_histogram(bin_count);
+	graph->data = init_vector_integers(0);
+	process_stats_range(graph, (double)min, (double)max);
+
+	/* every edge and the integers either side of it, the rejects, and
+	 * a spread of values in between */
+	values = malloc((3*(bin_count+1) + 2 + CHECK_INT_COUNT)*sizeof(long));
+	size = 0;
+	for(t=0; t <= bin_count; t++){
+		edge = (unsigned long)graph->int_min + t*graph->int_width;
+		values[size++] = (long)(edge - 1);
+		values[size++] = (long)edge;
+		values[size++] = (long)(edge + 1);
+	}
+	values[size++] = min;
+	values[size++] = max;
+	for(t=0; t < CHECK_INT_COUNT; t++){
+		values[size++] = min + (long)(((unsigned long)max - (unsigned long)min)/CHECK_INT_COUNT*t);
+	}
+
+	/* plain division */
+	expected = alloc_bin_counts(bin_count);
+	for(t=0; t < size; t++){
+		if(values[t] < graph->int_min){
+			expected[bin_count + REJECT_UNDERFLOW] += 1;
+			continue;
+		}
+		offset = (unsigned long)values[t] - (unsigned long)graph->int_min;
+		bin = offset / graph->int_width;
+		expected[(bin < bin_count) ? bin : bin_count + REJECT_OVERFLOW] += 1;
+	}
+
+	counts = alloc_bin_counts(bin_count);
+	count_bins_integers(graph, values, size, counts);
+
+	sprintf(name, "integers %ld to %ld in %lu bins", min, max, bin_count);
+	rc = compare_counts(name, bin_count, expected, counts);
+
+	free(values);
+	free_block(expected);
+	free_block(counts);
+	delete_histogram(graph);
+	return rc;
+}
+
+static int compare_counts(const char* name, unsigned long bin_count, unsigned long* expected, unsigned long* counts){
+	unsigned long t;
+
+	for(t=0; t < bin_count + REJECT_COUNT; t++){
+		if(expected[t] != counts[t]){
+			printf("kernel_check: %s, %s %lu expected %lu, counted %lu\n",
+				name, t < bin_count ? "bin" : "reject", t < bin_count ? t : t - bin_count, expected[t], counts[t]);
+			return FAIL;
+		}
+	}
+	return SUCCESS;
+}
+
+int main(void){
+	unsigned long t;
+	int rc;
+
+	set_quiet_mode(true);
+
+	rc = SUCCESS;
+	for(t=0; t < sizeof(bin_counts)/sizeof(bin_counts[0]); t++){
+		if(check_doubles(bin_counts[t])){
+			rc = FAIL;
+		}
+	}
+	for(t=0; t < sizeof(int_ranges)/sizeof(int_ranges[0]); t++){
+		if(check_integers(int_ranges[t][0], int_ranges[t][1], (unsigned long)int_ranges[t][2])){
+			rc = FAIL;
+		}
+	}
+
+	if(rc == SUCCESS){
+		printf("kernel_check: ok\n");
+	}
+	return rc;
+}
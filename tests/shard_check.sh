@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# @author Andre Allan Ponce
+# andreponce@null.net
+#
+# Checks the two phase shard workflow (see README, SHARDS): a data file
+# split into parts, with one process per part finding its range, then
+# binning its part over the agreed range into a shard, merges into the
+# same histogram as binning the whole file at once.
+#
+# usage: tests/shard_check.sh PROGRAM
+
+PROGRAM=${1:-./histo_program.out}
+PARTS=3
+SIZE=30000
+BINS=37
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+# deterministic data, with values on either side of zero and repeats
+awk -v size=$SIZE 'BEGIN{
+	print size
+	seed = 12345
+	for(t=0; t < size; t++){
+		seed = (seed*16807) % 2147483647
+		printf "%.6f\n", (seed/2147483647 - 0.3)*1000
+	}
+}' > "$dir/whole.txt"
+
+# split the data into parts, each with its own header
+tail -n +2 "$dir/whole.txt" > "$dir/values"
+split -n l/$PARTS "$dir/values" "$dir/part."
+for part in "$dir"/part.??; do
+	{ wc -l < "$part"; cat "$part"; } > "$part.txt"
+done
+
+# phase 1: every part finds its range (all at once), then they agree
+for part in "$dir"/part.*.txt; do
+	"$PROGRAM" range "$part" > "$part.range" &
+done
+wait
+"$PROGRAM" range "$dir"/part.*.txt.range > "$dir/global.range" || exit 1
+range=$(cut -d' ' -f2,3 "$dir/global.range")
+
+# phase 2: every part bins over the agreed range into a shard
+for part in "$dir"/part.*.txt; do
+	"$PROGRAM" -q -r $range -S "$part.shard" "$part" $BINS > /dev/null &
+done
+wait
+
+"$PROGRAM" merge -q -o csv "$dir"/part.*.txt.shard > "$dir/merged.csv" || exit 1
+"$PROGRAM" -q -o csv "$dir/whole.txt" $BINS > "$dir/whole.csv" || exit 1
+
+if ! cmp -s "$dir/merged.csv" "$dir/whole.csv"; then
+	echo "shard_check: merged shards differ from the whole file"
+	diff "$dir/whole.csv" "$dir/merged.csv" | head -n 10
+	exit 1
+fi
+
+echo "shard_check: ok"
@@ -0,0 +1,85 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Checks that advancing a window (see window.h) past many intervals in
+ * one jump gives the same counts and decayed weights as advancing it
+ * one interval at a time.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "../status.h"
+#include "../window.h"
+#include "../return_code.h"
+
+#define CHECK_BINS 4
+#define CHECK_INTERVALS 4
+#define CHECK_DECAY 0.5
+#define CHECK_JUMP 12 /* intervals skipped by the jump (more than CHECK_INTERVALS+1) */
+#define CHECK_TOLERANCE 1e-12
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Creates a window with a few values in its last three intervals
+ */
+static w_histogram* fill_window(void);
+
+/*	FUNCTIONS	======================================================*/
+
+static w_histogram* fill_window(void){
+	w_histogram* window;
+
+	window = init_w_histogram(0, 4, CHECK_BINS, CHECK_INTERVALS, 1, 0, CHECK_DECAY);
+	window_insert(window, 0.5);
+	window_advance(window, 1);
+	window_insert(window, 1.5);
+	window_insert(window, 1.5);
+	window_advance(window, 2);
+	window_insert(window, 2.5);
+	window_insert(window, 3.5);
+
+	return window;
+}
+
+int main(void){
+	w_histogram* stepped;
+	w_histogram* jumped;
+	unsigned long stepped_counts[CHECK_BINS], jumped_counts[CHECK_BINS];
+	double stepped_weights[CHECK_BINS], jumped_weights[CHECK_BINS];
+	unsigned long t;
+	int rc;
+
+	set_quiet_mode(true);
+	stepped = fill_window();
+	jumped = fill_window();
+
+	for(t=3; t <= 2 + CHECK_JUMP; t++){
+		window_advance(stepped, (double)t);
+	}
+	window_advance(jumped, (double)(2 + CHECK_JUMP));
+
+	window_snapshot(stepped, stepped_counts);
+	window_snapshot(jumped, jumped_counts);
+	window_snapshot_decayed(stepped, stepped_weights);
+	window_snapshot_decayed(jumped, jumped_weights);
+
+	rc = SUCCESS;
+	for(t=0; t < CHECK_BINS; t++){
+		if(stepped_counts[t] != jumped_counts[t]
+			|| fabs(stepped_weights[t] - jumped_weights[t]) > CHECK_TOLERANCE*fabs(stepped_weights[t])){
+			printf("window_check: bin %lu stepped %lu %.17g, jumped %lu %.17g\n",
+				t, stepped_counts[t], stepped_weights[t], jumped_counts[t], jumped_weights[t]);
+			rc = FAIL;
+		}
+	}
+
+	delete_w_histogram(stepped);
+	delete_w_histogram(jumped);
+
+	if(rc == SUCCESS){
+		printf("window_check: ok\n");
+	}
+	return rc;
+}
@@ -0,0 +1,319 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Tuner functions pick how to bin from a profile of the machine
+ *
+ * Every microbenchmark bins (or sums) TUNE_SAMPLE_SIZE values (fewer for
+ * the big histograms, which are slow) once to warm up and once timed,
+ * so measuring takes a fraction of a second.
+ * Status messages are turned off while measuring.
+ */
+
+#define _DEFAULT_SOURCE /* for rand_r, clock_gettime and _SC_NPROCESSORS_ONLN */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "histogram.h"
+#include "kernels.h"
+#include "memory.h"
+#include "status.h"
+#include "tuner.h"
+#include "config.h"
+#include "return_code.h"
+
+/*	TYPES	==========================================================*/
+
+/* what the machine was measured to do (also the profile file) */
+typedef struct{
+	char magic[4]; /* always TUNE_MAGIC */
+	unsigned int version; /* TUNE_VERSION */
+	unsigned long cpu_count; /* online cpus when measured */
+	double spawn_cost; /* ns to start and join one thread */
+	double sum_cost; /* ns to add one counter into another */
+	double small_cost; /* ns per value, TUNE_SMALL_BINS bins (a kernel) */
+	double cached_cost; /* ns per value, TUNE_CACHED_BINS bins (in cache) */
+	double direct_cost; /* ns per value, TUNE_LARGE_BINS bins counted directly */
+	double partitioned_cost; /* ns per value, TUNE_LARGE_BINS bins partitioned */
+	double integer_cost; /* ns per value, TUNE_CACHED_BINS integer bins */
+}machine_profile;
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* the profile, once loaded or measured */
+static machine_profile profile;
+static bool profile_ready = false;
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Fills in the profile, from the profile file if it has a usable one,
+ * otherwise by measuring (and saving it for next time)
+ */
+static void load_profile(void);
+
+/**
+ * @returns the ns now (monotonic)
+ */
+static double now(void);
+
+/**
+ * Does nothing (thread function for time_spawn)
+ */
+static void* spawn_nothing(void* data);
+
+/**
+ * @returns the ns per value of binning count values into bin_count bins
+ * 	(over 0 to 1) with one thread
+ */
+static double time_binning(double* values, unsigned long count, unsigned long bin_count);
+
+/**
+ * @returns the ns per value of binning count integers into bin_count
+ * 	integer bins with one thread
+ */
+static double time_integers(long* values, unsigned long count, unsigned long bin_count);
+
+/**
+ * @returns the ns to start and join one thread
+ */
+static double time_spawn(unsigned long cpu_count);
+
+/**
+ * @returns the ns to add one counter into another
+ */
+static double time_sum(unsigned long count);
+
+/*	FUNCTIONS	======================================================*/
+
+unsigned long count_cpus(void){
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cpus > 0) ? (unsigned long)cpus : 1;
+}
+
+static void load_profile(void){
+	machine_profile saved;
+	const char* home;
+	char* path;
+	double* values;
+	long* integers;
+	unsigned int seed;
+	unsigned long t;
+	FILE* file;
+	bool quiet;
+
+	/* the profile lives where the env var says, or in the home directory */
+	path = NULL;
+	if(getenv(TUNE_PROFILE_ENV)){
+		path = strdup(getenv(TUNE_PROFILE_ENV));
+	}else if((home = getenv("HOME"))){
+		path = malloc(strlen(home)+strlen(TUNE_PROFILE_NAME)+2);
+		sprintf(path, "%s/%s", home, TUNE_PROFILE_NAME);
+	}
+
+	/* a saved profile for this machine (and version) */
+	profile_ready = true;
+	file = path ? fopen(path, READ_ONLY) : NULL;
+	if(file){
+		if(fread(&saved, sizeof(machine_profile), 1, file) == 1
+			&& memcmp(saved.magic, TUNE_MAGIC, sizeof(saved.magic)) == 0
+			&& saved.version == TUNE_VERSION
+			&& saved.cpu_count == count_cpus()){
+			profile = saved;
+			fclose(file);
+			free(path);
+			return;
+		}
+		fclose(file);
+	}
+
+	print_status(TUNE_MSG, path ? path : "");
+
+	/* one set of values in 0 to 1 for every benchmark */
+	values = alloc_block(TUNE_SAMPLE_SIZE*sizeof(double));
+	integers = alloc_block(TUNE_SAMPLE_SIZE*sizeof(long));
+	seed = TUNE_SAMPLE_SIZE;
+	for(t=0; t < TUNE_SAMPLE_SIZE; t++){
+		values[t] = (double)rand_r(&seed)/RAND_MAX;
+		integers[t] = (long)(values[t]*TUNE_CACHED_BINS);
+	}
+
+	quiet = is_quiet_mode();
+	set_quiet_mode(true);
+
+	memset(&profile, 0, sizeof(machine_profile));
+	memcpy(profile.magic, TUNE_MAGIC, sizeof(profile.magic));
+	profile.version = TUNE_VERSION;
+	profile.cpu_count = count_cpus();
+	profile.spawn_cost = time_spawn(profile.cpu_count);
+	profile.sum_cost = time_sum(TUNE_SAMPLE_SIZE);
+	profile.small_cost = time_binning(values, TUNE_SAMPLE_SIZE, TUNE_SMALL_BINS);
+	profile.cached_cost = time_binning(values, TUNE_SAMPLE_SIZE, TUNE_CACHED_BINS);
+	profile.integer_cost = time_integers(integers, TUNE_SAMPLE_SIZE, TUNE_CACHED_BINS);
+	profile.partitioned_cost = time_binning(values, TUNE_LARGE_SAMPLE_SIZE, TUNE_LARGE_BINS);
+	set_partition_min_bins(ULONG_MAX);
+	profile.direct_cost = time_binning(values, TUNE_LARGE_SAMPLE_SIZE, TUNE_LARGE_BINS);
+	set_partition_min_bins(PARTITION_MIN_BINS);
+
+	set_quiet_mode(quiet);
+	free_block(values);
+	free_block(integers);
+
+	/* not being able to save just means measuring again next time */
+	file = path ? fopen(path, WRITE_ONLY) : NULL;
+	if(file){
+		if(fwrite(&profile, sizeof(machine_profile), 1, file) != 1){
+			printf(ERROR_TUNE_SAVE, path);
+		}
+		fclose(file);
+	}else if(path){
+		printf(ERROR_TUNE_SAVE, path);
+	}
+	free(path);
+}
+
+static double now(void){
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec*1e9 + time.tv_nsec;
+}
+
+unsigned long pick_thread_count(unsigned long data_count, unsigned long bin_count, bool integers){
+	unsigned long threads, best, levels, max_threads;
+	double cost, estimate, best_estimate;
+
+	if(!profile_ready){
+		load_profile();
+	}
+
+	/* big histograms are partitioned only if that measured faster */
+	if(profile.partitioned_cost < profile.direct_cost){
+		set_partition_min_bins(PARTITION_MIN_BINS);
+	}else{
+		set_partition_min_bins(ULONG_MAX);
+	}
+
+	/* cost of one value on one thread, for this kind of histogram */
+	if(integers){
+		cost = profile.integer_cost;
+	}else if(bin_count <= KERNEL_MAX_BINS){
+		cost = profile.small_cost;
+	}else if(bin_count < PARTITION_MIN_BINS){
+		cost = profile.cached_cost;
+	}else if(profile.partitioned_cost < profile.direct_cost){
+		cost = profile.partitioned_cost;
+	}else{
+		cost = profile.direct_cost;
+	}
+
+	/* no more threads than cpus, or than data */
+	max_threads = (profile.cpu_count < data_count) ? profile.cpu_count : data_count;
+
+	best = 1;
+	best_estimate = data_count*cost;
+	for(threads=2; threads <= max_threads; threads++){
+		for(levels=0; (1UL << levels) < threads; levels++);
+
+		estimate = data_count*cost/threads + threads*profile.spawn_cost
+			+ bin_count*profile.sum_cost*(levels + 2);
+		if(estimate < best_estimate){
+			best = threads;
+			best_estimate = estimate;
+		}
+	}
+
+	return best;
+}
+
+static void* spawn_nothing(void* data){
+	return data;
+}
+
+static double time_binning(double* values, unsigned long count, unsigned long bin_count){
+	histogram* graph;
+	double start, end;
+
+	graph = init_histogram(bin_count);
+	process_stats_range(graph, 0, 1);
+
+	count_bins(graph, values, count, graph->bin_counts);
+	start = now();
+	count_bins(graph, values, count, graph->bin_counts);
+	end = now();
+
+	delete_histogram(graph);
+	return (end - start)/count;
+}
+
+static double time_integers(long* values, unsigned long count, unsigned long bin_count){
+	histogram* graph;
+	double start, end;
+
+	graph = init_histogram(bin_count);
+	graph->int_min = 0;
+	graph->int_width = 1;
+
+	count_bins_integers(graph, values, count, graph->bin_counts);
+	start = now();
+	count_bins_integers(graph, values, count, graph->bin_counts);
+	end = now();
+
+	delete_histogram(graph);
+	return (end - start)/count;
+}
+
+static double time_spawn(unsigned long cpu_count){
+	pthread_t threads[TUNE_SPAWN_COUNT];
+	unsigned long t, count;
+	double start, end;
+
+	count = (cpu_count < TUNE_SPAWN_COUNT) ? cpu_count : TUNE_SPAWN_COUNT;
+	if(count < 2){
+		count = 2;
+	}
+
+	start = now();
+	for(t=0; t < count; t++){
+		if(pthread_create(&threads[t], NULL, spawn_nothing, NULL)){
+			count = t;
+			break;
+		}
+	}
+	for(t=0; t < count; t++){
+		pthread_join(threads[t], NULL);
+	}
+	end = now();
+
+	return (count > 0) ? (end - start)/count : 0;
+}
+
+static double time_sum(unsigned long count){
+	unsigned long* counts;
+	unsigned long* more_counts;
+	unsigned long t;
+	double start, end;
+
+	counts = alloc_counters(count);
+	more_counts = alloc_counters(count);
+
+	for(t=0; t < count; t++){
+		more_counts[t] = t;
+	}
+	start = now();
+	for(t=0; t < count; t++){
+		counts[t] += more_counts[t];
+	}
+	end = now();
+
+	free_block(counts);
+	free_block(more_counts);
+	return (end - start)/count;
+}
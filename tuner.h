@@ -0,0 +1,50 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Tuner functions pick how to bin (serial or parallel, how many
+ * threads, which counting strategy) from a profile of the machine.
+ *
+ * The profile comes from short microbenchmarks run the first time it is
+ * needed: how fast one thread bins values for a few kinds of histograms,
+ * and what starting a thread and summing counters cost. It is cached in
+ * a profile file (TUNE_PROFILE_ENV, or TUNE_PROFILE_NAME in the home
+ * directory) and measured again if the file is missing, from another
+ * version, or was made with a different number of cpus.
+ *
+ * Model:
+ * Binning N values into B bins with T threads is estimated as
+ * 	N*c/T + T*spawn + B*sum*(log2(T) + 2)
+ * where c is the profiled cost of one value for that kind of histogram
+ * (one thread), spawn is the cost of starting a thread and sum is the
+ * cost of adding one counter (each thread zeroes its counters, they are
+ * tree summed, then transferred). T = 1 is serial, without the
+ * thread and counter costs. The T with the lowest estimate is picked.
+ *
+ * Profile file layout (native byte order):
+ * <magic "HTUN"> <uint32 version> <uint64 cpu_count> <double costs...>
+ */
+
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <stdbool.h>
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * @returns the number of online cpus (at least 1)
+ */
+unsigned long count_cpus(void);
+
+/**
+ * Picks the number of threads to bin data_count values into bin_count
+ * bins with (1 means serial), loading or measuring the machine profile
+ * if it was not loaded yet. Also sets the counting strategy for big
+ * histograms (see set_partition_min_bins) to whichever was faster.
+ *
+ * @returns the thread count, at least 1 (and at most data_count)
+ */
+unsigned long pick_thread_count(unsigned long data_count, unsigned long bin_count, bool integers);
+
+#endif
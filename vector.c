@@ -3,66 +3,397 @@
  * andreponce@null.net
  * 
  * Vector array that holds the array of data (+ length)
+ * 
+ * For reading a file, the following format is used:
+ * <number of datas (n)> [<min> <max>]
+ * <data 1>
+ * ...
+ * <data n>
+ * The optional min and max give the range of the data up front.
+ * 
+ * Column files (see vector.h) are made of blocks encoded one of two ways:
+ * decimal	values with at most COLUMN_MAX_DECIMALS decimals are scaled to
+ * 		integers, delta encoded against the previous value, zigzagged
+ * 		(so small negative deltas are small) and bit packed to the
+ * 		width of the biggest delta
+ * xor		anything else is xored with the previous value's bits, and
+ * 		only the bytes between the leading and trailing zero bytes are
+ * 		kept, after a control byte (trailing zero bytes << 4 | kept bytes)
+ * 
+ * Dictionary data (see vector.h) is looked up in an open addressing
+ * table of 2^DICTIONARY_TABLE_BITS slots, keyed by the bits of a value
+ * (so -0 and 0, or two NaNs, may be different values; they still bin
+ * the same). A slot holds the code of its value plus one, 0 is empty.
  */
 
+#define _POSIX_C_SOURCE 200809L /* for rand_r and pread */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "vector.h"
+#include "memory.h"
+#include "parallel_helpers.h"
+#include "reader.h"
+#include "status.h"
 #include "config.h"
+#include "return_code.h"
 
 #define INPUT_BUFFER_SIZE 100
+#define READ_BUFFER_SIZE (1024*1024)
+
+/* how a column block is encoded */
+#define CODEC_XOR 0
+#define CODEC_DECIMAL 1
+
+/*	TYPES	==========================================================*/
+
+/* a slice of a vector for a thread to place */
+typedef struct{
+	vector* vec; /* the vector being placed (shared) */
+	unsigned long thread_id;
+	unsigned long thread_count;
+	bool random; /* fill with random data instead of zeros */
+	unsigned int seed; /* seed for random data */
+}place_job;
+
+/* header at the start of a column file */
+typedef struct{
+	char magic[4]; /* always COLUMN_MAGIC */
+	unsigned int version; /* COLUMN_VERSION */
+	unsigned long block_size; /* values per block (the last may have less) */
+}column_header;
+
+/* footer entry for one block of a column file */
+typedef struct{
+	unsigned long offset; /* where the block starts in the file */
+	unsigned long length; /* bytes of the encoded block */
+	unsigned long count; /* values in the block */
+	double min; /* the min value in the block */
+	double max; /* the max value in the block */
+}column_block;
+
+/* trailer at the very end of a column file */
+typedef struct{
+	unsigned long block_count; /* number of blocks (and footer entries) */
+	unsigned long size; /* number of values in the file */
+	double min; /* the min value in the file */
+	double max; /* the max value in the file */
+	unsigned long footer_offset; /* where the footer starts in the file */
+	char magic[4]; /* always COLUMN_MAGIC */
+	unsigned int version; /* COLUMN_VERSION */
+}column_trailer;
+
+/* header of an encoded block */
+typedef struct{
+	unsigned char codec; /* CODEC_XOR or CODEC_DECIMAL */
+	unsigned char decimals; /* decimal: values were scaled by 10^decimals */
+	unsigned char width; /* decimal: bits per packed delta */
+	unsigned char padding[5];
+	long base; /* decimal: the first scaled value */
+}encoded_header;
+
+/* a range of column blocks for a thread to decode */
+typedef struct{
+	vector* vec; /* where the values go (shared) */
+	column_block* blocks; /* every block of the file (shared) */
+	unsigned long block_count;
+	unsigned long block_size;
+	int fd; /* the column file */
+	unsigned long thread_id;
+	unsigned long thread_count;
+	int rc; /* RETURN_CODE of the decode */
+}decode_job;
+
+/*	PRIVATE VARIABLE	==============================================*/
+
+/* exact powers of ten for the decimal codec */
+static const double powers_of_ten[COLUMN_MAX_DECIMALS+1] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Decodes one encoded block (length bytes) into count values
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the block decoded to exactly count values
+ * 	FAIL if the block is corrupt
+ */
+static int decode_block(unsigned char* in, size_t length, double* values, unsigned long count);
+
+/**
+ * Thread function that reads and decodes its range of blocks straight
+ * into the vector (decode_job)
+ */
+static void* decode_blocks(void* data);
+
+/**
+ * Encodes count values into the codes of vec (starting at code start),
+ * adding new distinct values to its dictionary and table
+ * 
+ * @returns the number of values encoded, less than count if the
+ * 	dictionary filled up (refer to top)
+ */
+static unsigned long encode_dictionary(vector* vec, unsigned short* table, double* values, unsigned long count, unsigned long start);
+
+/**
+ * Encodes count values into out, which must have room for
+ * sizeof(encoded_header) + 9*count bytes, and finds their min and max
+ * 
+ * @returns the number of bytes written
+ */
+static size_t encode_block(double* values, unsigned long count, unsigned char* out, double* min, double* max);
+
+/**
+ * Encodes the values with the decimal codec, if they all fit it
+ * 
+ * @returns the number of bytes written, 0 if the values do not fit
+ */
+static size_t encode_decimal(double* values, unsigned long count, unsigned char* out);
+
+/**
+ * Encodes the values with the xor codec
+ * 
+ * @returns the number of bytes written
+ */
+static size_t encode_xor(double* values, unsigned long count, unsigned char* out);
+
+/**
+ * Turns the first count codes of dictionary data into a plain array
+ * (vec->size long, placed by thread_count threads if more than 1)
+ */
+static void expand_dictionary(vector* vec, unsigned long count, unsigned long thread_count);
+
+/**
+ * Reads up to vec->size numbers from file into the dictionary data vec
+ * like read_vector_values, switching to a plain array if there are too
+ * many distinct values (refer to top)
+ * 
+ * USES RETURN_CODE
+ * @returns same codes as read_vector_values
+ */
+static int read_dictionary(FILE* file, vector* vec, unsigned long thread_count, unsigned long* count);
+
+/**
+ * Reads up to size numbers (longs if integers, else doubles) from
+ * file into values, with large buffered reads
+ * 
+ * USES RETURN_CODE
+ * @returns same codes as read_vector_values
+ */
+static int read_numbers(FILE* file, void* values, bool integers, unsigned long size, unsigned long* count);
+
+/**
+ * Thread function that pins itself and then writes to (first touches)
+ * its slice of the vector (place_job)
+ */
+static void* place_slice(void* data);
+
+/**
+ * Has thread_count pinned threads first touch their slices of vec
+ * 
+ * @param random true to fill the slices with random doubles, false
+ * 	to fill them with zeros
+ */
+static void place_vector(vector* vec, unsigned long thread_count, bool random);
+
+/**
+ * Makes the codes of dictionary data 2 bytes wide, keeping the first
+ * count of them
+ */
+static void widen_codes(vector* vec, unsigned long count);
 
 /*	FUNCTIONS	======================================================*/
 
-vector* create_vector_from_file(FILE* file){
-	char buffer[INPUT_BUFFER_SIZE];
+vector* create_vector_from_columns(FILE* file, unsigned long thread_count){
+	column_header header;
+	column_trailer trailer;
+	column_block* blocks;
+	decode_job* jobs;
+	pthread_t* threads;
+	struct stat file_stat;
 	vector* vec;
-	int rc;
-	bool no_overflow;
-	unsigned long size,index;
-	double num;
+	unsigned long t, total;
+	size_t footer_length;
+	int fd, rc;
 	
-	/* first line of the file should be size */
-	fgets(buffer,INPUT_BUFFER_SIZE,file);
-	rc = sscanf(buffer,"%lu",&size);
+	fd = fileno(file);
 	
-	/* no size is bad */
-	if(rc < 1){
+	/* check the header and trailer are ones we understand */
+	if(fstat(fd, &file_stat) || file_stat.st_size < (off_t)(sizeof(column_header) + sizeof(column_trailer))){
+		return NULL;
+	}
+	if(pread(fd, &header, sizeof(column_header), 0) != sizeof(column_header)
+		|| pread(fd, &trailer, sizeof(column_trailer), file_stat.st_size - sizeof(column_trailer)) != sizeof(column_trailer)){
+		return NULL;
+	}
+	if(memcmp(header.magic, COLUMN_MAGIC, sizeof(header.magic)) != 0 || header.version != COLUMN_VERSION
+		|| memcmp(trailer.magic, COLUMN_MAGIC, sizeof(trailer.magic)) != 0 || trailer.version != COLUMN_VERSION
+		|| header.block_size < 1 || header.block_size > COLUMN_BLOCK_MAX){
 		return NULL;
 	}
 	
-	/* initalize the vector */
-	vec = init_vector(size);
-	index = 0;
+	/* the footer sits right before the trailer */
+	footer_length = file_stat.st_size - sizeof(column_trailer) - trailer.footer_offset;
+	if(trailer.footer_offset > file_stat.st_size - sizeof(column_trailer)
+		|| footer_length != trailer.block_count*sizeof(column_block)){
+		return NULL;
+	}
 	
-	/* if the file has more lines than the given size, stop reading*/
-	no_overflow = true;
+	blocks = malloc(footer_length > 0 ? footer_length : 1);
+	if(pread(fd, blocks, footer_length, trailer.footer_offset) != (ssize_t)footer_length){
+		free(blocks);
+		return NULL;
+	}
 	
-	while( fgets(buffer,INPUT_BUFFER_SIZE,file) != NULL && no_overflow){
-		
-		/* read a number */
-		rc = sscanf(buffer,"%lf",&num);
-		
-		/* no number means get out of here */
-		if(rc < 1){
-			
-			/* free the vector */
-			delete_vector(vec);
+	/* every block is full except the last, and they add up to the size */
+	total = 0;
+	for(t=0; t < trailer.block_count; t++){
+		if(blocks[t].count > header.block_size || (t < trailer.block_count-1 && blocks[t].count != header.block_size)
+			|| blocks[t].length > sizeof(encoded_header) + 9*header.block_size){
+			free(blocks);
 			return NULL;
-		}else{
+		}
+		total += blocks[t].count;
+	}
+	if(total != trailer.size){
+		free(blocks);
+		return NULL;
+	}
+	
+	vec = init_vector(trailer.size);
+	
+	/* the footer already knows the range, no need to scan for it */
+	vec->has_range = trailer.size > 0;
+	vec->min = trailer.min;
+	vec->max = trailer.max;
+	
+	/* no more threads than blocks */
+	if(thread_count > trailer.block_count){
+		thread_count = trailer.block_count;
+	}
+	if(thread_count < 1){
+		thread_count = 1;
+	}
+	
+	print_status(VEC_COL_MSG, trailer.block_count, thread_count);
+	
+	jobs = malloc(thread_count*sizeof(decode_job));
+	threads = malloc(thread_count*sizeof(pthread_t));
+	
+	for(t=0; t < thread_count; t++){
+		jobs[t].vec = vec;
+		jobs[t].blocks = blocks;
+		jobs[t].block_count = trailer.block_count;
+		jobs[t].block_size = header.block_size;
+		jobs[t].fd = fd;
+		jobs[t].thread_id = t;
+		jobs[t].thread_count = thread_count;
+		jobs[t].rc = SUCCESS;
+	}
+	
+	/* decode in this thread, or in parallel */
+	if(thread_count == 1){
+		decode_blocks((void*)&jobs[0]);
+	}else{
+		for(t=0; t < thread_count; t++){
+			rc = pthread_create(&threads[t], NULL, decode_blocks, (void*)&jobs[t]);
 			
-			/* file should not have more lines than the given size */
-			if(index < size){
-				vec->array[index++] = num;
-			}else{
-				
-				/* file has more lines than the given size */
-				no_overflow = false;
+			/* problem creating thread */
+			if(rc){
+				printf(ERROR_THREAD_CR, rc);
+				exit(ERROR);
+			}
+		}
+		
+		for(t=0; t < thread_count; t++){
+			rc = pthread_join(threads[t], NULL);
+			
+			/* error joining thread */
+			if(rc){
+				printf(ERROR_THREAD_JN, rc);
+				exit(ERROR);
 			}
 		}
 	}
+	
+	/* any bad block means bad data */
+	rc = SUCCESS;
+	for(t=0; t < thread_count; t++){
+		if(jobs[t].rc){
+			rc = jobs[t].rc;
+		}
+	}
+	
+	free(blocks);
+	free(jobs);
+	free(threads);
+	
+	if(rc){
+		delete_vector(vec);
+		return NULL;
+	}
+	return vec;
+}
+
+vector* create_vector_from_file(FILE* file, unsigned long size, unsigned long thread_count){
+	vector* vec;
+	unsigned long count;
+	
+	/* start out as dictionary data, the array is only made (and
+	 * placed) if the data has too many distinct values */
+	print_status(VEC_MSG,size);
+	vec = malloc(sizeof(vector));
+	vec->array = NULL;
+	vec->integers = NULL;
+	vec->dictionary = malloc(DICTIONARY_MAX_SIZE*sizeof(double));
+	vec->dictionary_counts = calloc(DICTIONARY_MAX_SIZE, sizeof(unsigned long));
+	vec->dictionary_size = 0;
+	vec->codes = alloc_block(size);
+	vec->code_size = 1;
+	vec->size = size;
+	vec->has_range = false;
+	vec->min = 0;
+	vec->max = 0;
+	
+	/* read the data, a bad number means get out of here */
+	if(read_dictionary(file, vec, thread_count, &count)){
+		delete_vector(vec);
+		return NULL;
+	}
+	
+	/* the file may have less data than it said */
+	vec->size = count;
+	
+	if(vec->dictionary){
+		print_status(VEC_DICT_MSG,vec->dictionary_size);
+	}
+	
+	return vec;
+}
+
+vector* create_vector_integers_from_file(FILE* file, unsigned long size){
+	vector* vec;
+	unsigned long count;
+	
+	vec = init_vector_integers(size);
+	
+	/* read the data, a bad integer means get out of here */
+	if(read_vector_integers(file, vec->integers, size, &count)){
+		delete_vector(vec);
+		return NULL;
+	}
+	
+	/* the file may have less data than it said */
+	vec->size = count;
+	
 	return vec;
 }
 
@@ -84,25 +415,848 @@ vector* create_vector_random(unsigned long size){
 	return vec;
 }
 
+vector* create_vector_random_integers(unsigned long size){
+	vector* vec;
+	unsigned long t;
+	
+	vec = init_vector_integers(size);
+	
+	/* set the seed */
+	srand(time(NULL));
+	
+	for(t=0; t < size; t++){
+		
+		/* gets random integers from 0 to RAND_INT_MAX */
+		vec->integers[t] = rand() % (RAND_INT_MAX + 1);
+	}
+	
+	return vec;
+}
+
+vector* create_vector_random_parallel(unsigned long size, unsigned long thread_count){
+	vector* vec;
+	
+	vec = init_vector(size);
+	
+	/* set the seed, each thread offsets it by its id */
+	srand(time(NULL));
+	
+	place_vector(vec, thread_count, true);
+	
+	return vec;
+}
+
+static int decode_block(unsigned char* in, size_t length, double* values, unsigned long count){
+	encoded_header header;
+	unsigned long* words;
+	unsigned long t, position, word, shift, mask, packed, bits, changed;
+	unsigned int trailing, kept, j;
+	size_t index;
+	long current;
+	double scale;
+	
+	if(length < sizeof(encoded_header)){
+		return FAIL;
+	}
+	memcpy(&header, in, sizeof(encoded_header));
+	in += sizeof(encoded_header);
+	length -= sizeof(encoded_header);
+	
+	if(header.codec == CODEC_DECIMAL){
+		if(header.decimals > COLUMN_MAX_DECIMALS || header.width > 64
+			|| length != ((count*header.width + 63)/64)*sizeof(unsigned long)){
+			return FAIL;
+		}
+		
+		/* the packed words come right after the (8 byte aligned) header */
+		words = (unsigned long*) in;
+		mask = (header.width < 64) ? (1UL << header.width) - 1 : ~0UL;
+		scale = powers_of_ten[header.decimals];
+		current = header.base;
+		
+		for(t=0; t < count; t++){
+			packed = 0;
+			if(header.width > 0){
+				position = t*header.width;
+				word = position >> 6;
+				shift = position & 63;
+				packed = words[word] >> shift;
+				if(shift + header.width > 64){
+					packed |= words[word+1] << (64 - shift);
+				}
+				packed &= mask;
+			}
+			
+			/* undo the zigzag, then the delta */
+			current += (long)(packed >> 1) ^ -(long)(packed & 1);
+			values[t] = (double)current / scale;
+		}
+		return SUCCESS;
+	}
+	
+	if(header.codec == CODEC_XOR){
+		bits = 0;
+		index = 0;
+		
+		for(t=0; t < count; t++){
+			if(index >= length){
+				return FAIL;
+			}
+			trailing = in[index] >> 4;
+			kept = in[index] & 15;
+			index += 1;
+			
+			if(trailing + kept > 8 || index + kept > length){
+				return FAIL;
+			}
+			
+			changed = 0;
+			for(j=0; j < kept; j++){
+				changed |= (unsigned long)in[index++] << (8*(trailing + j));
+			}
+			bits ^= changed;
+			memcpy(&values[t], &bits, sizeof(double));
+		}
+		return (index == length) ? SUCCESS : FAIL;
+	}
+	
+	return FAIL;
+}
+
+static void* decode_blocks(void* data){
+	decode_job* job;
+	column_block* block;
+	unsigned char* buffer;
+	size_t capacity;
+	unsigned long start_index, end_index, t;
+	
+	job = (decode_job*) data;
+	start_index = calculate_start_index(job->thread_id, job->thread_count, job->block_count);
+	end_index = calculate_end_index(job->thread_id, job->thread_count, job->block_count) + 1;
+	buffer = NULL;
+	capacity = 0;
+	
+	for(t=start_index; t < end_index && job->rc == SUCCESS; t++){
+		block = &job->blocks[t];
+		
+		/* only grow the buffer when a block does not fit */
+		if(block->length > capacity){
+			free_block(buffer);
+			buffer = alloc_block(block->length);
+			capacity = block->length;
+		}
+		
+		if(pread(job->fd, buffer, block->length, block->offset) != (ssize_t)block->length){
+			job->rc = ERROR;
+		}else{
+			job->rc = decode_block(buffer, block->length, job->vec->array + t*job->block_size, block->count);
+		}
+	}
+	
+	free_block(buffer);
+	return NULL;
+}
+
+void decode_vector_dictionary(vector* vec){
+	if(vec->dictionary){
+		expand_dictionary(vec, vec->size, 1);
+	}
+}
+
 void delete_vector(vector* vec){
 	if(vec){
 		if(vec->array){
-			free(vec->array);
+			free_block(vec->array);
+		}
+		if(vec->integers){
+			free_block(vec->integers);
+		}
+		if(vec->dictionary){
+			free(vec->dictionary);
+			free(vec->dictionary_counts);
+			free_block(vec->codes);
 		}
 		free(vec);
 	}
 }
 
+static unsigned long encode_dictionary(vector* vec, unsigned short* table, double* values, unsigned long count, unsigned long start){
+	unsigned long t, bits, slot, code;
+	
+	for(t=0; t < count; t++){
+		
+		/* find the value's slot, or the empty slot it goes in */
+		memcpy(&bits, &values[t], sizeof(bits));
+		slot = (bits*DICTIONARY_HASH) >> (64 - DICTIONARY_TABLE_BITS);
+		while(table[slot] && memcmp(&vec->dictionary[table[slot]-1], &values[t], sizeof(double))){
+			slot = (slot + 1) & ((1UL << DICTIONARY_TABLE_BITS) - 1);
+		}
+		
+		/* a new distinct value (if there is room for it) */
+		if(!table[slot]){
+			if(vec->dictionary_size == DICTIONARY_MAX_SIZE){
+				return t;
+			}
+			if(vec->dictionary_size == DICTIONARY_NARROW_SIZE){
+				widen_codes(vec, start + t);
+			}
+			vec->dictionary[vec->dictionary_size] = values[t];
+			vec->dictionary_size += 1;
+			table[slot] = (unsigned short)vec->dictionary_size;
+		}
+		
+		code = table[slot] - 1;
+		vec->dictionary_counts[code] += 1;
+		if(vec->code_size == 1){
+			((unsigned char*)vec->codes)[start + t] = (unsigned char)code;
+		}else{
+			((unsigned short*)vec->codes)[start + t] = (unsigned short)code;
+		}
+	}
+	
+	return count;
+}
+
+static size_t encode_block(double* values, unsigned long count, unsigned char* out, double* min, double* max){
+	unsigned long t;
+	size_t length;
+	
+	*min = (count > 0) ? values[0] : 0;
+	*max = (count > 0) ? values[0] : 0;
+	for(t=1; t < count; t++){
+		if(values[t] < *min){
+			*min = values[t];
+		}
+		if(values[t] > *max){
+			*max = values[t];
+		}
+	}
+	
+	/* decimal data packs much tighter, everything else is xored */
+	length = encode_decimal(values, count, out);
+	if(length == 0){
+		length = encode_xor(values, count, out);
+	}
+	return length;
+}
+
+static size_t encode_decimal(double* values, unsigned long count, unsigned char* out){
+	encoded_header header;
+	unsigned long* words;
+	unsigned long t, decimals, packed, biggest, position, word, shift, word_count;
+	long current, previous;
+	double scaled;
+	bool fits;
+	
+	if(count < 1){
+		return 0;
+	}
+	
+	/* find the fewest decimals that give back every value exactly */
+	fits = false;
+	for(decimals=0; decimals <= COLUMN_MAX_DECIMALS && !fits; decimals++){
+		fits = true;
+		for(t=0; t < count && fits; t++){
+			scaled = values[t]*powers_of_ten[decimals];
+			fits = fabs(scaled) < COLUMN_INT_LIMIT && (double)(long)round(scaled) / powers_of_ten[decimals] == values[t];
+		}
+	}
+	if(!fits){
+		return 0;
+	}
+	decimals -= 1;
+	
+	/* the biggest zigzagged delta sets the width */
+	previous = (long)round(values[0]*powers_of_ten[decimals]);
+	biggest = 0;
+	for(t=0; t < count; t++){
+		current = (long)round(values[t]*powers_of_ten[decimals]);
+		packed = ((unsigned long)(current - previous) << 1) ^ (unsigned long)((current - previous) >> 63);
+		previous = current;
+		if(packed > biggest){
+			biggest = packed;
+		}
+	}
+	
+	memset(&header, 0, sizeof(encoded_header));
+	header.codec = CODEC_DECIMAL;
+	header.decimals = decimals;
+	header.width = (biggest > 0) ? 64 - __builtin_clzl(biggest) : 0;
+	header.base = (long)round(values[0]*powers_of_ten[decimals]);
+	memcpy(out, &header, sizeof(encoded_header));
+	
+	/* pack the deltas, after the (8 byte aligned) header */
+	words = (unsigned long*)(out + sizeof(encoded_header));
+	word_count = (count*header.width + 63)/64;
+	memset(words, 0, word_count*sizeof(unsigned long));
+	
+	if(header.width > 0){
+		previous = header.base;
+		for(t=0; t < count; t++){
+			current = (long)round(values[t]*powers_of_ten[decimals]);
+			packed = ((unsigned long)(current - previous) << 1) ^ (unsigned long)((current - previous) >> 63);
+			previous = current;
+			
+			position = t*header.width;
+			word = position >> 6;
+			shift = position & 63;
+			words[word] |= packed << shift;
+			if(shift + header.width > 64){
+				words[word+1] |= packed >> (64 - shift);
+			}
+		}
+	}
+	
+	return sizeof(encoded_header) + word_count*sizeof(unsigned long);
+}
+
+static size_t encode_xor(double* values, unsigned long count, unsigned char* out){
+	encoded_header header;
+	unsigned long t, bits, previous, changed;
+	unsigned int trailing, kept, j;
+	size_t length;
+	
+	memset(&header, 0, sizeof(encoded_header));
+	header.codec = CODEC_XOR;
+	memcpy(out, &header, sizeof(encoded_header));
+	length = sizeof(encoded_header);
+	
+	previous = 0;
+	for(t=0; t < count; t++){
+		memcpy(&bits, &values[t], sizeof(double));
+		changed = bits ^ previous;
+		previous = bits;
+		
+		/* same bits as the last value */
+		if(changed == 0){
+			out[length++] = 0;
+			continue;
+		}
+		
+		/* keep only the bytes between the zero bytes */
+		trailing = __builtin_ctzl(changed)/8;
+		kept = 8 - trailing - __builtin_clzl(changed)/8;
+		out[length++] = (unsigned char)((trailing << 4) | kept);
+		for(j=0; j < kept; j++){
+			out[length++] = (unsigned char)(changed >> (8*(trailing + j)));
+		}
+	}
+	
+	return length;
+}
+
+static void expand_dictionary(vector* vec, unsigned long count, unsigned long thread_count){
+	unsigned long t;
+	
+	vec->array = alloc_block(vec->size*sizeof(double));
+	if(thread_count > 1){
+		place_vector(vec, thread_count, false);
+	}
+	
+	if(vec->code_size == 1){
+		for(t=0; t < count; t++){
+			vec->array[t] = vec->dictionary[((unsigned char*)vec->codes)[t]];
+		}
+	}else{
+		for(t=0; t < count; t++){
+			vec->array[t] = vec->dictionary[((unsigned short*)vec->codes)[t]];
+		}
+	}
+	
+	free(vec->dictionary);
+	free(vec->dictionary_counts);
+	free_block(vec->codes);
+	vec->dictionary = NULL;
+	vec->dictionary_counts = NULL;
+	vec->dictionary_size = 0;
+	vec->codes = NULL;
+	vec->code_size = 0;
+}
+
 vector* init_vector(unsigned long size){
 	vector* vec;
 	
-	printf(VEC_MSG,size);
+	print_status(VEC_MSG,size);
+	
+	vec = malloc(sizeof(vector));
+	vec->array = alloc_block(size*sizeof(double));
+	vec->integers = NULL;
+	vec->dictionary = NULL;
+	vec->dictionary_counts = NULL;
+	vec->dictionary_size = 0;
+	vec->codes = NULL;
+	vec->code_size = 0;
+	vec->size = size;
+	vec->has_range = false;
+	vec->min = 0;
+	vec->max = 0;
+	
+	return vec;
+}
+
+vector* init_vector_integers(unsigned long size){
+	vector* vec;
+	
+	print_status(VEC_MSG,size);
 	
 	vec = malloc(sizeof(vector));
-	vec->array = malloc(size*sizeof(double));
+	vec->array = NULL;
+	vec->integers = alloc_block(size*sizeof(long));
+	vec->dictionary = NULL;
+	vec->dictionary_counts = NULL;
+	vec->dictionary_size = 0;
+	vec->codes = NULL;
+	vec->code_size = 0;
 	vec->size = size;
+	vec->has_range = false;
+	vec->min = 0;
+	vec->max = 0;
 	
 	return vec;
 }
 
+vector* init_vector_parallel(unsigned long size, unsigned long thread_count){
+	vector* vec;
+	
+	vec = init_vector(size);
+	place_vector(vec, thread_count, false);
+	
+	return vec;
+}
+
+bool is_column_file(FILE* file){
+	struct stat file_stat;
+	char magic[4];
+	ssize_t read_size;
+	
+	/* pipes cant be read twice, so only regular files are looked at
+	 * (without moving the file, so the caller reads from where it was) */
+	if(fstat(fileno(file), &file_stat) || !S_ISREG(file_stat.st_mode)){
+		return false;
+	}
+	
+	read_size = pread(fileno(file), magic, sizeof(magic), 0);
+	
+	return read_size == sizeof(magic) && memcmp(magic, COLUMN_MAGIC, sizeof(magic)) == 0;
+}
+
+int parse_integers(char* text, size_t length, bool at_end, long* values, unsigned long max_count, unsigned long* count, size_t* consumed){
+	char* position;
+	char* start;
+	char* last;
+	unsigned long index, value, limit;
+	bool negative;
+	
+	position = text;
+	last = text + length;
+	index = 0;
+	
+	while(index < max_count){
+		
+		/* skip to the next number */
+		while(position < last && (*position == ' ' || *position == '\n' || *position == '\r' || *position == '\t')){
+			position++;
+		}
+		if(position >= last){
+			break;
+		}
+		start = position;
+		
+		/* optional sign */
+		negative = (*position == '-');
+		if(*position == '-' || *position == '+'){
+			position++;
+		}
+		
+		/* the digits, as long as they fit in a long */
+		limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+		value = 0;
+		while(position < last && *position >= '0' && *position <= '9'){
+			if(value > (limit - (unsigned long)(*position - '0'))/10){
+				break;
+			}
+			value = value*10 + (unsigned long)(*position - '0');
+			position++;
+		}
+		
+		/* the number might go on in the next piece of text */
+		if(position >= last && !at_end){
+			position = start;
+			break;
+		}
+		
+		/* no digits, too big, or not followed by a space (like 1.5) */
+		if(position == start + (*start == '-' || *start == '+')
+			|| (position < last && *position != ' ' && *position != '\n' && *position != '\r' && *position != '\t')){
+			*count = index;
+			*consumed = start - text;
+			return FAIL;
+		}
+		
+		values[index] = negative ? (long)(0UL - value) : (long)value;
+		index++;
+	}
+	
+	*count = index;
+	*consumed = position - text;
+	return SUCCESS;
+}
+
+int parse_values(char* text, size_t length, bool at_end, double* values, unsigned long max_count, unsigned long* count, size_t* consumed){
+	char* position;
+	char* end;
+	char* last;
+	unsigned long index;
+	
+	position = text;
+	last = text + length;
+	index = 0;
+	
+	while(index < max_count){
+		
+		/* skip to the next number */
+		while(position < last && (*position == ' ' || *position == '\n' || *position == '\r' || *position == '\t')){
+			position++;
+		}
+		if(position >= last){
+			break;
+		}
+		
+		/* the number might go on in the next piece of text
+		 * (checked first, a piece may end in just a sign like "-") */
+		end = position;
+		while(end < last && *end != ' ' && *end != '\n' && *end != '\r' && *end != '\t'){
+			end++;
+		}
+		if(end >= last && !at_end){
+			break;
+		}
+		
+		values[index] = strtod(position, &end);
+		
+		/* not a number */
+		if(end == position){
+			*count = index;
+			*consumed = position - text;
+			return FAIL;
+		}
+		
+		index++;
+		position = end;
+	}
+	
+	*count = index;
+	*consumed = position - text;
+	return SUCCESS;
+}
+
+static void* place_slice(void* data){
+	place_job* job;
+	unsigned long start_index, end_index, t;
+	unsigned int seed;
+	
+	job = (place_job*) data;
+	
+	/* same cpu and slice as this thread_id has when binning */
+	pin_thread(job->thread_id);
+	start_index = calculate_start_index(job->thread_id, job->thread_count, job->vec->size);
+	end_index = calculate_end_index(job->thread_id, job->thread_count, job->vec->size) + 1;
+	
+	if(end_index <= start_index){
+		return NULL;
+	}
+	
+	if(job->random){
+		seed = job->seed;
+		for(t=start_index; t < end_index; t++){
+			
+			/* gets random doubles from 0 to 10 */
+			job->vec->array[t] = ((double)rand_r(&seed)/(double)RAND_MAX) *10;
+		}
+	}else{
+		memset(job->vec->array + start_index, 0, (end_index - start_index)*sizeof(double));
+	}
+	
+	return NULL;
+}
+
+static void place_vector(vector* vec, unsigned long thread_count, bool random){
+	place_job* jobs;
+	pthread_t* threads;
+	unsigned long t;
+	int rc;
+	
+	jobs = malloc(thread_count*sizeof(place_job));
+	threads = malloc(thread_count*sizeof(pthread_t));
+	
+	for(t=0; t < thread_count; t++){
+		jobs[t].vec = vec;
+		jobs[t].thread_id = t;
+		jobs[t].thread_count = thread_count;
+		jobs[t].random = random;
+		jobs[t].seed = (unsigned int)rand() + (unsigned int)t;
+		
+		rc = pthread_create(&threads[t], NULL, place_slice, (void*)&jobs[t]);
+		
+		/* problem creating thread */
+		if(rc){
+			printf(ERROR_THREAD_CR, rc);
+			exit(ERROR);
+		}
+	}
+	
+	for(t=0; t < thread_count; t++){
+		rc = pthread_join(threads[t], NULL);
+		
+		/* error joining thread */
+		if(rc){
+			printf(ERROR_THREAD_JN, rc);
+			exit(ERROR);
+		}
+	}
+	
+	free(jobs);
+	free(threads);
+}
+
+static int read_dictionary(FILE* file, vector* vec, unsigned long thread_count, unsigned long* count){
+	file_reader* reader;
+	unsigned short* table;
+	double* values;
+	char* text;
+	size_t length, consumed, used;
+	ssize_t read_size;
+	unsigned long parsed, encoded;
+	bool at_end;
+	int rc;
+	
+	/* one extra char for the '\0' parse_values needs */
+	text = malloc(READ_BUFFER_SIZE + 1);
+	values = malloc(DICTIONARY_CHUNK*sizeof(double));
+	table = calloc(1UL << DICTIONARY_TABLE_BITS, sizeof(unsigned short));
+	reader = init_reader(file);
+	length = 0;
+	*count = 0;
+	at_end = false;
+	rc = SUCCESS;
+	
+	while(*count < vec->size && !at_end){
+		
+		/* top up the text after whatever was left unparsed */
+		read_size = read_reader(reader, text + length, READ_BUFFER_SIZE - length);
+		if(read_size < 0){
+			rc = ERROR;
+			break;
+		}else if(read_size == 0){
+			at_end = true;
+		}
+		length += read_size;
+		text[length] = '\0';
+		
+		/* dictionary data is parsed a chunk at a time to be encoded,
+		 * plain data straight into the array */
+		consumed = 0;
+		do{
+			if(vec->dictionary){
+				rc = parse_values(text + consumed, length - consumed, at_end, values,
+					(vec->size - *count < DICTIONARY_CHUNK) ? vec->size - *count : DICTIONARY_CHUNK, &parsed, &used);
+				encoded = encode_dictionary(vec, table, values, parsed, *count);
+				
+				/* too many distinct values, the rest is plain data */
+				if(encoded < parsed){
+					expand_dictionary(vec, *count + encoded, thread_count);
+					memcpy(vec->array + *count + encoded, values + encoded, (parsed - encoded)*sizeof(double));
+				}
+			}else{
+				rc = parse_values(text + consumed, length - consumed, at_end, vec->array + *count, vec->size - *count, &parsed, &used);
+			}
+			*count += parsed;
+			consumed += used;
+		}while(rc == SUCCESS && parsed == DICTIONARY_CHUNK && *count < vec->size);
+		
+		/* bad data, or a single number filling the whole buffer */
+		if(rc || (consumed == 0 && length == READ_BUFFER_SIZE)){
+			rc = FAIL;
+			break;
+		}
+		
+		/* keep the unparsed end for the next read */
+		length -= consumed;
+		memmove(text, text + consumed, length);
+	}
+	
+	delete_reader(reader);
+	free(table);
+	free(values);
+	free(text);
+	return rc;
+}
+
+static int read_numbers(FILE* file, void* values, bool integers, unsigned long size, unsigned long* count){
+	file_reader* reader;
+	char* text;
+	size_t length, consumed;
+	ssize_t read_size;
+	unsigned long parsed;
+	bool at_end;
+	int rc;
+	
+	/* one extra char for the '\0' parse_values needs */
+	text = malloc(READ_BUFFER_SIZE + 1);
+	reader = init_reader(file);
+	length = 0;
+	*count = 0;
+	at_end = false;
+	rc = SUCCESS;
+	
+	while(*count < size && !at_end){
+		
+		/* top up the text after whatever was left unparsed */
+		read_size = read_reader(reader, text + length, READ_BUFFER_SIZE - length);
+		if(read_size < 0){
+			rc = ERROR;
+			break;
+		}else if(read_size == 0){
+			at_end = true;
+		}
+		length += read_size;
+		text[length] = '\0';
+		
+		if(integers){
+			rc = parse_integers(text, length, at_end, (long*)values + *count, size - *count, &parsed, &consumed);
+		}else{
+			rc = parse_values(text, length, at_end, (double*)values + *count, size - *count, &parsed, &consumed);
+		}
+		*count += parsed;
+		
+		/* bad data, or a single number filling the whole buffer */
+		if(rc || (consumed == 0 && length == READ_BUFFER_SIZE)){
+			rc = FAIL;
+			break;
+		}
+		
+		/* keep the unparsed end for the next read */
+		length -= consumed;
+		memmove(text, text + consumed, length);
+	}
+	
+	delete_reader(reader);
+	free(text);
+	return rc;
+}
+
+int read_vector_header(FILE* file, unsigned long* size, double* min, double* max){
+	char buffer[INPUT_BUFFER_SIZE];
+	int rc;
+	
+	/* first line of the file should be size (and maybe the range) */
+	if(!fgets(buffer,INPUT_BUFFER_SIZE,file)){
+		return ERROR;
+	}
+	rc = sscanf(buffer,"%lu %lf %lf",size,min,max);
+	
+	if(rc < 1){
+		return ERROR;
+	}else if(rc < 3){
+		return FAIL;
+	}
+	return SUCCESS;
+}
+
+int read_vector_integers(FILE* file, long* values, unsigned long size, unsigned long* count){
+	return read_numbers(file, (void*)values, true, size, count);
+}
 
+int read_vector_values(FILE* file, double* values, unsigned long size, unsigned long* count){
+	return read_numbers(file, (void*)values, false, size, count);
+}
+
+static void widen_codes(vector* vec, unsigned long count){
+	unsigned short* codes;
+	unsigned long t;
+	
+	codes = alloc_block(vec->size*sizeof(unsigned short));
+	for(t=0; t < count; t++){
+		codes[t] = ((unsigned char*)vec->codes)[t];
+	}
+	
+	free_block(vec->codes);
+	vec->codes = codes;
+	vec->code_size = 2;
+}
+
+int save_vector_columns(vector* vec, const char* path){
+	column_header header;
+	column_trailer trailer;
+	column_block* blocks;
+	unsigned char* buffer;
+	unsigned long t, count;
+	size_t offset;
+	FILE* file;
+	int rc;
+	
+	file = fopen(path, WRITE_ONLY);
+	if(!file){
+		return ERROR;
+	}
+	
+	/* blocks are encoded from the plain values */
+	decode_vector_dictionary(vec);
+	
+	memset(&header, 0, sizeof(column_header));
+	memcpy(header.magic, COLUMN_MAGIC, sizeof(header.magic));
+	header.version = COLUMN_VERSION;
+	header.block_size = COLUMN_BLOCK_SIZE;
+	
+	memset(&trailer, 0, sizeof(column_trailer));
+	memcpy(trailer.magic, COLUMN_MAGIC, sizeof(trailer.magic));
+	trailer.version = COLUMN_VERSION;
+	trailer.block_count = (vec->size + COLUMN_BLOCK_SIZE - 1)/COLUMN_BLOCK_SIZE;
+	trailer.size = vec->size;
+	
+	blocks = malloc((trailer.block_count > 0 ? trailer.block_count : 1)*sizeof(column_block));
+	buffer = alloc_block(sizeof(encoded_header) + 9*COLUMN_BLOCK_SIZE);
+	
+	rc = SUCCESS;
+	if(fwrite(&header, sizeof(column_header), 1, file) != 1){
+		rc = ERROR;
+	}
+	offset = sizeof(column_header);
+	
+	/* every block is encoded on its own, so it can be decoded on its own */
+	for(t=0; t < trailer.block_count && rc == SUCCESS; t++){
+		count = (vec->size - t*COLUMN_BLOCK_SIZE < COLUMN_BLOCK_SIZE) ? vec->size - t*COLUMN_BLOCK_SIZE : COLUMN_BLOCK_SIZE;
+		
+		blocks[t].offset = offset;
+		blocks[t].count = count;
+		blocks[t].length = encode_block(vec->array + t*COLUMN_BLOCK_SIZE, count, buffer, &blocks[t].min, &blocks[t].max);
+		offset += blocks[t].length;
+		
+		if(fwrite(buffer, 1, blocks[t].length, file) != blocks[t].length){
+			rc = ERROR;
+		}
+		
+		/* the range of the whole file */
+		if(t == 0 || blocks[t].min < trailer.min){
+			trailer.min = blocks[t].min;
+		}
+		if(t == 0 || blocks[t].max > trailer.max){
+			trailer.max = blocks[t].max;
+		}
+	}
+	
+	/* the footer, then the trailer that finds it */
+	trailer.footer_offset = offset;
+	if(rc == SUCCESS && (fwrite(blocks, sizeof(column_block), trailer.block_count, file) != trailer.block_count
+		|| fwrite(&trailer, sizeof(column_trailer), 1, file) != 1)){
+		rc = ERROR;
+	}
+	
+	if(fclose(file)){
+		rc = ERROR;
+	}
+	
+	free(blocks);
+	free_block(buffer);
+	return rc;
+}
@@ -5,52 +5,216 @@
  * Vector array that holds the array of data (+ length)
  * 
  * For reading a file, the following format is used:
- * <number of datas (n)>
+ * <number of datas (n)> [<min> <max>]
  * <data 1>
  * <data 2>
  * ...
  * <data n>
+ * 
+ * Column files are a compressed binary format, made of blocks of
+ * values that can each be decoded on their own (see vector.c for the
+ * encodings), so they are decoded in parallel straight into the array.
+ * A footer keeps the count, min and max of every block, so the range of
+ * the data is known without scanning it.
+ * 
+ * Column file layout (native byte order):
+ * <magic "HCOL"> <uint32 version> <uint64 block_size>
+ * <encoded block 0> ... <encoded block n-1>
+ * footer: n * (<uint64 offset> <uint64 length> <uint64 count> <double min> <double max>)
+ * <uint64 n> <uint64 size> <double min> <double max> <uint64 footer offset>
+ * <magic "HCOL"> <uint32 version>
+ * 
+ * Dictionary data:
+ * Text data files often hold only a few distinct values. While a file
+ * is read, every value is looked up in a small hash table of the
+ * distinct values seen so far, and only its code (its index into the
+ * dictionary of distinct values, 1 byte each up to 256 distinct values,
+ * then 2 bytes) is kept, along with how many times each distinct value
+ * was seen. Past DICTIONARY_MAX_SIZE distinct values the codes so far
+ * are decoded into a plain array, and the rest of the file is read into
+ * it as usual. Histograms bin dictionary data once per distinct value
+ * (see histogram.h); anything that needs the values one by one decodes
+ * them first with decode_vector_dictionary.
  */
 
 #ifndef VECTOR_H
 #define VECTOR_H
 
 #include <stdio.h>
+#include <stdbool.h>
 
 /*	TYPES	==========================================================*/
 
 typedef struct{
 	unsigned long size; /* length of the held array */
-	double* array; /* the array of data */
+	double* array; /* the array of data (NULL for integer and dictionary data) */
+	long* integers; /* the array of integer data (NULL for double data) */
+	double* dictionary; /* dictionary data: the distinct values (NULL for other data, refer to top) */
+	unsigned long* dictionary_counts; /* dictionary data: times each distinct value was seen */
+	unsigned long dictionary_size; /* dictionary data: number of distinct values */
+	void* codes; /* dictionary data: the dictionary index of every value */
+	unsigned int code_size; /* dictionary data: bytes per code (1 or 2) */
+	bool has_range; /* true if min and max are already known */
+	double min; /* the min value in the array (if has_range) */
+	double max; /* the max value in the array (if has_range) */
 }vector;
 
 /*	FUNCTIONS	======================================================*/
 
 /**
- * Creates a vector pointer from the given file obj
- * Assumes that the given file pointer is not NULL
+ * Creates a vector from the given column file, with thread_count
+ * threads decoding its blocks. The vector has its range.
+ * 
+ * @returns NULL if the file is not a good column file
+ */
+vector* create_vector_from_columns(FILE* file, unsigned long thread_count);
+
+/**
+ * Creates a vector pointer from the given file obj, of the given size
+ * Assumes that the given file pointer is not NULL, and its header was
+ * already read (read_vector_header) to get the size, so the file does
+ * not have to be rewound (it may be a pipe)
  * If the given input file contains more data the specified 
- * size in the data file, the extra data is ignored.
+ * size in the data file, the extra data is ignored. If it contains
+ * less, the vector size is the number of data actually read.
+ * 
+ * If thread_count is more than 1, the array is placed with
+ * init_vector_parallel before the file is read into it.
+ * 
+ * Files with few distinct values make dictionary data instead
+ * (refer to top).
  * 
  * Check top of file for format for file
  * 
  * @returns NULL if the given file or is bad format
  */
-vector* create_vector_from_file(FILE* file);
+vector* create_vector_from_file(FILE* file, unsigned long size, unsigned long thread_count);
+
+/**
+ * Creates an integer vector from the given file obj, like
+ * create_vector_from_file
+ * 
+ * @returns NULL if the file is bad format (or has non integers)
+ */
+vector* create_vector_integers_from_file(FILE* file, unsigned long size);
 
 /**
  * Creates a vector with random doubles of the given size
  */
 vector* create_vector_random(unsigned long size);
 
+/**
+ * Creates an integer vector with random integers of the given size
+ */
+vector* create_vector_random_integers(unsigned long size);
+
+/**
+ * Creates a vector with random doubles of the given size.
+ * Each of the thread_count threads generates (and so first touches)
+ * the slice it will bin later, pinned to the same CPU it will bin on.
+ */
+vector* create_vector_random_parallel(unsigned long size, unsigned long thread_count);
+
+/**
+ * Turns dictionary data into a plain array of data (refer to top)
+ * Does nothing to other vectors
+ */
+void decode_vector_dictionary(vector* vec);
+
 /**
  * delets the given vector
  */
 void delete_vector(vector* vec);
 
+/**
+ * @returns true if the given file is a column file (only regular
+ * files can be, anything else is read as text). The file is not moved.
+ */
+bool is_column_file(FILE* file);
+
+/**
+ * Parses whitespace separated integers like parse_values
+ * Anything that is not a whole number (or does not fit in a long)
+ * is not an integer.
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if only integers were found
+ * 	FAIL if something that is not an integer was found
+ */
+int parse_integers(char* text, size_t length, bool at_end, long* values, unsigned long max_count, unsigned long* count, size_t* consumed);
+
+/**
+ * Parses whitespace separated numbers from text (length chars long).
+ * text[length] MUST be '\0' so the number parser always stops.
+ * Parsing stops once max_count values are parsed, or at the last
+ * number in the text, which is left unparsed unless at_end is true
+ * (it may continue in the next piece of text).
+ * 
+ * @param count set to the number of values parsed
+ * @param consumed set to the number of chars used
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if only numbers were found
+ * 	FAIL if something that is not a number was found
+ */
+int parse_values(char* text, size_t length, bool at_end, double* values, unsigned long max_count, unsigned long* count, size_t* consumed);
+
+/**
+ * Reads the first line of a data file (check top of file)
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the size and a min and max were read
+ * 	FAIL if only the size was read
+ * 	ERROR if the line does not start with a size
+ */
+int read_vector_header(FILE* file, unsigned long* size, double* min, double* max);
+
+/**
+ * Reads up to size integers from file like read_vector_values
+ * 
+ * USES RETURN_CODE
+ * @returns same codes as read_vector_values
+ */
+int read_vector_integers(FILE* file, long* values, unsigned long size, unsigned long* count);
+
+/**
+ * Reads up to size numbers from file (after the header line) into
+ * values, with large buffered reads
+ * 
+ * @param count set to the number of values read
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the file ended or size values were read
+ * 	FAIL if something that is not a number was found
+ * 	ERROR if reading the file failed
+ */
+int read_vector_values(FILE* file, double* values, unsigned long size, unsigned long* count);
+
 /**
  * @returns a vector pointer to a vector with the given size
  */
 vector* init_vector(unsigned long size);
 
+/**
+ * @returns a vector pointer to an integer vector with the given size
+ */
+vector* init_vector_integers(unsigned long size);
+
+/**
+ * @returns a vector pointer to a vector with the given size, where
+ * each slice of the array (calculate_start_index to calculate_end_index)
+ * was first touched by a thread pinned like the binning thread that
+ * uses it. This puts the pages of each slice on that thread's NUMA node.
+ */
+vector* init_vector_parallel(unsigned long size, unsigned long thread_count);
+
+/**
+ * Saves the given vector as a column file at path
+ * 
+ * USES RETURN_CODE
+ * @returns SUCCESS if the file was written
+ * 	ERROR if it was not
+ */
+int save_vector_columns(vector* vec, const char* path);
+
 #endif
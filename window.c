@@ -0,0 +1,228 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Window functions keep a histogram over a sliding window of time
+ *
+ * Sub-histogram counters are only touched with atomic builtins, and
+ * the epoch works like a sequence lock: it is odd while a rotation is
+ * changing the totals, and readers retry when it changed under them.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "histogram.h"
+#include "memory.h"
+#include "window.h"
+#include "return_code.h"
+
+/*	PRIVATE FUNCTION PROTOTYPES	======================================*/
+
+/**
+ * Closes the current interval and opens the next one (refer to top)
+ */
+static void rotate_window(w_histogram* window);
+
+/*	FUNCTIONS	======================================================*/
+
+void delete_w_histogram(w_histogram* window){
+	if(window){
+		if(window->graph){
+			delete_histogram(window->graph);
+		}
+
+		free_block(window->intervals);
+		free_block(window->totals);
+		free_block(window->decayed);
+
+		free(window);
+	}
+}
+
+w_histogram* init_w_histogram(double min, double max, unsigned long bin_count, unsigned long interval_count, double interval_length, double start_time, double decay){
+	w_histogram* window;
+
+	/* the lazy totals need a closed interval that is not the oldest */
+	if(interval_count < 3 || !(interval_length > 0)){
+		return NULL;
+	}
+
+	window = malloc(sizeof(w_histogram));
+	window->graph = init_histogram(bin_count);
+	window->graph->data = NULL;
+
+	/* the bins are fixed for the life of the window */
+	if(process_stats_range(window->graph, min, max)){
+		delete_histogram(window->graph);
+		free(window);
+		return NULL;
+	}
+
+	window->interval_count = interval_count;
+	window->intervals = alloc_counters(interval_count*bin_count);
+	window->totals = alloc_counters(bin_count);
+	window->interval_length = interval_length;
+	window->interval_end = start_time + interval_length;
+	window->current = 0;
+	window->closed = interval_count-1;
+	window->epoch = 0;
+
+	/* decayed weights are optional */
+	if(decay > 0 && decay < 1){
+		window->decay = decay;
+		window->decayed = (double*) alloc_counters(bin_count);
+	}else{
+		window->decay = 0;
+		window->decayed = NULL;
+	}
+
+	return window;
+}
+
+static void rotate_window(w_histogram* window){
+	unsigned long* closed;
+	unsigned long* oldest;
+	unsigned long bin_count, oldest_index, total, t;
+	double weight;
+
+	bin_count = window->graph->bin_count;
+	oldest_index = (window->current + 1) % window->interval_count;
+	closed = window->intervals + window->closed*bin_count;
+	oldest = window->intervals + oldest_index*bin_count;
+
+	/* readers retry while the epoch is odd */
+	__atomic_add_fetch(&window->epoch, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for(t=0; t < bin_count; t++){
+
+		/* fold the interval closed last time (nobody writes it anymore)
+		 * and drop the oldest interval so it can be reused
+		 */
+		total = window->totals[t] + closed[t] - oldest[t];
+		__atomic_store_n(&window->totals[t], total, __ATOMIC_RELAXED);
+		__atomic_store_n(&oldest[t], 0, __ATOMIC_RELAXED);
+
+		if(window->decayed){
+			weight = window->decayed[t]*window->decay + (double)closed[t];
+			__atomic_store(&window->decayed[t], &weight, __ATOMIC_RELAXED);
+		}
+	}
+
+	/* writers move on to the emptied interval */
+	__atomic_store_n(&window->closed, window->current, __ATOMIC_RELAXED);
+	__atomic_store_n(&window->current, oldest_index, __ATOMIC_RELEASE);
+
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_add_fetch(&window->epoch, 1, __ATOMIC_RELAXED);
+}
+
+void window_advance(w_histogram* window, double now){
+	unsigned long rotations, t;
+	double skipped, weight;
+
+	if(now < window->interval_end){
+		return;
+	}
+
+	rotations = (unsigned long)((now - window->interval_end) / window->interval_length) + 1;
+	window->interval_end += rotations * window->interval_length;
+
+	/* after interval_count+1 rotations the window is empty anyway */
+	skipped = 0;
+	if(rotations > window->interval_count+1){
+		skipped = (double)(rotations - (window->interval_count+1));
+		rotations = window->interval_count+1;
+	}
+
+	for(t=0; t < rotations; t++){
+		rotate_window(window);
+	}
+
+	/* the skipped rotations would only have decayed the weights (once
+	 * the closed and current intervals were folded in above) */
+	if(skipped > 0 && window->decayed){
+		for(t=0; t < window->graph->bin_count; t++){
+			weight = window->decayed[t] * pow(window->decay, skipped);
+			__atomic_store(&window->decayed[t], &weight, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void window_insert(w_histogram* window, double value){
+	unsigned long bin, current;
+
+	bin = find_bin(value, window->graph);
+
+	/* data outside the bins is dropped */
+	if(bin >= window->graph->bin_count){
+		return;
+	}
+
+	current = __atomic_load_n(&window->current, __ATOMIC_ACQUIRE);
+	__atomic_fetch_add(&window->intervals[current*window->graph->bin_count + bin], 1, __ATOMIC_RELAXED);
+}
+
+void window_snapshot(w_histogram* window, unsigned long* counts){
+	unsigned long* closed;
+	unsigned long* current;
+	unsigned long bin_count, epoch, t;
+
+	bin_count = window->graph->bin_count;
+
+	do{
+		/* wait out a running rotation */
+		epoch = __atomic_load_n(&window->epoch, __ATOMIC_ACQUIRE);
+		if(epoch % 2 == 1){
+			continue;
+		}
+
+		closed = window->intervals + __atomic_load_n(&window->closed, __ATOMIC_RELAXED)*bin_count;
+		current = window->intervals + __atomic_load_n(&window->current, __ATOMIC_RELAXED)*bin_count;
+
+		/* folded totals plus the two unfolded intervals */
+		for(t=0; t < bin_count; t++){
+			counts[t] = __atomic_load_n(&window->totals[t], __ATOMIC_RELAXED)
+				+ __atomic_load_n(&closed[t], __ATOMIC_RELAXED)
+				+ __atomic_load_n(&current[t], __ATOMIC_RELAXED);
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}while(epoch % 2 == 1 || epoch != __atomic_load_n(&window->epoch, __ATOMIC_RELAXED));
+}
+
+void window_snapshot_decayed(w_histogram* window, double* weights){
+	unsigned long* closed;
+	unsigned long* current;
+	unsigned long bin_count, epoch, t;
+	double folded_weight, weight;
+
+	if(!window->decayed){
+		return;
+	}
+
+	bin_count = window->graph->bin_count;
+
+	/* the folded weights are at least 2 intervals old */
+	folded_weight = window->decay * window->decay;
+
+	do{
+		/* wait out a running rotation */
+		epoch = __atomic_load_n(&window->epoch, __ATOMIC_ACQUIRE);
+		if(epoch % 2 == 1){
+			continue;
+		}
+
+		closed = window->intervals + __atomic_load_n(&window->closed, __ATOMIC_RELAXED)*bin_count;
+		current = window->intervals + __atomic_load_n(&window->current, __ATOMIC_RELAXED)*bin_count;
+
+		for(t=0; t < bin_count; t++){
+			__atomic_load(&window->decayed[t], &weight, __ATOMIC_RELAXED);
+			weights[t] = weight*folded_weight
+				+ (double)__atomic_load_n(&closed[t], __ATOMIC_RELAXED)*window->decay
+				+ (double)__atomic_load_n(&current[t], __ATOMIC_RELAXED);
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}while(epoch % 2 == 1 || epoch != __atomic_load_n(&window->epoch, __ATOMIC_RELAXED));
+}
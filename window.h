@@ -0,0 +1,98 @@
+/**
+ * @author Andre Allan Ponce
+ * andreponce@null.net
+ *
+ * Window functions keep a histogram over a sliding window of time
+ * ("the last 60 seconds") instead of over a fixed set of data.
+ *
+ * w_histograms use the bins of an embedded histogram, and keep a ring
+ * of interval_count sub-histograms (one per interval of time). Values
+ * are always counted in the current interval, so old data never has to
+ * be binned again: when an interval ends, the oldest sub-histogram is
+ * dropped from the running totals and reused for the next interval.
+ *
+ * Lazy totals:
+ * The running totals do not include the interval that just closed.
+ * It is folded into the totals at the next rotation, once no writer can
+ * still be adding to it (writers must finish an insert within one
+ * interval). Reads add the closed and the current interval on top.
+ * For this the window needs at least 3 intervals.
+ *
+ * Decay:
+ * With a decay factor, the window also keeps exponentially decayed
+ * weights over all of the past intervals: a value that is k intervals
+ * old counts decay^k. These are read with window_snapshot_decayed.
+ *
+ * Concurrency:
+ * - window_insert can be called from any number of threads at once,
+ * 	it is one atomic increment
+ * - window_advance must only be called by one thread at a time
+ * - snapshots never block writers; they retry if a rotation happened
+ * 	while they were reading
+ */
+
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "histogram.h"
+
+/*	TYPES	==========================================================*/
+
+/* a histogram over a sliding window */
+typedef struct{
+	histogram* graph; /* the bins (bin_counts are not used) */
+	unsigned long interval_count; /* number of intervals in the window */
+	unsigned long* intervals; /* interval_count sub-histograms in a row */
+	unsigned long* totals; /* sums of the folded intervals */
+	double* decayed; /* decayed weights of the folded intervals (or NULL) */
+	double decay; /* weight lost per interval, 0 for no decay */
+	unsigned long current; /* index of the interval being written */
+	unsigned long closed; /* index of the interval not folded yet */
+	unsigned long epoch; /* odd while a rotation is running */
+	double interval_length; /* length of an interval (in seconds) */
+	double interval_end; /* when the current interval ends */
+}w_histogram;
+
+/*	FUNCTIONS	======================================================*/
+
+/**
+ * Deletes the given w_histogram (and its histogram)
+ */
+void delete_w_histogram(w_histogram* window);
+
+/**
+ * Creates a w_histogram with bin_count bins over min to max, covering
+ * interval_count intervals of interval_length seconds, starting at
+ * start_time.
+ * With a decay between 0 and 1, decayed weights are also kept.
+ *
+ * @returns NULL if there are less than 3 intervals or the range is bad
+ */
+w_histogram* init_w_histogram(double min, double max, unsigned long bin_count, unsigned long interval_count, double interval_length, double start_time, double decay);
+
+/**
+ * Rotates the window until now is inside the current interval.
+ * Each rotation is O(bin_count).
+ * Only one thread may advance a window at a time
+ */
+void window_advance(w_histogram* window, double now);
+
+/**
+ * Counts the given value in the current interval.
+ * Values outside of the bins are dropped.
+ */
+void window_insert(w_histogram* window, double value);
+
+/**
+ * Copies the bin counts of the whole window into counts
+ * (bin_count long)
+ */
+void window_snapshot(w_histogram* window, unsigned long* counts);
+
+/**
+ * Copies the decayed weights of every bin into weights (bin_count long)
+ * Does nothing if the window was created without decay
+ */
+void window_snapshot_decayed(w_histogram* window, double* weights);
+
+#endif